@@ -0,0 +1,1337 @@
+// Benchmarks for the music library, playlist and directory scan hot paths.
+// Run: ./MusicPlayerBench [--sizes=1000,100000,1000000] [--runs=3] [--scan-files=2000,20000]
+//                         [--format=text|json|csv] [--filter=NAME]
+// Each benchmark runs once cold, on freshly built data, then runs-1 more
+// times warm; cold and warm are reported separately. Text output is for
+// people, JSON and CSV carry the same fields for scripts.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/AssetResolver.h"
+#include "../src/DuplicateFinder.h"
+#include "../src/Equalizer.h"
+#include "../src/Fingerprint.h"
+#include "../src/Limiter.h"
+#include "../src/Logger.h"
+#include "../src/LoudnessMeter.h"
+#include "../src/MixEngine.h"
+#include "../src/MusicLibrary.h"
+#include "../src/PlayQueue.h"
+#include "../src/Resampler.h"
+#include "../src/Playlist.h"
+#include "../src/StringPool.h"
+#include "../src/WaveformCache.h"
+
+#ifdef __GLIBC__
+    #include <malloc.h>
+#endif
+
+// --- Options and results ---
+
+enum class Format { Text, Json, Csv };
+
+struct Options {
+    std::vector<size_t> sizes = {1000, 100000, 1000000}; // Catalog songs or playlist lines
+    std::vector<size_t> scan_files = {2000, 20000};
+    size_t runs = 3; // One cold, the rest warm
+    Format format = Format::Text;
+    std::string filter; // Only benchmarks whose name contains this
+};
+
+struct Result {
+    std::string name;
+    std::string variant; // e.g. "hit", a search query, or empty
+    size_t size = 0;
+    bool warm = false;
+    size_t ops = 0; // Operations timed
+    double seconds = 0; // Their total time
+    std::vector<double> samples_ns; // Latency per operation, for percentiles
+    double value = 0; // A measurement that isn't a time, e.g. memory
+    std::string unit; // Set when value is used
+};
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static std::string format_ns(double ns) {
+    char text[32];
+    if (ns < 1e3) {
+        std::snprintf(text, sizeof(text), "%.0f ns", ns);
+    } else if (ns < 1e6) {
+        std::snprintf(text, sizeof(text), "%.1f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        std::snprintf(text, sizeof(text), "%.1f ms", ns / 1e6);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+    }
+    return text;
+}
+
+static std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+// Collects results, printing text as it goes and JSON/CSV at the end
+class Report {
+public:
+    explicit Report(Format format) : format(format) {}
+
+    void add(Result result) {
+        std::sort(result.samples_ns.begin(), result.samples_ns.end());
+        if (format == Format::Text) {
+            print_text(result);
+        }
+        results.push_back(std::move(result));
+    }
+
+    // Folds warm runs into one result; the first run is reported as cold
+    void add_runs(std::vector<Result>& runs) {
+        if (runs.empty()) {
+            return;
+        }
+        add(std::move(runs[0]));
+        if (runs.size() < 2) {
+            return;
+        }
+        Result warm = std::move(runs[1]);
+        for (size_t i = 2; i < runs.size(); ++i) {
+            warm.ops += runs[i].ops;
+            warm.seconds += runs[i].seconds;
+            warm.samples_ns.insert(warm.samples_ns.end(), runs[i].samples_ns.begin(), runs[i].samples_ns.end());
+        }
+        warm.warm = true;
+        add(std::move(warm));
+    }
+
+    void finish() const {
+        if (format == Format::Json) {
+            std::printf("{\n  \"threads\": %u,\n  \"results\": [\n", std::max(1u, std::thread::hardware_concurrency()));
+            for (size_t i = 0; i < results.size(); ++i) {
+                const Result& r = results[i];
+                std::printf("    {\"name\": \"%s\", \"variant\": \"%s\", \"size\": %zu, \"run\": \"%s\", ",
+                            json_escape(r.name).c_str(), json_escape(r.variant).c_str(), r.size, r.warm ? "warm" : "cold");
+                if (!r.unit.empty()) {
+                    std::printf("\"value\": %.3f, \"unit\": \"%s\"}", r.value, json_escape(r.unit).c_str());
+                } else {
+                    std::printf("\"ops\": %zu, \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"p50_ns\": %.1f, "
+                                "\"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}",
+                                r.ops, r.seconds, ops_per_second(r), percentile(r.samples_ns, 0.5),
+                                percentile(r.samples_ns, 0.9), percentile(r.samples_ns, 0.99), percentile(r.samples_ns, 1));
+                }
+                std::printf("%s\n", i + 1 < results.size() ? "," : "");
+            }
+            std::printf("  ]\n}\n");
+        } else if (format == Format::Csv) {
+            std::printf("name,variant,size,run,ops,seconds,ops_per_sec,p50_ns,p90_ns,p99_ns,max_ns,value,unit\n");
+            for (const Result& r : results) {
+                // Variants never contain commas or quotes
+                std::printf("%s,%s,%zu,%s,%zu,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%s\n", r.name.c_str(),
+                            r.variant.c_str(), r.size, r.warm ? "warm" : "cold", r.ops, r.seconds, ops_per_second(r),
+                            percentile(r.samples_ns, 0.5), percentile(r.samples_ns, 0.9),
+                            percentile(r.samples_ns, 0.99), percentile(r.samples_ns, 1), r.value, r.unit.c_str());
+            }
+        }
+    }
+
+private:
+    Format format;
+    std::vector<Result> results;
+    bool header_printed = false;
+
+    static double ops_per_second(const Result& r) { return r.seconds > 0 ? r.ops / r.seconds : 0; }
+
+    void print_text(const Result& r) {
+        if (!header_printed) {
+            std::printf("%-18s %-16s %9s %-4s %10s %12s %10s %10s %10s %10s\n", "benchmark", "variant", "size", "run",
+                        "ops", "ops/s", "p50", "p90", "p99", "max");
+            header_printed = true;
+        }
+        if (!r.unit.empty()) {
+            std::printf("%-18s %-16s %9zu %-4s %10.1f %s\n", r.name.c_str(), r.variant.c_str(), r.size,
+                        r.warm ? "warm" : "cold", r.value, r.unit.c_str());
+            return;
+        }
+        std::printf("%-18s %-16s %9zu %-4s %10zu %12.0f %10s %10s %10s %10s\n", r.name.c_str(), r.variant.c_str(),
+                    r.size, r.warm ? "warm" : "cold", r.ops, ops_per_second(r),
+                    format_ns(percentile(r.samples_ns, 0.5)).c_str(), format_ns(percentile(r.samples_ns, 0.9)).c_str(),
+                    format_ns(percentile(r.samples_ns, 0.99)).c_str(), format_ns(percentile(r.samples_ns, 1)).c_str());
+        std::fflush(stdout);
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ns(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Lookups take tens of nanoseconds, about what reading the clock costs, so
+// latency samples are taken per batch of this many and divided out
+static const size_t LATENCY_BATCH = 8;
+
+// Times op(i) for i in [0, count): one sample per batch, plus the total
+template <typename Op>
+static Result time_ops(const std::string& name, const std::string& variant, size_t size, size_t count, Op op,
+                       size_t batch = LATENCY_BATCH) {
+    Result r;
+    r.name = name;
+    r.variant = variant;
+    r.size = size;
+    r.ops = count;
+    r.samples_ns.reserve(count / batch + 1);
+    auto start = Clock::now();
+    auto batch_start = start;
+    for (size_t i = 0; i < count; ++i) {
+        op(i);
+        if ((i + 1) % batch == 0 || i + 1 == count) {
+            auto now = Clock::now();
+            size_t in_batch = i % batch + 1;
+            r.samples_ns.push_back(elapsed_ns(batch_start, now) / in_batch);
+            batch_start = now;
+        }
+    }
+    r.seconds = elapsed_ns(start, Clock::now()) / 1e9;
+    return r;
+}
+
+// Times one call of op that does ops operations (lines loaded, files
+// scanned, ...); the one latency sample is the average per operation
+template <typename Op>
+static Result time_once(const std::string& name, const std::string& variant, size_t size, size_t ops, Op op) {
+    Result r;
+    r.name = name;
+    r.variant = variant;
+    r.size = size;
+    r.ops = ops;
+    auto start = Clock::now();
+    op();
+    double ns = elapsed_ns(start, Clock::now());
+    r.seconds = ns / 1e9;
+    r.samples_ns.push_back(ns / std::max<size_t>(ops, 1));
+    return r;
+}
+
+// --- Synthetic data ---
+
+static std::string make_title(size_t i) {
+    // Titles share prefixes and character sets, the worst case for the old
+    // character-sum hash
+    return "Artist " + std::to_string(i % 997) + " - Track " + std::to_string(i);
+}
+
+// A catalog shaped like a scanned library: twelve tracks per album folder,
+// eight albums per artist under one music root, a third of the files untagged
+struct CatalogGenerator {
+    static void fields(size_t i, std::string& title, std::string& artist, std::string& album, std::string& path) {
+        size_t album_number = i / 12;
+        size_t artist_number = album_number / 8;
+        bool tagged = i % 3 != 0;
+        title = make_title(i);
+        artist = tagged ? "Artist " + std::to_string(artist_number) : "Unknown Artist";
+        album = tagged ? "Album " + std::to_string(album_number) : "Unknown Album";
+        path = "/home/user/Music/Artist " + std::to_string(artist_number) + "/Album " +
+               std::to_string(album_number) + "/" + std::to_string(i % 12 + 1) + " - " + title + ".mp3";
+    }
+
+    static Song song(size_t i) {
+        std::string title, artist, album, path;
+        fields(i, title, artist, album, path);
+        return {title, artist, album, 120 + static_cast<int>(i % 240), path};
+    }
+
+    static std::vector<Song> songs(size_t count) {
+        std::vector<Song> batch;
+        batch.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch.push_back(song(i));
+        }
+        return batch;
+    }
+};
+
+// A playlist file of line_count lines drawn from twice the catalog, so
+// about half name library songs and the rest are only in the file; with
+// repeats, about a third of the lines are duplicates
+static void write_playlist(const std::string& filename, size_t line_count, size_t catalog_size, uint64_t seed) {
+    std::ofstream out(filename);
+    std::mt19937_64 rng(seed);
+    std::string title, artist, album, path;
+    for (size_t i = 0; i < line_count; ++i) {
+        size_t n = rng() % (2 * catalog_size);
+        CatalogGenerator::fields(n, title, artist, album, path);
+        out << title << '|' << artist << '|' << album << "|200|" << path << '\n';
+    }
+}
+
+// A directory of empty audio files laid out like the catalog
+static void write_scan_tree(const std::string& root, size_t file_count) {
+    std::filesystem::remove_all(root);
+    for (size_t i = 0; i < file_count; ++i) {
+        size_t album_number = i / 12;
+        std::string directory = root + "/Artist " + std::to_string(album_number / 8) + "/Album " + std::to_string(album_number);
+        if (i % 12 == 0) {
+            std::filesystem::create_directories(directory);
+        }
+        std::ofstream(directory + "/" + std::to_string(i % 12 + 1) + " - " + make_title(i) + ".mp3");
+    }
+}
+
+// Titles of two to five words from a 50k-word vocabulary, common words
+// much more likely, so trigram and word frequencies look like a real library
+static std::string make_word_title(const std::vector<std::string>& vocabulary, size_t i) {
+    std::mt19937_64 rng(i * 7919 + 1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::string title;
+    size_t word_count = 2 + rng() % 4;
+    for (size_t w = 0; w < word_count; ++w) {
+        double u = uniform(rng);
+        title += w ? " " : "";
+        title += vocabulary[static_cast<size_t>(vocabulary.size() * u * u * u)];
+    }
+    return title;
+}
+
+// --- Benchmarks ---
+
+static bool selected(const Options& options, const char* name) {
+    return options.filter.empty() || std::strstr(name, options.filter.c_str()) != nullptr;
+}
+
+static void bench_library(const Options& options, Report& report, size_t song_count) {
+    const char* const names[] = {"library_build", "find_song", "get_song_by_index", "browse", "playlist_add",
+                                 "playlist_edit", "playlist_load", "playlist_save"};
+    if (std::none_of(std::begin(names), std::end(names), [&](const char* name) { return selected(options, name); })) {
+        return;
+    }
+    std::vector<Song> catalog = CatalogGenerator::songs(song_count);
+    MusicLibrary library;
+    if (selected(options, "library_build")) {
+        report.add(time_once("library_build", "add_songs", song_count, song_count, [&] { library.add_songs(catalog); }));
+    } else {
+        library.add_songs(catalog);
+    }
+
+    const size_t lookups = 200000;
+    std::mt19937_64 rng(42);
+    std::vector<std::string> hits;
+    std::vector<std::string> misses;
+    std::vector<int> numbers(lookups);
+    hits.reserve(lookups);
+    misses.reserve(lookups);
+    for (size_t i = 0; i < lookups; ++i) {
+        hits.push_back(make_title(rng() % song_count));
+        misses.push_back(make_title(song_count + rng() % song_count));
+        numbers[i] = static_cast<int>(rng() % song_count) + 1;
+    }
+
+    size_t found = 0;
+    if (selected(options, "find_song")) {
+        std::vector<Result> hit_runs, miss_runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            hit_runs.push_back(time_ops("find_song", "hit", song_count, lookups,
+                                        [&](size_t i) { found += library.find_song(hits[i]) != nullptr; }));
+            miss_runs.push_back(time_ops("find_song", "miss", song_count, lookups,
+                                         [&](size_t i) { found += library.find_song(misses[i]) != nullptr; }));
+        }
+        report.add_runs(hit_runs);
+        report.add_runs(miss_runs);
+    }
+    if (selected(options, "browse")) {
+        // A page of 20 anywhere in artist order, the first page of an artist
+        // prefix, then adding one song to the maintained indexes
+        const size_t page_size = 20;
+        const size_t artist_count = std::max<size_t>(song_count / 96, 1);
+        std::vector<std::string> prefixes(lookups);
+        for (size_t i = 0; i < lookups; ++i) {
+            prefixes[i] = "artist " + std::to_string(rng() % artist_count);
+        }
+        const size_t adds = std::min<size_t>(song_count, 10000);
+        std::vector<Result> page_runs, prefix_runs, add_runs;
+        size_t total = 0;
+        for (size_t run = 0; run < options.runs; ++run) {
+            page_runs.push_back(time_ops("browse", "page", song_count, lookups, [&](size_t i) {
+                found += library.list_sorted(SortField::Artist, "", numbers[i] - 1, page_size, total).size();
+            }));
+            prefix_runs.push_back(time_ops("browse", "prefix_page", song_count, lookups, [&](size_t i) {
+                found += library.list_sorted(SortField::Artist, prefixes[i], 0, page_size, total).size();
+            }));
+            add_runs.push_back(time_ops("browse", "add_song", song_count, adds, [&](size_t i) {
+                library.add_song(CatalogGenerator::song(song_count + run * adds + i));
+            }));
+        }
+        report.add_runs(page_runs);
+        report.add_runs(prefix_runs);
+        report.add_runs(add_runs);
+    }
+    if (selected(options, "get_song_by_index")) {
+        // Random "add song by number" lookups from the menu
+        std::vector<Result> runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            runs.push_back(time_ops("get_song_by_index", "", song_count, lookups,
+                                    [&](size_t i) { found += library.get_song_by_index(numbers[i]) != nullptr; }));
+        }
+        report.add_runs(runs);
+    }
+    if (selected(options, "playlist_add")) {
+        // Every song once, then every song again (the duplicate check path).
+        // Bench playlists don't prefetch: the catalog's files don't exist, and
+        // trying to open them would time the prefetch thread and its warnings.
+        std::vector<Result> new_runs, duplicate_runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            Playlist playlist("bench", false);
+            new_runs.push_back(time_ops("playlist_add", "new", song_count, song_count,
+                                        [&](size_t i) { playlist.add_song(catalog[i]); }));
+            duplicate_runs.push_back(time_ops("playlist_add", "duplicate", song_count, song_count,
+                                              [&](size_t i) { playlist.add_song(catalog[i]); }));
+        }
+        report.add_runs(new_runs);
+        report.add_runs(duplicate_runs);
+    }
+    if (selected(options, "playlist_edit")) {
+        // Positional edits anywhere in a song_count queue, against the same
+        // edit on a plain vector of songs (what the playlist used to be)
+        const size_t edits = std::min<size_t>(song_count, 10000);
+        const size_t vector_edits = std::min<size_t>(edits, 1000); // Each moves megabytes at the largest sizes
+        Playlist playlist("bench", false);
+        for (const Song& song : catalog) {
+            playlist.add_song(song);
+        }
+        std::vector<size_t> from(edits), to(edits);
+        for (size_t i = 0; i < edits; ++i) {
+            from[i] = rng() % song_count + 1;
+            to[i] = rng() % song_count + 1;
+        }
+        std::vector<Song> flat(catalog);
+        std::vector<Result> move_runs, remove_runs, vector_runs, shuffle_runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            move_runs.push_back(time_ops("playlist_edit", "move", song_count, edits,
+                                         [&](size_t i) { playlist.move_song(from[i], to[i]); }));
+            // Removes a song and queues it again, so the size stays the same
+            remove_runs.push_back(time_ops("playlist_edit", "remove_add_next", song_count, edits, [&](size_t i) {
+                playlist.remove_song(from[i]);
+                playlist.add_song_next(catalog[i]);
+            }));
+            vector_runs.push_back(time_ops("playlist_edit", "vector_move", song_count, vector_edits, [&](size_t i) {
+                Song song = std::move(flat[from[i] - 1]);
+                flat.erase(flat.begin() + (from[i] - 1));
+                flat.insert(flat.begin() + (to[i] - 1), std::move(song));
+            }));
+            PlayQueue queue(run);
+            for (size_t i = 0; i < song_count; ++i) {
+                queue.push_back();
+            }
+            queue.set_current(queue.at(0));
+            queue.set_shuffle(true);
+            shuffle_runs.push_back(time_ops("playlist_edit", "shuffle_next", song_count, edits,
+                                            [&](size_t) { queue.next(); }));
+        }
+        report.add_runs(move_runs);
+        report.add_runs(remove_runs);
+        report.add_runs(vector_runs);
+        report.add_runs(shuffle_runs);
+    }
+    if (selected(options, "playlist_load") || selected(options, "playlist_save")) {
+        const std::string filename = "bench_playlist.txt";
+        const std::string saved_filename = "bench_playlist_saved.txt";
+        write_playlist(filename, song_count, song_count, 7);
+        std::vector<Result> load_runs, save_runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            Playlist playlist("bench", false);
+            load_runs.push_back(time_once("playlist_load", "", song_count, song_count, // Lines
+                                          [&] { playlist.load_from_file(filename, library); }));
+            save_runs.push_back(time_once("playlist_save", "", song_count, playlist.get_song_count(), // Songs
+                                          [&] { playlist.save_to_file(saved_filename); }));
+        }
+        std::remove(filename.c_str());
+        std::remove(saved_filename.c_str());
+        if (selected(options, "playlist_load")) {
+            report.add_runs(load_runs);
+        }
+        if (selected(options, "playlist_save")) {
+            report.add_runs(save_runs);
+        }
+    }
+}
+
+static void bench_search(const Options& options, Report& report, size_t song_count) {
+    static const char* const words[] = {"love", "night", "down", "fire", "heart", "dark", "go", "way",
+                                        "little", "hall", "fame", "soul", "age", "dream", "light", "run"};
+    const size_t word_count = sizeof(words) / sizeof(words[0]);
+    std::mt19937_64 rng(11);
+    std::vector<Song> batch;
+    batch.reserve(song_count);
+    for (size_t i = 0; i < song_count; ++i) {
+        std::string title = std::string(words[rng() % word_count]) + " " + words[rng() % word_count] +
+                            " " + std::to_string(i);
+        batch.push_back({title, make_title(i % 4999).substr(0, 11), "Album " + std::to_string(i % 20011), 200, ""});
+    }
+    MusicLibrary library;
+    report.add(time_once("search_build", "", song_count, song_count, [&] { library.add_songs(batch); }));
+
+    // Selective queries (the common case) and one broad two-letter prefix
+    const char* const queries[] = {"night 4242", "love heart 77", "album 1999", "artist 12", "ove hea 5", "go"};
+    for (const char* query : queries) {
+        std::vector<Result> runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            runs.push_back(time_ops("search", query, song_count, 20, [&](size_t) { library.search(query); }, 1));
+        }
+        report.add_runs(runs);
+    }
+}
+
+static void bench_snapshot(const Options& options, Report& report, size_t song_count) {
+    MusicLibrary library;
+    library.add_songs(CatalogGenerator::songs(song_count));
+    library.publish();
+
+    // Publishing after a batch of edits that keep the order (loudness
+    // results), and after one that doesn't (an added song)
+    const size_t edit_batch = 64;
+    std::mt19937_64 rng(23);
+    auto edit_some = [&](float value) {
+        std::vector<LoudnessResult> results;
+        for (size_t i = 0; i < edit_batch; ++i) {
+            results.push_back({library.get_song(static_cast<SongId>(rng() % song_count))->file_path, value, value});
+        }
+        library.apply_loudness(results);
+    };
+    size_t added = 0;
+    std::vector<Result> edit_runs, add_runs;
+    for (size_t run = 0; run < options.runs; ++run) {
+        edit_runs.push_back(time_ops("snapshot", "publish_edits", song_count, 200, [&](size_t i) {
+            edit_some(-float(i));
+            library.publish();
+        }, 1));
+        add_runs.push_back(time_ops("snapshot", "publish_add", song_count, 50, [&](size_t) {
+            library.add_song(CatalogGenerator::song(song_count + added++));
+            library.publish();
+        }, 1));
+    }
+    report.add_runs(edit_runs);
+    report.add_runs(add_runs);
+
+    // Readers on 1..32 threads while a writer keeps editing, adding one
+    // song and publishing. Every snapshot a reader sees is checked: it must
+    // hold exactly the songs added by the publishes before it, and no edit
+    // may be half there.
+    std::shared_ptr<const LibrarySnapshot> first = library.snapshot();
+    const uint64_t base_version = first->get_version();
+    const size_t base_count = static_cast<size_t>(first->get_song_count());
+    const size_t reads_per_thread = 100000;
+    std::atomic<size_t> errors(0);
+    for (size_t threads : {1, 2, 4, 8, 16, 32}) {
+        std::vector<Result> runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            std::atomic<size_t> readers_done(0);
+            std::thread writer([&] {
+                for (size_t round = 1; readers_done.load() < threads; ++round) {
+                    edit_some(-float(round));
+                    library.add_song({"stress " + std::to_string(added), "", "", 0, ""});
+                    added++;
+                    library.publish();
+                }
+            });
+            auto read = [&](size_t thread) {
+                std::mt19937_64 thread_rng(thread * 7919 + run);
+                std::shared_ptr<const LibrarySnapshot> view;
+                size_t bad = 0;
+                for (size_t i = 0; i < reads_per_thread; ++i) {
+                    library.refresh(view);
+                    uint64_t published = view->get_version() - base_version;
+                    size_t count = static_cast<size_t>(view->get_song_count());
+                    const Song* song = view->get_song_by_index(static_cast<int>(thread_rng() % count) + 1);
+                    if (count != base_count + published || !song) {
+                        bad++;
+                        continue;
+                    }
+                    if (song->has_loudness() && song->loudness_lufs != song->true_peak_dbtp) {
+                        bad++; // Both are set by the same edit
+                    }
+                    if (i % 64 == 0) {
+                        const Song* by_title = view->find_song(std::string_view(song->title));
+                        size_t total = 0;
+                        view->list_sorted(SortField::Title, "", 0, 1, total);
+                        bad += !by_title || std::string_view(by_title->title) != std::string_view(song->title) ||
+                               total != count;
+                    }
+                }
+                errors += bad;
+                readers_done++;
+            };
+            runs.push_back(time_once("snapshot", "read_" + std::to_string(threads) + "t", song_count,
+                                     threads * reads_per_thread, [&] {
+                std::vector<std::thread> readers;
+                for (size_t t = 0; t < threads; ++t) {
+                    readers.emplace_back(read, t);
+                }
+                for (std::thread& reader : readers) {
+                    reader.join();
+                }
+            }));
+            writer.join();
+        }
+        report.add_runs(runs);
+    }
+    Result check;
+    check.name = "snapshot";
+    check.variant = "stress_errors";
+    check.size = song_count;
+    check.value = double(errors.load());
+    check.unit = "inconsistent reads";
+    report.add(std::move(check));
+}
+
+static void bench_scan(const Options& options, Report& report, size_t file_count) {
+    // Cold: a fresh library reads every file's tags. Warm: a rescan of the
+    // same library, where every file is unchanged.
+    const std::string root = "bench_scan_tree";
+    write_scan_tree(root, file_count);
+    MusicLibrary library;
+    std::vector<Result> runs;
+    for (size_t run = 0; run < options.runs; ++run) {
+        runs.push_back(time_once("scan", "", file_count, file_count, [&] { library.load_songs_from_directory(root); }));
+    }
+    report.add_runs(runs);
+    std::filesystem::remove_all(root);
+}
+
+static void bench_load_index(const Options& options, Report& report, size_t song_count) {
+    // Startup from a saved index into a fresh library, against adding the
+    // same songs from memory (the library_build case)
+    const std::string path = "bench_library.idx";
+    {
+        MusicLibrary library;
+        library.add_songs(CatalogGenerator::songs(song_count));
+        library.save_index(path);
+    }
+    std::vector<Result> runs;
+    for (size_t run = 0; run < options.runs; ++run) {
+        MusicLibrary library;
+        runs.push_back(time_once("load_index", "", song_count, song_count, [&] { library.load_index(path); }));
+    }
+    report.add_runs(runs);
+    std::remove(path.c_str());
+}
+
+static void bench_resolve(const Options& options, Report& report, size_t file_count) {
+    // Song paths relative to a root that is third in the search list, as when
+    // running from a build directory: probing stats three candidates each time
+    const std::string root = "bench_resolve_tree";
+    write_scan_tree(root, file_count);
+    std::vector<PooledPath> paths;
+    for (size_t i = 0; i < file_count; ++i) {
+        size_t album_number = i / 12;
+        paths.push_back("Artist " + std::to_string(album_number / 8) + "/Album " + std::to_string(album_number) + "/" +
+                        std::to_string(i % 12 + 1) + " - " + make_title(i) + ".mp3");
+    }
+    AssetResolver& resolver = AssetResolver::instance();
+    std::vector<std::string> saved_roots = resolver.get_search_roots();
+    resolver.set_search_roots({"", "./", root + "/"});
+    std::vector<Result> probe_runs, cached_runs;
+    for (size_t run = 0; run < options.runs; ++run) {
+        probe_runs.push_back(time_ops("resolve", "probe", file_count, file_count, [&](size_t i) {
+            resolver.find_file(paths[i].str());
+        }));
+        cached_runs.push_back(time_ops("resolve", "cached", file_count, file_count, [&](size_t i) {
+            resolver.resolve(paths[i]);
+        }));
+    }
+    report.add_runs(probe_runs);
+    report.add_runs(cached_runs);
+    resolver.set_search_roots(saved_roots);
+    std::filesystem::remove_all(root);
+}
+
+static void bench_loudness(const Options& options, Report& report) {
+    // Decoded PCM straight into the meter, so this is the analysis cost
+    // alone; decoding adds its own, codec-dependent, share per file
+    struct Layout {
+        const char* variant;
+        unsigned rate;
+        unsigned channels;
+    };
+    const Layout layouts[] = {{"mono_44k", 44100, 1}, {"stereo_44k", 44100, 2}, {"5.1_48k", 48000, 6}};
+    const size_t audio_seconds = 30;
+    const size_t chunk_frames = 8192;
+    for (const Layout& layout : layouts) {
+        size_t frames = audio_seconds * layout.rate;
+        std::vector<int16_t> pcm(frames * layout.channels);
+        std::mt19937 rng(5);
+        for (size_t i = 0; i < pcm.size(); ++i) {
+            double tone = 6000.0 * std::sin(2 * 3.14159265358979 * 440.0 * double(i / layout.channels) / layout.rate);
+            pcm[i] = static_cast<int16_t>(tone + static_cast<int>(rng() % 8001) - 4000);
+        }
+        std::vector<Result> runs;
+        double best_seconds = 0;
+        for (size_t run = 0; run < options.runs; ++run) {
+            Result r = time_once("loudness", layout.variant, audio_seconds, frames, [&] {
+                LoudnessMeter meter(layout.rate, layout.channels);
+                for (size_t f = 0; f < frames; f += chunk_frames) {
+                    meter.add_frames(&pcm[f * layout.channels], std::min(chunk_frames, frames - f));
+                }
+                volatile double sink = meter.integrated_lufs() + meter.true_peak_dbtp();
+                (void)sink;
+            });
+            best_seconds = run == 0 ? r.seconds : std::min(best_seconds, r.seconds);
+            runs.push_back(std::move(r));
+        }
+        report.add_runs(runs);
+        Result realtime;
+        realtime.name = "loudness";
+        realtime.variant = layout.variant;
+        realtime.size = audio_seconds;
+        realtime.value = best_seconds > 0 ? audio_seconds / best_seconds : 0;
+        realtime.unit = "x realtime/core";
+        report.add(std::move(realtime));
+    }
+}
+
+static void bench_waveform(const Options& options, Report& report) {
+    // Peaks from decoded PCM (decoding itself not included), then lookups
+    // in a saved cache of track_count three-minute tracks
+    const unsigned rate = 44100, channels = 2;
+    const size_t audio_seconds = 180;
+    const size_t frames = audio_seconds * rate;
+    std::vector<int16_t> pcm(frames * channels);
+    std::mt19937 rng(9);
+    for (int16_t& sample : pcm) {
+        sample = static_cast<int16_t>(static_cast<int>(rng() % 40001) - 20000);
+    }
+    std::vector<Result> runs;
+    double best_seconds = 0;
+    WaveformPeaks peaks;
+    for (size_t run = 0; run < options.runs; ++run) {
+        Result r = time_once("waveform", "build", audio_seconds, frames, [&] {
+            WaveformPeaks::Builder builder(rate, channels);
+            for (size_t f = 0; f < frames; f += 8192) {
+                builder.add_frames(&pcm[f * channels], std::min<size_t>(8192, frames - f));
+            }
+            peaks = builder.finish();
+        });
+        best_seconds = run == 0 ? r.seconds : std::min(best_seconds, r.seconds);
+        runs.push_back(std::move(r));
+    }
+    report.add_runs(runs);
+    Result realtime;
+    realtime.name = "waveform";
+    realtime.variant = "build";
+    realtime.size = audio_seconds;
+    realtime.value = best_seconds > 0 ? audio_seconds / best_seconds : 0;
+    realtime.unit = "x realtime/core";
+    report.add(std::move(realtime));
+
+    const size_t track_count = 200;
+    const std::string cache_file = "bench_waveforms.cache";
+    std::vector<PooledPath> paths;
+    {
+        WaveformCache cache;
+        FileStamp stamp;
+        for (size_t i = 0; i < track_count; ++i) {
+            paths.push_back("Music/Track " + std::to_string(i) + ".mp3");
+            cache.put(paths.back(), stamp, peaks);
+        }
+        cache.save(cache_file);
+    }
+    Result bytes;
+    bytes.name = "waveform";
+    bytes.variant = "cache_size";
+    bytes.size = track_count;
+    bytes.value = double(std::filesystem::file_size(cache_file)) / track_count / 1024.0;
+    bytes.unit = "KB/track";
+    report.add(std::move(bytes));
+
+    // First lookup copies the entry out of the mapping; later ones share it
+    WaveformCache cache;
+    cache.open(cache_file);
+    std::vector<Result> get_runs;
+    for (size_t run = 0; run < std::max<size_t>(options.runs, 2); ++run) {
+        get_runs.push_back(time_ops("waveform", "get", track_count, track_count,
+                                    [&](size_t i) { cache.get(paths[i]); }, 1));
+    }
+    report.add_runs(get_runs);
+    std::filesystem::remove(cache_file);
+}
+
+static void bench_fingerprint(const Options& options, Report& report) {
+    // Extraction from decoded PCM: a minute of random three-note chords,
+    // which gives spectral peaks much like real music does
+    const unsigned rate = 44100, channels = 2;
+    const size_t audio_seconds = 60;
+    const size_t frames = audio_seconds * rate;
+    std::vector<int16_t> pcm(frames * channels);
+    std::mt19937 rng(11);
+    double tones[3] = {};
+    for (size_t f = 0; f < frames; ++f) {
+        if (f % (rate / 4) == 0) {
+            for (double& tone : tones) {
+                tone = 110.0 * std::pow(2.0, double(rng() % 48) / 12.0);
+            }
+        }
+        double t = double(f) / rate, value = 0;
+        for (double tone : tones) {
+            value += 6000.0 * std::sin(2 * 3.14159265358979 * tone * t);
+        }
+        for (unsigned c = 0; c < channels; ++c) {
+            pcm[f * channels + c] = static_cast<int16_t>(value);
+        }
+    }
+    std::vector<Result> runs;
+    double best_seconds = 0;
+    size_t landmark_count = 0;
+    for (size_t run = 0; run < options.runs; ++run) {
+        Result r = time_once("fingerprint", "extract", audio_seconds, frames, [&] {
+            Fingerprinter fingerprinter(rate, channels);
+            for (size_t f = 0; f < frames; f += 8192) {
+                fingerprinter.add_frames(&pcm[f * channels], std::min<size_t>(8192, frames - f));
+            }
+            landmark_count = fingerprinter.finish().size();
+        });
+        best_seconds = run == 0 ? r.seconds : std::min(best_seconds, r.seconds);
+        runs.push_back(std::move(r));
+    }
+    report.add_runs(runs);
+    Result realtime;
+    realtime.name = "fingerprint";
+    realtime.variant = "extract";
+    realtime.size = audio_seconds;
+    realtime.value = best_seconds > 0 ? audio_seconds / best_seconds : 0;
+    realtime.unit = "x realtime/core";
+    report.add(std::move(realtime));
+
+    // Matching: an index of track_count tracks with a three-minute track's
+    // worth of landmarks each, one in a hundred a trimmed copy of another
+    const size_t landmarks_per_track = std::max<size_t>(landmark_count * 3, 1);
+    const size_t max_tracks = 100000; // Postings take 12 bytes each
+    for (size_t track_count : options.sizes) {
+        if (track_count > max_tracks) {
+            continue;
+        }
+        DuplicateFinder finder;
+        std::mt19937 track_rng(13);
+        std::vector<Landmark> landmarks(landmarks_per_track);
+        for (size_t track = 0; track < track_count; ++track) {
+            if (track % 100 == 1) {
+                // The last track minus its first tenth, so shifted
+                std::vector<Landmark> copy;
+                for (const Landmark& landmark : landmarks) {
+                    if (landmark.frame >= 100) {
+                        copy.push_back({landmark.hash, landmark.frame - 100});
+                    }
+                }
+                finder.add(static_cast<uint32_t>(track), copy);
+                continue;
+            }
+            for (size_t i = 0; i < landmarks_per_track; ++i) {
+                landmarks[i] = {static_cast<uint32_t>(track_rng()), static_cast<uint32_t>(i * 4)};
+            }
+            finder.add(static_cast<uint32_t>(track), landmarks);
+        }
+        std::vector<Result> match_runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            match_runs.push_back(time_once("fingerprint", "match", track_count, track_count, [&] {
+                volatile size_t sink = finder.find().size();
+                (void)sink;
+            }));
+        }
+        report.add_runs(match_runs);
+    }
+}
+
+// A sine tone (or, at frequency 0, a constant level) as a decoded track
+class ToneSource : public PcmSource {
+public:
+    ToneSource(unsigned rate, unsigned channels, uint64_t frames, double frequency, double level)
+        : rate(rate), channels(channels), frames(frames), frequency(frequency), level(level) {}
+    unsigned get_sample_rate() const override { return rate; }
+    unsigned get_channel_count() const override { return channels; }
+    uint64_t get_frame_count() const override { return frames; }
+    size_t read(int16_t* samples, size_t frame_capacity) override {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(frame_capacity, frames - position));
+        for (size_t f = 0; f < count; ++f, ++position) {
+            double value = frequency > 0 ? level * std::sin(2 * 3.14159265358979 * frequency * double(position) / rate)
+                                         : level;
+            for (unsigned c = 0; c < channels; ++c) {
+                samples[f * channels + c] = static_cast<int16_t>(value);
+            }
+        }
+        return count;
+    }
+
+private:
+    unsigned rate, channels;
+    uint64_t frames, position = 0;
+    double frequency, level;
+};
+
+static void bench_mixer(const Options& options, Report& report) {
+    // The output callback's share of playback: render() per chunk, as SFML
+    // would call it, with the decoders running on their own threads. Chunks
+    // are paced a millisecond apart rather than in real time, which still
+    // leaves the decoders ample time to keep up.
+    const size_t audio_seconds = 20;
+    const uint64_t track_frames = audio_seconds * MixEngine::OUTPUT_RATE;
+    const size_t chunk = MixEngine::CHUNK_FRAMES;
+    std::vector<int16_t> out(chunk * MixEngine::OUTPUT_CHANNELS);
+    struct Variant {
+        const char* name;
+        unsigned rate;
+        double crossfade; // Seconds; the second track fades in over the first's end
+    };
+    const Variant variants[] = {{"single", 44100, -1}, {"single_48k", 48000, -1}, {"crossfade_10s", 44100, 10}};
+    for (const Variant& variant : variants) {
+        std::vector<Result> runs;
+        double best_seconds = 0;
+        uint64_t underruns = 0;
+        for (size_t run = 0; run < options.runs; ++run) {
+            MixEngine engine(false);
+            size_t source_frames = static_cast<size_t>(track_frames * variant.rate / MixEngine::OUTPUT_RATE);
+            engine.play(std::make_unique<ToneSource>(variant.rate, 2, source_frames, 440.0, 8000.0), 0, 0.8f);
+            size_t chunks = track_frames / chunk;
+            if (variant.crossfade >= 0) {
+                engine.set_crossfade(variant.crossfade, FadeCurve::EqualPower);
+                engine.prepare(std::make_unique<ToneSource>(variant.rate, 2, source_frames, 660.0, 8000.0), 1, 0.8f);
+                engine.queue(1);
+                chunks = static_cast<size_t>((2 * audio_seconds - variant.crossfade) * MixEngine::OUTPUT_RATE) / chunk;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20)); // Decoders fill their rings
+            Result r;
+            r.name = "mixer";
+            r.variant = variant.name;
+            r.size = audio_seconds;
+            r.ops = chunks;
+            for (size_t i = 0; i < chunks; ++i) {
+                auto start = Clock::now();
+                engine.render(out.data(), chunk);
+                double ns = elapsed_ns(start, Clock::now());
+                r.samples_ns.push_back(ns);
+                r.seconds += ns / 1e9;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            underruns += engine.get_stats().underruns;
+            best_seconds = run == 0 ? r.seconds : std::min(best_seconds, r.seconds);
+            runs.push_back(std::move(r));
+        }
+        report.add_runs(runs);
+        double rendered = double(runs.empty() ? 0 : runs[0].ops * chunk) / MixEngine::OUTPUT_RATE;
+        Result realtime;
+        realtime.name = "mixer";
+        realtime.variant = variant.name;
+        realtime.size = audio_seconds;
+        realtime.value = best_seconds > 0 ? rendered / best_seconds : 0;
+        realtime.unit = "x realtime/core";
+        report.add(std::move(realtime));
+        Result dropouts;
+        dropouts.name = "mixer";
+        dropouts.variant = variant.name;
+        dropouts.size = audio_seconds;
+        dropouts.value = double(underruns);
+        dropouts.unit = "underruns";
+        report.add(std::move(dropouts));
+    }
+
+    // Gapless: two constant levels back to back, lengths that don't divide
+    // into chunks. Any silent frame between them (after the limiter's
+    // look-ahead) is a gap.
+    MixEngine engine(false);
+    const uint64_t first = MixEngine::OUTPUT_RATE / 3 + 17, second = MixEngine::OUTPUT_RATE / 5;
+    const size_t lead = Limiter::DELAY_FRAMES, total = lead + first + second;
+    engine.play(std::make_unique<ToneSource>(MixEngine::OUTPUT_RATE, 2, first, 0, 8000.0), 0, 1.0f);
+    engine.prepare(std::make_unique<ToneSource>(MixEngine::OUTPUT_RATE, 1, second, 0, 4000.0), 1, 1.0f);
+    engine.queue(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<int16_t> all(total * MixEngine::OUTPUT_CHANNELS);
+    for (size_t done = 0; done < total; done += chunk) {
+        size_t count = std::min<size_t>(chunk, total - done);
+        engine.render(&all[done * MixEngine::OUTPUT_CHANNELS], count);
+    }
+    Result gap;
+    gap.name = "mixer";
+    gap.variant = "gapless_gap";
+    gap.size = 2;
+    gap.value = double(std::count(all.begin() + lead * MixEngine::OUTPUT_CHANNELS, all.end(), int16_t(0)) /
+                       MixEngine::OUTPUT_CHANNELS);
+    gap.unit = "frames";
+    report.add(std::move(gap));
+}
+
+static void bench_dsp(const Options& options, Report& report) {
+    // Playback processing per second of audio, on stereo float in
+    // CHUNK_FRAMES blocks as the mixer and decoders run it
+    const size_t audio_seconds = 30;
+    const size_t chunk = MixEngine::CHUNK_FRAMES;
+    std::mt19937 rng(17);
+    auto make_input = [&](unsigned rate) {
+        // A tone with noise, peaking past full scale so the limiter works
+        std::vector<float> input(audio_seconds * rate * 2);
+        for (size_t i = 0; i < input.size(); ++i) {
+            double t = double(i / 2) / rate;
+            input[i] = static_cast<float>(0.9 * std::sin(2 * 3.14159265358979 * 220.0 * t) +
+                                          0.3 * (double(rng() % 20001) / 10000.0 - 1.0));
+        }
+        return input;
+    };
+    auto add_cost = [&](const char* variant, std::vector<Result>& runs) {
+        double best = runs.front().seconds;
+        for (const Result& r : runs) {
+            best = std::min(best, r.seconds);
+        }
+        report.add_runs(runs);
+        Result cost;
+        cost.name = "dsp";
+        cost.variant = variant;
+        cost.size = audio_seconds;
+        cost.value = best / audio_seconds * 1e6;
+        cost.unit = "us/audio s";
+        report.add(std::move(cost));
+    };
+
+    const std::vector<float> input = make_input(MixEngine::OUTPUT_RATE);
+    const size_t frames = input.size() / 2;
+    std::vector<float> buffer(chunk * 2);
+    struct Stage {
+        const char* variant;
+        std::function<std::unique_ptr<DspStage>()> make;
+    };
+    const Stage stages[] = {
+        {"eq_flat", [] { return std::make_unique<Equalizer>(MixEngine::OUTPUT_RATE); }},
+        {"eq_5band",
+         [] {
+             auto eq = std::make_unique<Equalizer>(MixEngine::OUTPUT_RATE);
+             eq->set_bands(Equalizer::graphic({4, -3, 2, -2, 5}));
+             return eq;
+         }},
+        {"limiter", [] { return std::make_unique<Limiter>(MixEngine::OUTPUT_RATE); }},
+    };
+    for (const Stage& stage : stages) {
+        std::vector<Result> runs;
+        for (size_t run = 0; run < options.runs; ++run) {
+            std::unique_ptr<DspStage> dsp = stage.make();
+            runs.push_back(time_once("dsp", stage.variant, audio_seconds, frames, [&] {
+                for (size_t f = 0; f < frames; f += chunk) {
+                    size_t count = std::min(chunk, frames - f);
+                    std::copy(&input[f * 2], &input[(f + count) * 2], buffer.begin());
+                    dsp->process(buffer.data(), count);
+                }
+            }));
+        }
+        add_cost(stage.variant, runs);
+    }
+
+    // Decoder side: conversion of a track at another rate, per second of input
+    const unsigned rates[] = {48000, 22050, 96000};
+    for (unsigned rate : rates) {
+        const std::vector<float> source = make_input(rate);
+        const size_t source_frames = source.size() / 2;
+        std::string variant = "resample_" + std::to_string(rate / 1000) + "k";
+        std::vector<Result> runs;
+        std::vector<float> out;
+        for (size_t run = 0; run < options.runs; ++run) {
+            runs.push_back(time_once("dsp", variant, audio_seconds, source_frames, [&] {
+                Resampler resampler(rate, MixEngine::OUTPUT_RATE);
+                for (size_t f = 0; f < source_frames; f += 4096) {
+                    out.clear();
+                    resampler.process(&source[f * 2], std::min<size_t>(4096, source_frames - f), out);
+                }
+                out.clear();
+                resampler.flush(out);
+            }));
+        }
+        add_cost(variant.c_str(), runs);
+    }
+
+    // Output side as played: mixing one deck, EQ and limiter, to int16
+    std::vector<Result> runs;
+    std::vector<int16_t> out(chunk * 2);
+    size_t chunks = audio_seconds * MixEngine::OUTPUT_RATE / chunk;
+    for (size_t run = 0; run < options.runs; ++run) {
+        MixEngine engine(false);
+        engine.get_equalizer().set_bands(Equalizer::graphic({4, -3, 2, -2, 5}));
+        engine.play(std::make_unique<ToneSource>(MixEngine::OUTPUT_RATE, 2, frames, 220.0, 30000.0), 0, 1.2f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Result r;
+        r.name = "dsp";
+        r.variant = "render_chain";
+        r.size = audio_seconds;
+        r.ops = chunks;
+        for (size_t i = 0; i < chunks; ++i) {
+            auto start = Clock::now();
+            engine.render(out.data(), chunk);
+            double ns = elapsed_ns(start, Clock::now());
+            r.samples_ns.push_back(ns);
+            r.seconds += ns / 1e9;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // The decoder keeps up
+        }
+        runs.push_back(std::move(r));
+    }
+    add_cost("render_chain", runs);
+}
+
+static void bench_relink(Report& report, size_t song_count, size_t line_count) {
+    // Every playlist title has been "renamed": one byte replaced, dropped or
+    // doubled, so only the fuzzy matcher can relink it
+    std::mt19937 word_rng(3);
+    std::vector<std::string> vocabulary(50000);
+    for (std::string& word : vocabulary) {
+        size_t length = 3 + word_rng() % 7;
+        for (size_t c = 0; c < length; ++c) {
+            word += static_cast<char>('a' + word_rng() % 26);
+        }
+    }
+    std::vector<Song> batch;
+    batch.reserve(song_count);
+    for (size_t i = 0; i < song_count; ++i) {
+        batch.push_back({make_word_title(vocabulary, i), "Artist " + std::to_string(i % 997), "Album", 200,
+                         "assets/" + std::to_string(i) + ".mp3"});
+    }
+    MusicLibrary library;
+    library.add_songs(batch);
+
+    const std::string filename = "bench_relink.txt";
+    {
+        std::ofstream out(filename);
+        std::mt19937_64 rng(5);
+        for (size_t i = 0; i < line_count; ++i) {
+            std::string title = make_word_title(vocabulary, rng() % song_count);
+            size_t pos = rng() % title.size();
+            switch (rng() % 3) {
+            case 0: title[pos] = 'x'; break;
+            case 1: title.erase(pos, 1); break;
+            default: title.insert(pos, 1, title[pos]); break;
+            }
+            out << title << "|Artist|Album|200|stale/path.mp3\n";
+        }
+    }
+
+    // Runs once: at a million songs this takes many seconds
+    Playlist playlist("bench", false);
+    report.add(time_once("relink", std::to_string(line_count) + " lines", song_count, line_count,
+                         [&] { playlist.load_from_file(filename, library); }));
+    std::remove(filename.c_str());
+}
+
+// Song as it was before the string pool, for the memory comparison
+struct StringSong {
+    std::string title;
+    std::string artist;
+    std::string album;
+    int duration_seconds;
+    std::string file_path;
+};
+
+static size_t heap_in_use() {
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static void bench_song_memory(Report& report, size_t song_count) {
+    std::string title, artist, album, path;
+    size_t before = heap_in_use();
+    std::vector<StringSong> string_songs;
+    string_songs.reserve(song_count);
+    for (size_t i = 0; i < song_count; ++i) {
+        CatalogGenerator::fields(i, title, artist, album, path);
+        string_songs.push_back({title, artist, album, 200, path});
+    }
+    size_t string_bytes = heap_in_use() - before;
+    std::vector<StringSong>().swap(string_songs);
+
+    size_t pool_before = StringPool::instance().memory_bytes();
+    before = heap_in_use();
+    std::vector<Song> pooled_songs;
+    pooled_songs.reserve(song_count);
+    for (size_t i = 0; i < song_count; ++i) {
+        CatalogGenerator::fields(i, title, artist, album, path);
+        pooled_songs.push_back({title, artist, album, 200, path});
+    }
+    size_t pooled_bytes = heap_in_use() - before;
+    size_t pool_bytes = StringPool::instance().memory_bytes() - pool_before;
+
+    if (string_bytes == 0) {
+        std::fprintf(stderr, "song_memory: heap statistics are not available on this platform\n");
+        return;
+    }
+    auto add = [&](const char* variant, double value, const char* unit) {
+        Result r;
+        r.name = "song_memory";
+        r.variant = variant;
+        r.size = song_count;
+        r.value = value;
+        r.unit = unit;
+        report.add(std::move(r));
+    };
+    add("std::string", double(string_bytes) / song_count, "B/song");
+    add("pooled", double(pooled_bytes) / song_count, "B/song");
+    add("pool_only", double(pool_bytes) / song_count, "B/song");
+    add("sizeof_before", sizeof(StringSong), "B");
+    add("sizeof_after", sizeof(Song), "B");
+}
+
+static void bench_logging(Report& report, size_t message_count) {
+    // Both write to /dev/null, so this is the caller-side cost without a
+    // terminal's much slower flushes
+    std::ofstream sink("/dev/null");
+    const std::string title = make_title(12345);
+    report.add(time_ops("log", "std::endl", message_count, message_count, [&](size_t) {
+        sink << "Added '" << title << "' to the music library." << std::endl;
+    }));
+
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    LogLevel level = Logger::instance().get_level();
+    Logger::instance().set_level(LogLevel::Info);
+    report.add(time_ops("log", "logger", message_count, message_count, [&](size_t) {
+        log_info() << "Added '" << title << "' to the music library.";
+    }));
+    report.add(time_once("log", "logger_drain", message_count, 1, [] { Logger::instance().flush(); }));
+    Logger::instance().set_level(level);
+    std::cout.rdbuf(saved);
+}
+
+// --- Command line ---
+
+static bool parse_sizes(const char* text, std::vector<size_t>& out) {
+    out.clear();
+    while (*text) {
+        char* end = nullptr;
+        unsigned long long value = std::strtoull(text, &end, 10);
+        if (end == text || value == 0) {
+            return false;
+        }
+        out.push_back(static_cast<size_t>(value));
+        text = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        auto value = [arg](const char* prefix) -> const char* {
+            size_t length = std::strlen(prefix);
+            return std::strncmp(arg, prefix, length) == 0 ? arg + length : nullptr;
+        };
+        if (const char* v = value("--sizes=")) {
+            if (!parse_sizes(v, options.sizes)) return false;
+        } else if (const char* v = value("--scan-files=")) {
+            if (!parse_sizes(v, options.scan_files)) return false;
+        } else if (const char* v = value("--runs=")) {
+            options.runs = std::strtoul(v, nullptr, 10);
+            if (options.runs == 0) return false;
+        } else if (const char* v = value("--format=")) {
+            if (std::strcmp(v, "text") == 0) options.format = Format::Text;
+            else if (std::strcmp(v, "json") == 0) options.format = Format::Json;
+            else if (std::strcmp(v, "csv") == 0) options.format = Format::Csv;
+            else return false;
+        } else if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "Usage: %s [--sizes=N,N,...] [--runs=N] [--scan-files=N,N,...] [--format=text|json|csv] "
+                     "[--filter=NAME]\n"
+                     "Benchmarks: library_build find_song get_song_by_index browse playlist_add playlist_edit "
+                     "playlist_load playlist_save search snapshot load_index scan resolve loudness waveform "
+                     "fingerprint mixer dsp relink song_memory log\n",
+                     argv[0]);
+        return 1;
+    }
+    std::sort(options.sizes.begin(), options.sizes.end());
+    size_t largest = options.sizes.back();
+
+    // The library and playlist log every add; keep only warnings and errors
+    Logger::instance().set_quiet(true);
+    Report report(options.format);
+
+    // First, while the string pool is still empty
+    if (selected(options, "song_memory")) {
+        bench_song_memory(report, largest);
+    }
+    if (selected(options, "log")) {
+        bench_logging(report, largest);
+    }
+    for (size_t song_count : options.sizes) {
+        bench_library(options, report, song_count);
+    }
+    if (selected(options, "search")) {
+        for (size_t song_count : options.sizes) {
+            bench_search(options, report, song_count);
+        }
+    }
+    if (selected(options, "snapshot")) {
+        for (size_t song_count : options.sizes) {
+            bench_snapshot(options, report, song_count);
+        }
+    }
+    if (selected(options, "load_index")) {
+        for (size_t song_count : options.sizes) {
+            bench_load_index(options, report, song_count);
+        }
+    }
+    if (selected(options, "scan")) {
+        for (size_t file_count : options.scan_files) {
+            bench_scan(options, report, file_count);
+        }
+    }
+    if (selected(options, "resolve")) {
+        bench_resolve(options, report, options.scan_files.front());
+    }
+    if (selected(options, "loudness")) {
+        bench_loudness(options, report);
+    }
+    if (selected(options, "waveform")) {
+        bench_waveform(options, report);
+    }
+    if (selected(options, "fingerprint")) {
+        bench_fingerprint(options, report);
+    }
+    if (selected(options, "mixer")) {
+        bench_mixer(options, report);
+    }
+    if (selected(options, "dsp")) {
+        bench_dsp(options, report);
+    }
+    if (selected(options, "relink")) {
+        bench_relink(report, largest, std::max<size_t>(largest / 10, 1));
+    }
+    report.finish();
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "AssetResolver.h"
+#include <algorithm>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+AssetResolver& AssetResolver::instance() {
+    static AssetResolver resolver;
+    return resolver;
+}
+
+AssetResolver::AssetResolver()
+    : roots(std::make_shared<const std::vector<std::string>>(
+          std::vector<std::string>{"", "./", "../", "../../"})),
+      generation(0) {}
+
+static bool is_absolute(std::string_view path) {
+#ifdef _WIN32
+    return (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+#else
+    return !path.empty() && path[0] == '/';
+#endif
+}
+
+static bool exists_as(const std::string& path, bool want_directory) {
+#ifdef _WIN32
+    DWORD attrs = GetFileAttributesA(path.c_str());
+    return attrs != INVALID_FILE_ATTRIBUTES && ((attrs & FILE_ATTRIBUTE_DIRECTORY) != 0) == want_directory;
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (want_directory ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode));
+#endif
+}
+
+std::string AssetResolver::locate(std::string_view path, bool want_directory) const {
+    if (path.empty()) {
+        return std::string();
+    }
+    if (is_absolute(path)) {
+        std::string as_given(path);
+        return exists_as(as_given, want_directory) ? as_given : std::string();
+    }
+    std::shared_ptr<const std::vector<std::string>> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = roots;
+    }
+    std::string candidate;
+    for (const std::string& root : *current) {
+        candidate.assign(root);
+        if (!root.empty() && root.back() != '/' && root.back() != '\\') {
+            candidate += '/';
+        }
+        candidate.append(path);
+#ifdef _WIN32
+        std::replace(candidate.begin(), candidate.end(), '/', '\\');
+#endif
+        if (exists_as(candidate, want_directory)) {
+            return candidate;
+        }
+    }
+    return std::string();
+}
+
+std::string AssetResolver::find_file(std::string_view path) const {
+    return locate(path, false);
+}
+
+std::string AssetResolver::find_directory(std::string_view path) const {
+    return locate(path, true);
+}
+
+std::string AssetResolver::resolve(const PooledPath& file_path) {
+    if (file_path.empty()) {
+        return std::string();
+    }
+    uint64_t seen_generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = resolved.find(file_path);
+        if (it != resolved.end()) {
+            return it->second;
+        }
+        seen_generation = generation;
+    }
+    std::string path = file_path.str();
+    std::string found = locate(path, false);
+    if (found.empty()) {
+        return path; // Not cached: the file may turn up later
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation == seen_generation) {
+        resolved.emplace(file_path, found);
+    }
+    return found;
+}
+
+std::string AssetResolver::resolve(std::string_view file_path) {
+    PooledPath pooled;
+    if (PooledPath::find(file_path, pooled)) {
+        return resolve(pooled);
+    }
+    std::string found = locate(file_path, false);
+    return found.empty() ? std::string(file_path) : found;
+}
+
+bool AssetResolver::invalidate(const PooledPath& file_path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resolved.erase(file_path) > 0;
+}
+
+void AssetResolver::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    resolved.clear();
+    generation++;
+}
+
+void AssetResolver::set_search_roots(std::vector<std::string> new_roots) {
+    std::lock_guard<std::mutex> lock(mutex);
+    roots = std::make_shared<const std::vector<std::string>>(std::move(new_roots));
+    resolved.clear();
+    generation++;
+}
+
+std::vector<std::string> AssetResolver::get_search_roots() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return *roots;
+}
+
+size_t AssetResolver::cached_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resolved.size();
+}
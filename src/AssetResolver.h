@@ -0,0 +1,57 @@
+#ifndef ASSET_RESOLVER_H
+#define ASSET_RESOLVER_H
+
+#include "StringPool.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Finds song files and music directories stored as relative paths by trying
+// each search root in turn (by default the working directory and up to two
+// parents, so running from a build directory still finds the assets).
+// Resolved file paths are remembered per Song::file_path, so playing a song
+// again or preparing the next one costs a hash lookup, not a round of
+// filesystem probes. Misses aren't remembered, and a remembered path that
+// later fails to open should be dropped with invalidate(). Thread-safe.
+class AssetResolver {
+public:
+    static AssetResolver& instance();
+
+    // Where file_path is on disk, probing only the first time; file_path
+    // itself if it isn't found under any root
+    std::string resolve(const PooledPath& file_path);
+    // As above; only cached when file_path is a pooled (library) path
+    std::string resolve(std::string_view file_path);
+
+    // Uncached lookups; empty if nothing is found
+    std::string find_file(std::string_view path) const;
+    std::string find_directory(std::string_view path) const;
+
+    // Forgets file_path's resolution; returns whether there was one
+    bool invalidate(const PooledPath& file_path);
+    void clear(); // E.g. after a rescan, when files may have moved
+
+    // Prefixes tried in order for relative paths; "" is the path as given.
+    // Replacing them clears the cache.
+    void set_search_roots(std::vector<std::string> roots);
+    std::vector<std::string> get_search_roots() const;
+    size_t cached_count() const;
+
+    AssetResolver(const AssetResolver&) = delete;
+    AssetResolver& operator=(const AssetResolver&) = delete;
+
+private:
+    mutable std::mutex mutex;
+    std::shared_ptr<const std::vector<std::string>> roots; // Swapped whole, so probes needn't hold the lock
+    std::unordered_map<PooledPath, std::string, PooledPath::Hash> resolved;
+    uint64_t generation; // Bumped by clear(), so a probe racing it isn't cached
+
+    AssetResolver();
+    std::string locate(std::string_view path, bool want_directory) const;
+};
+
+#endif // ASSET_RESOLVER_H
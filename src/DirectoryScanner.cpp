@@ -0,0 +1,375 @@
+#include "DirectoryScanner.h"
+#include "Logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+bool read_file_stamp(const std::string& path, FileStamp& stamp) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        return false;
+    }
+    stamp.mtime_ns = static_cast<int64_t>(((uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                           data.ftLastWriteTime.dwLowDateTime) * 100);
+    stamp.size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    stamp.mtime_ns = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    stamp.size = static_cast<uint64_t>(st.st_size);
+#endif
+    return true;
+}
+
+DirectoryScanner::DirectoryScanner(unsigned thread_count, size_t batch_size, bool stat_files)
+    : thread_count(thread_count), batch_size(batch_size == 0 ? 1 : batch_size), stat_files(stat_files) {
+    if (this->thread_count == 0) {
+        // Directory reads mostly wait on the disk or the network, so run
+        // more walkers than cores
+        unsigned cores = std::thread::hardware_concurrency();
+        this->thread_count = std::min(64u, std::max(4u, cores * 2));
+    }
+}
+
+#ifndef _WIN32
+
+namespace {
+
+enum class EntryKind { File, Directory, Other };
+
+// Calls fn(dir_fd, name, d_type) for every entry of an open directory except
+// "." and "..". Takes ownership of dir_fd. Returns 0, or the errno that
+// stopped the listing early.
+template <typename Fn>
+int for_each_entry(int dir_fd, Fn fn) {
+    int error = 0;
+#ifdef __linux__
+    struct linux_dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+    alignas(8) char buffer[32 * 1024];
+    while (true) {
+        long bytes = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            if (bytes < 0) {
+                error = errno;
+            }
+            break;
+        }
+        for (long offset = 0; offset < bytes;) {
+            const linux_dirent64* entry = reinterpret_cast<const linux_dirent64*>(buffer + offset);
+            offset += entry->d_reclen;
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            fn(dir_fd, name, entry->d_type);
+        }
+    }
+    close(dir_fd);
+#else
+    DIR* dir = fdopendir(dir_fd);
+    if (!dir) {
+        error = errno;
+        close(dir_fd);
+        return error;
+    }
+    while (true) {
+        errno = 0;
+        dirent* entry = readdir(dir);
+        if (!entry) {
+            error = errno;
+            break;
+        }
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+    #ifdef DT_UNKNOWN
+        fn(dir_fd, name, entry->d_type);
+    #else
+        fn(dir_fd, name, 0);
+    #endif
+    }
+    closedir(dir); // Also closes dir_fd
+#endif
+    return error;
+}
+
+EntryKind classify(int dir_fd, const char* name, unsigned char d_type) {
+    switch (d_type) {
+    case DT_REG: return EntryKind::File;
+    case DT_DIR: return EntryKind::Directory;
+    case DT_LNK: {
+        // Follow links to files, but never links to directories (cycles)
+        struct stat st;
+        if (fstatat(dir_fd, name, &st, 0) == 0 && S_ISREG(st.st_mode)) {
+            return EntryKind::File;
+        }
+        return EntryKind::Other;
+    }
+    case DT_UNKNOWN: {
+        struct stat st;
+        if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return EntryKind::Other;
+        }
+        if (S_ISREG(st.st_mode)) return EntryKind::File;
+        if (S_ISDIR(st.st_mode)) return EntryKind::Directory;
+        if (S_ISLNK(st.st_mode) && fstatat(dir_fd, name, &st, 0) == 0 && S_ISREG(st.st_mode)) {
+            return EntryKind::File;
+        }
+        return EntryKind::Other;
+    }
+    default:
+        return EntryKind::Other;
+    }
+}
+
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::string> directories; // Relative to the root, "" is the root
+};
+
+struct ScanState {
+    int root_fd;
+    std::string root; // For messages
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<size_t> pending{0}; // Directories queued or being read
+    std::atomic<size_t> queued{0}; // Directories waiting in some deque
+    // Workers with nothing to read or steal sleep here until a directory is
+    // pushed or the walk is over
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    std::atomic<size_t> sleepers{0};
+    std::atomic<size_t> directories{0};
+    std::atomic<size_t> entries{0};
+    std::atomic<size_t> matched{0};
+    std::mutex incomplete_mutex;
+    std::vector<std::string> incomplete; // Directories that failed to open or read
+};
+
+void report_unreadable(ScanState& state, const std::string& directory, int error) {
+    log_warning() << "Warning: Could not read directory " << state.root << (directory.empty() ? "" : "/")
+                  << directory << ": " << std::strerror(error);
+    std::lock_guard<std::mutex> lock(state.incomplete_mutex);
+    state.incomplete.push_back(directory);
+}
+
+bool pop_or_steal(ScanState& state, size_t self, std::string& directory) {
+    {
+        WorkQueue& own = *state.queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.directories.empty()) {
+            directory = std::move(own.directories.back());
+            own.directories.pop_back();
+            state.queued.fetch_sub(1);
+            return true;
+        }
+    }
+    size_t count = state.queues.size();
+    for (size_t i = 1; i < count; ++i) {
+        WorkQueue& victim = *state.queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.directories.empty()) {
+            // Steal the oldest entry - closest to the root, so the biggest subtree
+            directory = std::move(victim.directories.front());
+            victim.directories.pop_front();
+            state.queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Blocks until there may be work to steal; false once the walk is over
+bool wait_for_work(ScanState& state) {
+    std::unique_lock<std::mutex> lock(state.idle_mutex);
+    state.sleepers.fetch_add(1);
+    state.idle.wait(lock, [&] { return state.queued.load() > 0 || state.pending.load() == 0; });
+    state.sleepers.fetch_sub(1);
+    return state.pending.load() != 0;
+}
+
+// Wakes sleeping workers after queued or pending changed. Both counters and
+// sleepers are sequentially consistent, so either the waker sees a sleeper
+// or the sleeper sees the change before it blocks.
+void wake_idle(ScanState& state) {
+    if (state.sleepers.load() != 0) {
+        std::lock_guard<std::mutex> lock(state.idle_mutex);
+        state.idle.notify_all();
+    }
+}
+
+FileStamp stamp_of(int dir_fd, const char* name) {
+    FileStamp stamp;
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, 0) == 0) {
+#ifdef __APPLE__
+        stamp.mtime_ns = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        stamp.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+        stamp.size = static_cast<uint64_t>(st.st_size);
+    }
+    return stamp;
+}
+
+void scan_worker(ScanState& state, size_t self, size_t batch_size, bool stat_files,
+                 const DirectoryScanner::FileFilter& filter, const DirectoryScanner::BatchSink& sink) {
+    std::vector<ScannedFile> batch;
+    batch.reserve(batch_size);
+    std::vector<std::string> subdirectories;
+    std::string directory;
+    size_t entries = 0;
+    size_t matched = 0;
+    size_t directories = 0;
+
+    while (true) {
+        if (!pop_or_steal(state, self, directory)) {
+            if (!wait_for_work(state)) {
+                break;
+            }
+            continue;
+        }
+
+        int dir_fd = directory.empty()
+            ? dup(state.root_fd)
+            : openat(state.root_fd, directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0) {
+            // ENOENT: removed since its parent was listed, so its songs really are gone
+            if (errno != ENOENT) {
+                report_unreadable(state, directory, errno);
+            }
+        } else {
+            directories++;
+            std::string prefix = directory.empty() ? std::string() : directory + "/";
+            int error = for_each_entry(dir_fd, [&](int fd, const char* name, unsigned char d_type) {
+                entries++;
+                if (name[0] == '.') {
+                    return;
+                }
+                EntryKind kind = classify(fd, name, d_type);
+                if (kind == EntryKind::Directory) {
+                    subdirectories.push_back(prefix + name);
+                } else if (kind == EntryKind::File) {
+                    std::string filename(name);
+                    if (filter(filename)) {
+                        FileStamp stamp = stat_files ? stamp_of(fd, name) : FileStamp();
+                        batch.push_back({prefix + filename, std::move(filename), stamp});
+                        matched++;
+                        if (batch.size() >= batch_size) {
+                            sink(batch);
+                            batch.clear();
+                        }
+                    }
+                }
+            });
+            if (error != 0) {
+                report_unreadable(state, directory, error);
+            }
+        }
+
+        if (!subdirectories.empty()) {
+            size_t count = subdirectories.size();
+            state.pending.fetch_add(count, std::memory_order_relaxed);
+            state.queued.fetch_add(count); // Before the push, so it never drops below zero
+            {
+                WorkQueue& own = *state.queues[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                for (std::string& subdirectory : subdirectories) {
+                    own.directories.push_back(std::move(subdirectory));
+                }
+            }
+            subdirectories.clear();
+            wake_idle(state);
+        }
+        // Children are counted before the parent is retired, so pending only
+        // reaches zero once the whole tree is done
+        if (state.pending.fetch_sub(1) == 1) {
+            wake_idle(state);
+        }
+    }
+
+    if (!batch.empty()) {
+        sink(batch);
+    }
+    state.entries += entries;
+    state.matched += matched;
+    state.directories += directories;
+}
+
+} // namespace
+
+bool DirectoryScanner::scan(const std::string& root, const FileFilter& filter, const BatchSink& sink, ScanStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+
+    ScanState state;
+    state.root = root;
+    state.root_fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (state.root_fd < 0) {
+        return false;
+    }
+    for (unsigned i = 0; i < thread_count; ++i) {
+        state.queues.emplace_back(new WorkQueue);
+    }
+    state.queues[0]->directories.push_back(std::string());
+    state.pending = 1;
+    state.queued = 1;
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < thread_count; ++i) {
+        workers.emplace_back(scan_worker, std::ref(state), i, batch_size, stat_files, std::cref(filter), std::cref(sink));
+    }
+    scan_worker(state, 0, batch_size, stat_files, filter, sink);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    close(state.root_fd);
+
+    stats.directories = state.directories;
+    stats.entries = state.entries;
+    stats.matched = state.matched;
+    stats.errors = state.incomplete.size();
+    stats.incomplete = std::move(state.incomplete);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+#else
+
+bool DirectoryScanner::scan(const std::string&, const FileFilter&, const BatchSink&, ScanStats&) {
+    // MusicLibrary keeps its FindFirstFileA loader on Windows
+    return false;
+}
+
+#endif
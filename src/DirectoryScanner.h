@@ -0,0 +1,72 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Modification time and size, used to tell whether a file changed since it
+// was last indexed
+struct FileStamp {
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+
+    bool operator==(const FileStamp& other) const { return mtime_ns == other.mtime_ns && size == other.size; }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+// Stamp of the file at path (following symlinks); false if it can't be read
+bool read_file_stamp(const std::string& path, FileStamp& stamp);
+
+struct ScannedFile {
+    std::string relative_path; // Relative to the scan root, '/' separated
+    std::string filename; // Last path component
+    FileStamp stamp; // Only filled when the scanner was asked to stat files
+};
+
+struct ScanStats {
+    size_t directories = 0; // Directories opened
+    size_t entries = 0; // Directory entries seen (files, dirs, others)
+    size_t matched = 0; // Files accepted by the filter
+    size_t errors = 0; // Directories that couldn't be opened or read to the end
+    std::vector<std::string> incomplete; // Their paths, relative to the root ("" for the root itself)
+    double seconds = 0.0;
+
+    double entries_per_second() const { return seconds > 0.0 ? entries / seconds : 0.0; }
+};
+
+// Recursive POSIX directory walker. Each worker owns a deque of pending
+// directories, works depth-first from its back and steals from the front of
+// other workers' deques when it runs dry, sleeping while there is nothing
+// to steal. Directories are opened with openat()
+// relative to the root and read with getdents64 on Linux (readdir elsewhere);
+// d_type decides file vs. directory, falling back to fstatat only when the
+// filesystem reports DT_UNKNOWN or the entry is a symlink.
+class DirectoryScanner {
+public:
+    using FileFilter = std::function<bool(const std::string& filename)>;
+    // Called from worker threads, possibly concurrently; the sink must do its
+    // own locking. The batch may be consumed (moved from).
+    using BatchSink = std::function<void(std::vector<ScannedFile>& batch)>;
+
+    // With stat_files set, every accepted file gets one fstatat() for its stamp
+    explicit DirectoryScanner(unsigned thread_count = 0, size_t batch_size = 512, bool stat_files = false);
+
+    // Hidden entries (leading '.') are skipped, like the Windows loader does.
+    // Returns false if the root could not be opened. A directory that fails
+    // to open or read part way is logged and listed in stats.incomplete; the
+    // walk carries on without it, so callers must not take a file missing
+    // from it as deleted.
+    bool scan(const std::string& root, const FileFilter& filter, const BatchSink& sink, ScanStats& stats);
+
+    unsigned get_thread_count() const { return thread_count; }
+
+private:
+    unsigned thread_count;
+    size_t batch_size;
+    bool stat_files;
+};
+
+#endif // DIRECTORY_SCANNER_H
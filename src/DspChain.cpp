@@ -0,0 +1,85 @@
+#include "DspChain.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define DSP_SSE2 1
+#endif
+
+void scale_stereo(float* frames, size_t frame_count, float from, float to) {
+    if (frame_count == 0) {
+        return;
+    }
+    float step = (to - from) / float(frame_count);
+    size_t f = 0;
+#ifdef DSP_SSE2
+    // Two frames per register: gains g, g, g + step, g + step
+    __m128 gain = _mm_setr_ps(from + step, from + step, from + 2 * step, from + 2 * step);
+    const __m128 advance = _mm_set1_ps(2 * step);
+    for (; f + 2 <= frame_count; f += 2) {
+        _mm_storeu_ps(frames + 2 * f, _mm_mul_ps(_mm_loadu_ps(frames + 2 * f), gain));
+        gain = _mm_add_ps(gain, advance);
+    }
+#endif
+    for (; f < frame_count; ++f) {
+        float g = from + step * float(f + 1);
+        frames[2 * f] *= g;
+        frames[2 * f + 1] *= g;
+    }
+}
+
+void add_stereo(float* out, const float* in, size_t frame_count) {
+    size_t count = frame_count * 2, i = 0;
+#ifdef DSP_SSE2
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(in + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] += in[i];
+    }
+}
+
+float peak_abs(const float* samples, size_t count) {
+    float peak = 0;
+    size_t i = 0;
+#ifdef DSP_SSE2
+    if (count >= 8) {
+        // Two accumulators, so consecutive maxima don't wait on each other
+        const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 peak0 = _mm_setzero_ps(), peak1 = _mm_setzero_ps();
+        for (; i + 8 <= count; i += 8) {
+            peak0 = _mm_max_ps(peak0, _mm_and_ps(_mm_loadu_ps(samples + i), magnitude));
+            peak1 = _mm_max_ps(peak1, _mm_and_ps(_mm_loadu_ps(samples + i + 4), magnitude));
+        }
+        __m128 peaks = _mm_max_ps(peak0, peak1);
+        peaks = _mm_max_ps(peaks, _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(1, 0, 3, 2)));
+        peaks = _mm_max_ps(peaks, _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(2, 3, 0, 1)));
+        peak = _mm_cvtss_f32(peaks);
+    }
+#endif
+    for (; i < count; ++i) {
+        peak = std::max(peak, std::fabs(samples[i]));
+    }
+    return peak;
+}
+
+void DspChain::add(std::unique_ptr<DspStage> stage) {
+    stages.push_back(std::move(stage));
+}
+
+void DspChain::insert(size_t position, std::unique_ptr<DspStage> stage) {
+    stages.insert(stages.begin() + std::min(position, stages.size()), std::move(stage));
+}
+
+void DspChain::process(float* frames, size_t frame_count) {
+    for (const std::unique_ptr<DspStage>& stage : stages) {
+        stage->process(frames, frame_count);
+    }
+}
+
+void DspChain::reset() {
+    for (const std::unique_ptr<DspStage>& stage : stages) {
+        stage->reset();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Playback processing works on interleaved stereo float frames, full scale
+// = 1, at the mixer's output rate. These kernels are the inner loops the
+// stages and the mixer share; they use SSE2 where available, scalar loops
+// elsewhere.
+
+// Multiplies each frame by a gain ramping linearly from `from` (before the
+// first frame) to `to` (at the last), so a gain change doesn't click
+void scale_stereo(float* frames, size_t frame_count, float from, float to);
+void add_stereo(float* out, const float* in, size_t frame_count); // out += in
+float peak_abs(const float* samples, size_t count); // Largest |sample|
+
+// One step of processing that keeps the frame count: EQ, limiting, ...
+// process() runs on the output thread, so it must not allocate, lock or
+// wait; settings changed from other threads must reach it without locks.
+class DspStage {
+public:
+    virtual ~DspStage() = default;
+    virtual void process(float* frames, size_t frame_count) = 0;
+    virtual void reset() = 0; // Forget the signal so far (filter state, delay lines)
+};
+
+// Stages run in the order they were added. The chain itself is not
+// thread-safe: add stages before processing starts.
+class DspChain {
+public:
+    void add(std::unique_ptr<DspStage> stage);
+    // Before the stage at position; stages are added while processing is stopped
+    void insert(size_t position, std::unique_ptr<DspStage> stage);
+    size_t size() const { return stages.size(); }
+
+    void process(float* frames, size_t frame_count);
+    void reset();
+
+private:
+    std::vector<std::unique_ptr<DspStage>> stages;
+};
+
+#endif // DSP_CHAIN_H
@@ -0,0 +1,157 @@
+#include "DuplicateFinder.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+// Votes are packed as first (24 bits) | second (24 bits) | offset (16 bits)
+// so sorting them groups each pair's votes by offset
+static const int OFFSET_BIAS = 1 << 15;
+static const unsigned PARTITION_BITS = 8; // Postings are sorted in 256 parts by hash, in parallel
+
+static uint64_t vote_key(uint32_t first, uint32_t second, int32_t offset) {
+    return uint64_t(first) << 40 | uint64_t(second) << 16 | uint64_t(offset + OFFSET_BIAS);
+}
+
+void DuplicateFinder::add(uint32_t track, const std::vector<Landmark>& landmarks) {
+    if (track >= MAX_TRACKS) {
+        return;
+    }
+    if (landmark_counts.size() <= track) {
+        landmark_counts.resize(track + 1, 0);
+    }
+    landmark_counts[track] += static_cast<uint32_t>(landmarks.size());
+    for (const Landmark& landmark : landmarks) {
+        postings.push_back({landmark.hash, track, landmark.frame});
+    }
+}
+
+std::vector<DuplicateFinder::Match> DuplicateFinder::find(uint32_t min_votes, double min_fraction) const {
+    // Partition by the top hash bits, then each part is an independent index
+    const size_t part_count = size_t(1) << PARTITION_BITS;
+    std::vector<size_t> starts(part_count + 1, 0);
+    for (const Posting& p : postings) {
+        starts[(p.hash >> (32 - PARTITION_BITS)) + 1]++;
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<Posting> sorted(postings.size());
+    {
+        std::vector<size_t> cursor(starts.begin(), starts.end() - 1);
+        for (const Posting& p : postings) {
+            sorted[cursor[p.hash >> (32 - PARTITION_BITS)]++] = p;
+        }
+    }
+
+    std::vector<std::vector<uint64_t>> part_votes(part_count);
+    parallel_for(part_count, [&](size_t part) {
+        auto begin = sorted.begin() + starts[part];
+        auto end = sorted.begin() + starts[part + 1];
+        std::sort(begin, end, [](const Posting& a, const Posting& b) {
+            return a.hash != b.hash ? a.hash < b.hash : a.track < b.track;
+        });
+        std::vector<uint64_t>& votes = part_votes[part];
+        for (auto run = begin; run != end;) {
+            auto run_end = run;
+            while (run_end != end && run_end->hash == run->hash) {
+                ++run_end;
+            }
+            if (run_end - run <= static_cast<long>(MAX_POSTINGS)) {
+                for (auto a = run; a != run_end; ++a) {
+                    for (auto b = a + 1; b != run_end; ++b) {
+                        if (a->track != b->track) { // Sorted, so a->track < b->track
+                            int32_t offset = int32_t(b->frame) - int32_t(a->frame);
+                            if (offset > -OFFSET_BIAS && offset < OFFSET_BIAS) {
+                                votes.push_back(vote_key(a->track, b->track, offset));
+                            }
+                        }
+                    }
+                }
+            }
+            run = run_end;
+        }
+        std::sort(votes.begin(), votes.end());
+    });
+
+    // Count votes per (pair, offset), merging the parts
+    std::unordered_map<uint64_t, uint32_t> counts;
+    for (const std::vector<uint64_t>& votes : part_votes) {
+        for (size_t i = 0; i < votes.size();) {
+            size_t j = i;
+            while (j < votes.size() && votes[j] == votes[i]) {
+                ++j;
+            }
+            counts[votes[i]] += static_cast<uint32_t>(j - i);
+            i = j;
+        }
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> tallies(counts.begin(), counts.end());
+    std::sort(tallies.begin(), tallies.end());
+
+    // For each pair, the offset with the most votes counting its neighbours
+    // (a frame boundary can fall either side of a landmark)
+    std::vector<Match> matches;
+    for (size_t i = 0; i < tallies.size();) {
+        uint64_t pair = tallies[i].first >> 16;
+        size_t j = i;
+        while (j < tallies.size() && (tallies[j].first >> 16) == pair) {
+            ++j;
+        }
+        Match best = {static_cast<uint32_t>(pair >> 24), static_cast<uint32_t>(pair & 0xFFFFFF), 0, 0};
+        for (size_t k = i; k < j; ++k) {
+            int32_t offset = int32_t(tallies[k].first & 0xFFFF) - OFFSET_BIAS;
+            uint32_t votes = tallies[k].second;
+            if (k > i && (tallies[k - 1].first & 0xFFFF) + 1 == (tallies[k].first & 0xFFFF)) {
+                votes += tallies[k - 1].second;
+            }
+            if (k + 1 < j && (tallies[k].first & 0xFFFF) + 1 == (tallies[k + 1].first & 0xFFFF)) {
+                votes += tallies[k + 1].second;
+            }
+            if (votes > best.votes) {
+                best.votes = votes;
+                best.offset_frames = offset;
+            }
+        }
+        uint32_t smaller = std::min(landmark_counts[best.first], landmark_counts[best.second]);
+        if (best.votes >= min_votes && best.votes >= min_fraction * smaller) {
+            matches.push_back(best);
+        }
+        i = j;
+    }
+    return matches;
+}
+
+std::vector<std::vector<uint32_t>> DuplicateFinder::group(const std::vector<Match>& matches) {
+    std::unordered_map<uint32_t, uint32_t> parent;
+    auto find_root = [&parent](uint32_t track) {
+        auto it = parent.emplace(track, track).first;
+        uint32_t root = it->second;
+        while (parent[root] != root) {
+            root = parent[root];
+        }
+        // Path compression
+        for (uint32_t node = track; parent[node] != root;) {
+            uint32_t next = parent[node];
+            parent[node] = root;
+            node = next;
+        }
+        return root;
+    };
+    for (const Match& match : matches) {
+        uint32_t a = find_root(match.first);
+        uint32_t b = find_root(match.second);
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+    std::unordered_map<uint32_t, std::vector<uint32_t>> by_root;
+    for (const auto& entry : parent) {
+        by_root[find_root(entry.first)].push_back(entry.first);
+    }
+    std::vector<std::vector<uint32_t>> groups;
+    for (auto& entry : by_root) {
+        std::sort(entry.second.begin(), entry.second.end());
+        groups.push_back(std::move(entry.second));
+    }
+    std::sort(groups.begin(), groups.end());
+    return groups;
+}
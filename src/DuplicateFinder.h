@@ -0,0 +1,50 @@
+#ifndef DUPLICATE_FINDER_H
+#define DUPLICATE_FINDER_H
+
+#include "Fingerprint.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds tracks that are the same recording from their fingerprints, with an
+// inverted index from landmark hash to (track, frame) postings. Tracks that
+// share a hash vote for each other at the time offset between the two
+// landmarks; a pair is a duplicate when enough votes agree on one offset,
+// so trimmed or padded copies still match. Hashes shared by more than
+// MAX_POSTINGS landmarks say nothing and are skipped, which keeps the
+// work close to linear in the number of landmarks.
+class DuplicateFinder {
+public:
+    static const size_t MAX_POSTINGS = 32;
+    static const uint32_t MAX_TRACKS = 1u << 24;
+
+    struct Match {
+        uint32_t first; // first < second
+        uint32_t second;
+        uint32_t votes; // Landmarks agreeing on the best offset (and its neighbours)
+        int32_t offset_frames; // second's frame minus first's for those landmarks
+    };
+
+    // Tracks are numbered by the caller, below MAX_TRACKS
+    void add(uint32_t track, const std::vector<Landmark>& landmarks);
+    size_t posting_count() const { return postings.size(); }
+
+    // Pairs whose best offset has at least min_votes votes and at least
+    // min_fraction of the smaller track's landmarks. Runs on all cores.
+    std::vector<Match> find(uint32_t min_votes = 8, double min_fraction = 0.05) const;
+
+    // Matches joined into groups of mutually duplicate tracks, each sorted
+    static std::vector<std::vector<uint32_t>> group(const std::vector<Match>& matches);
+
+private:
+    struct Posting {
+        uint32_t hash;
+        uint32_t track;
+        uint32_t frame;
+    };
+
+    std::vector<Posting> postings;
+    std::vector<uint32_t> landmark_counts; // By track
+};
+
+#endif // DUPLICATE_FINDER_H
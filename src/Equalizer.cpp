@@ -0,0 +1,147 @@
+#include "Equalizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define EQUALIZER_SSE2 1
+#endif
+
+static const double PI = 3.14159265358979323846;
+
+Equalizer::Equalizer(unsigned sample_rate) : sample_rate(sample_rate), middle(1), back(2), front(0) {
+    for (Settings& slot : slots) {
+        slot.band_count = 0;
+    }
+    reset();
+}
+
+Equalizer::Biquad Equalizer::design(const EqBand& band, unsigned sample_rate) {
+    Biquad flat = {1, 0, 0, 0, 0, false};
+    if (std::fabs(band.gain_db) < 0.01 || sample_rate == 0) {
+        return flat;
+    }
+    double frequency = std::min(std::max(band.frequency, 10.0), 0.49 * sample_rate);
+    double a = std::pow(10.0, band.gain_db / 40.0);
+    double w0 = 2 * PI * frequency / sample_rate;
+    double cos_w0 = std::cos(w0);
+    double alpha = std::sin(w0) / (2 * std::max(band.q, 0.1));
+    double b0, b1, b2, a0, a1, a2;
+    switch (band.type) {
+    case EqBand::LowShelf: {
+        double k = 2 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cos_w0 + k);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cos_w0);
+        b2 = a * ((a + 1) - (a - 1) * cos_w0 - k);
+        a0 = (a + 1) + (a - 1) * cos_w0 + k;
+        a1 = -2 * ((a - 1) + (a + 1) * cos_w0);
+        a2 = (a + 1) + (a - 1) * cos_w0 - k;
+        break;
+    }
+    case EqBand::HighShelf: {
+        double k = 2 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cos_w0 + k);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cos_w0);
+        b2 = a * ((a + 1) + (a - 1) * cos_w0 - k);
+        a0 = (a + 1) - (a - 1) * cos_w0 + k;
+        a1 = 2 * ((a - 1) - (a + 1) * cos_w0);
+        a2 = (a + 1) - (a - 1) * cos_w0 - k;
+        break;
+    }
+    case EqBand::Peaking:
+    default:
+        b0 = 1 + alpha * a;
+        b1 = -2 * cos_w0;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha / a;
+        break;
+    }
+    return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0, true};
+}
+
+void Equalizer::set_bands(const std::vector<EqBand>& bands) {
+    Settings& settings = slots[back];
+    settings.band_count = std::min(bands.size(), MAX_BANDS);
+    for (size_t b = 0; b < settings.band_count; ++b) {
+        settings.bands[b] = design(bands[b], sample_rate);
+    }
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+std::vector<EqBand> Equalizer::graphic(const std::vector<double>& gains_db) {
+    std::vector<EqBand> bands;
+    for (size_t b = 0; b < GRAPHIC_BAND_COUNT; ++b) {
+        EqBand::Type type = b == 0 ? EqBand::LowShelf : b + 1 == GRAPHIC_BAND_COUNT ? EqBand::HighShelf : EqBand::Peaking;
+        // Peaks two octaves apart: Q 0.67 spans the gap between neighbours
+        double q = type == EqBand::Peaking ? 0.67 : 0.71;
+        bands.push_back({type, GRAPHIC_FREQUENCIES[b], b < gains_db.size() ? gains_db[b] : 0.0, q});
+    }
+    return bands;
+}
+
+void Equalizer::process(float* frames, size_t frame_count) {
+    if (middle.load(std::memory_order_relaxed) & FRESH) {
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        // Bands that went away or flat start from silence if they come back
+        const Settings& settings = slots[front];
+        for (size_t b = 0; b < MAX_BANDS; ++b) {
+            if (b >= settings.band_count || !settings.bands[b].active) {
+                z1[b][0] = z1[b][1] = z2[b][0] = z2[b][1] = 0.0;
+            }
+        }
+    }
+    const Settings& settings = slots[front];
+    for (size_t b = 0; b < settings.band_count; ++b) {
+        if (settings.bands[b].active) {
+            filter(settings.bands[b], z1[b], z2[b], frames, frame_count);
+        }
+    }
+}
+
+void Equalizer::filter(const Biquad& band, double* z1, double* z2, float* frames, size_t frame_count) {
+#ifdef EQUALIZER_SSE2
+    const __m128d b0 = _mm_set1_pd(band.b0), b1 = _mm_set1_pd(band.b1), b2 = _mm_set1_pd(band.b2);
+    const __m128d a1 = _mm_set1_pd(band.a1), a2 = _mm_set1_pd(band.a2);
+    __m128d s1 = _mm_load_pd(z1), s2 = _mm_load_pd(z2);
+    for (size_t f = 0; f < frame_count; ++f) {
+        __m128i* frame = reinterpret_cast<__m128i*>(frames + 2 * f);
+        __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(frame)));
+        __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), s1);
+        s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), s2);
+        s2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+        _mm_storel_epi64(frame, _mm_castps_si128(_mm_cvtpd_ps(y)));
+    }
+    _mm_store_pd(z1, s1);
+    _mm_store_pd(z2, s2);
+#else
+    for (size_t c = 0; c < 2; ++c) {
+        double s1 = z1[c], s2 = z2[c];
+        for (size_t f = 0; f < frame_count; ++f) {
+            double x = frames[2 * f + c];
+            double y = band.b0 * x + s1;
+            s1 = band.b1 * x - band.a1 * y + s2;
+            s2 = band.b2 * x - band.a2 * y;
+            frames[2 * f + c] = static_cast<float>(y);
+        }
+        z1[c] = s1;
+        z2[c] = s2;
+    }
+#endif
+    // State decaying through silence would otherwise go denormal and slow
+    // every later frame down
+    for (size_t c = 0; c < 2; ++c) {
+        if (std::fabs(z1[c]) < 1e-30) {
+            z1[c] = 0.0;
+        }
+        if (std::fabs(z2[c]) < 1e-30) {
+            z2[c] = 0.0;
+        }
+    }
+}
+
+void Equalizer::reset() {
+    std::memset(z1, 0, sizeof(z1));
+    std::memset(z2, 0, sizeof(z2));
+}
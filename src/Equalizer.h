@@ -0,0 +1,65 @@
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include "DspChain.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+struct EqBand {
+    enum Type { LowShelf, Peaking, HighShelf } type;
+    double frequency; // Hz: the centre, or the shelf's midpoint
+    double gain_db;
+    double q;
+};
+
+// Parametric EQ: a cascade of biquads (RBJ cookbook shelves and peaks) over
+// stereo frames. Both channels run in one SSE2 register of doubles, one band
+// at a time over the whole buffer, so the filter state stays in registers.
+// Bands at 0 dB are skipped, so a flat EQ costs nothing.
+//
+// set_bands() may be called from any one thread at a time while another
+// runs process(): new settings pass through a triple buffer, so neither
+// side waits and process() picks up the latest at its next call, keeping
+// the filter state of bands that are still there.
+class Equalizer : public DspStage {
+public:
+    static constexpr size_t MAX_BANDS = 10;
+    static constexpr size_t GRAPHIC_BAND_COUNT = 5;
+    static constexpr double GRAPHIC_FREQUENCIES[GRAPHIC_BAND_COUNT] = {60, 230, 910, 3600, 14000};
+
+    explicit Equalizer(unsigned sample_rate);
+
+    void set_bands(const std::vector<EqBand>& bands); // Bands past MAX_BANDS are ignored
+    // A low shelf, peaks and a high shelf at GRAPHIC_FREQUENCIES with these
+    // gains; missing gains are 0 dB
+    static std::vector<EqBand> graphic(const std::vector<double>& gains_db);
+
+    void process(float* frames, size_t frame_count) override;
+    void reset() override;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2; // a0 normalised to 1
+        bool active; // False at 0 dB
+    };
+    struct Settings {
+        size_t band_count;
+        Biquad bands[MAX_BANDS];
+    };
+    static const unsigned FRESH = 4; // Set in middle when it holds settings process() hasn't seen
+
+    unsigned sample_rate;
+    Settings slots[3];
+    std::atomic<unsigned> middle; // Slot index, | FRESH
+    unsigned back; // Filled by set_bands()
+    unsigned front; // Used by process()
+    // Transposed direct form II state per band, left and right adjacent
+    alignas(16) double z1[MAX_BANDS][2];
+    alignas(16) double z2[MAX_BANDS][2];
+
+    static Biquad design(const EqBand& band, unsigned sample_rate);
+    void filter(const Biquad& band, double* z1, double* z2, float* frames, size_t frame_count);
+};
+
+#endif // EQUALIZER_H
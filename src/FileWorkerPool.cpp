@@ -0,0 +1,88 @@
+#include "FileWorkerPool.h"
+#include <chrono>
+
+FileWorkerPool::FileWorkerPool(Work work, Drained drained, unsigned thread_count)
+    : work(std::move(work)), drained(std::move(drained)), in_progress(0), stopping(false) {
+    if (thread_count == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned t = 0; t < thread_count; ++t) {
+        workers.emplace_back(&FileWorkerPool::run, this);
+    }
+}
+
+FileWorkerPool::~FileWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void FileWorkerPool::add(const std::vector<PooledPath>& file_paths) {
+    if (file_paths.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.insert(queue.end(), file_paths.begin(), file_paths.end());
+    }
+    wake.notify_all();
+}
+
+size_t FileWorkerPool::pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + in_progress;
+}
+
+FileWorkerPool::Totals FileWorkerPool::get_totals() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totals;
+}
+
+void FileWorkerPool::run() {
+    for (;;) {
+        PooledPath file_path;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            file_path = queue.front();
+            queue.pop_front();
+            in_progress++;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        double audio_seconds = 0;
+        Outcome outcome = work(file_path, audio_seconds, stopping);
+        double busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool done;
+        Totals snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_progress--;
+            if (outcome == Outcome::Done) {
+                totals.done++;
+                totals.audio_seconds += audio_seconds;
+                totals.busy_seconds += busy;
+            } else if (outcome == Outcome::Skipped) {
+                totals.skipped++;
+            } else if (!stopping) {
+                totals.failed++;
+            }
+            done = queue.empty() && in_progress == 0 && !stopping;
+            snapshot = totals;
+        }
+        if (done && drained) {
+            drained(snapshot);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef FILE_WORKER_POOL_H
+#define FILE_WORKER_POOL_H
+
+#include "StringPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Background threads working through a queue of library files, one file at
+// a time each: the pool behind the passes that decode every file
+// (LoudnessAnalyzer, WaveformGenerator). The owner says what to do with one
+// file; the pool queues, counts and times the files, and reports once the
+// queue has run dry. Destroying it drops the queued files and raises the
+// stop flag, which work should check between chunks.
+class FileWorkerPool {
+public:
+    enum class Outcome {
+        Done,
+        Skipped, // Nothing to do, e.g. already up to date
+        Failed
+    };
+
+    struct Totals {
+        size_t done = 0;
+        size_t skipped = 0;
+        size_t failed = 0; // Not counting files cut short by the pool stopping
+        double audio_seconds = 0; // Of the files done
+        double busy_seconds = 0; // Spent on them, summed over workers
+        // Seconds of audio processed per second of one worker's time
+        double realtime_per_core() const { return busy_seconds > 0 ? audio_seconds / busy_seconds : 0; }
+    };
+
+    // Handles one file on a worker thread (several run at once), setting
+    // audio_seconds for a file done
+    using Work = std::function<Outcome(const PooledPath& file_path, double& audio_seconds,
+                                       const std::atomic<bool>& stopping)>;
+    // Called on the worker that finishes the last queued file
+    using Drained = std::function<void(const Totals& totals)>;
+
+    // thread_count 0: one per core, leaving one for playback. Threads start
+    // at once, so whatever work uses must already be set up.
+    FileWorkerPool(Work work, Drained drained, unsigned thread_count = 0);
+    ~FileWorkerPool();
+    FileWorkerPool(const FileWorkerPool&) = delete;
+    FileWorkerPool& operator=(const FileWorkerPool&) = delete;
+
+    void add(const std::vector<PooledPath>& file_paths);
+    size_t pending() const; // Queued or being worked on
+    Totals get_totals() const;
+
+private:
+    Work work;
+    Drained drained;
+    mutable std::mutex mutex;
+    std::condition_variable wake; // Work arrived or stopping
+    std::deque<PooledPath> queue;
+    size_t in_progress;
+    Totals totals;
+    std::atomic<bool> stopping;
+    std::vector<std::thread> workers;
+
+    void run();
+};
+
+#endif // FILE_WORKER_POOL_H
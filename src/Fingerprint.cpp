@@ -0,0 +1,166 @@
+#include "Fingerprint.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <unordered_map>
+
+static const double PI = 3.14159265358979323846;
+// Band maxima quieter than this (power, full scale = 1) are silence, not peaks
+static const float SILENCE_POWER = 0.05f;
+
+Fingerprinter::Fingerprinter(unsigned sample_rate, unsigned channel_count)
+    : channel_count(channel_count), box_pos(0), box_sum(0), input_count(0), previous_filtered(0),
+      window(FFT_SIZE, 0.0f), window_fill(0), frame_index(0) {
+    step = sample_rate ? double(sample_rate) / ANALYSIS_RATE : 1.0;
+    next_output = step;
+    box_width = std::max<size_t>(1, static_cast<size_t>(step + 0.5));
+    box_history.assign(box_width, 0.0f);
+    hann.resize(FFT_SIZE);
+    for (size_t i = 0; i < FFT_SIZE; ++i) {
+        hann[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * PI * i / FFT_SIZE));
+    }
+    cosines.resize(FFT_SIZE / 2);
+    sines.resize(FFT_SIZE / 2);
+    for (size_t i = 0; i < FFT_SIZE / 2; ++i) {
+        cosines[i] = static_cast<float>(std::cos(2 * PI * i / FFT_SIZE));
+        sines[i] = static_cast<float>(-std::sin(2 * PI * i / FFT_SIZE));
+    }
+}
+
+void Fingerprinter::add_frames(const int16_t* samples, size_t frame_count) {
+    if (channel_count == 0) {
+        return;
+    }
+    const float scale = 1.0f / (32768.0f * channel_count);
+    for (size_t f = 0; f < frame_count; ++f) {
+        int sum = 0;
+        for (unsigned c = 0; c < channel_count; ++c) {
+            sum += samples[f * channel_count + c];
+        }
+        push_mono(sum * scale);
+    }
+}
+
+// Moving average (a crude but cheap low-pass), then linear interpolation
+// at ANALYSIS_RATE
+void Fingerprinter::push_mono(float value) {
+    box_sum += value - box_history[box_pos];
+    box_history[box_pos] = value;
+    box_pos = box_pos + 1 == box_width ? 0 : box_pos + 1;
+    float filtered = static_cast<float>(box_sum / box_width);
+    input_count++;
+    while (next_output <= double(input_count)) {
+        double fraction = next_output - double(input_count - 1);
+        window[window_fill++] = previous_filtered + static_cast<float>(fraction) * (filtered - previous_filtered);
+        next_output += step;
+        if (window_fill == FFT_SIZE) {
+            analyse_frame();
+            std::memmove(window.data(), window.data() + HOP, (FFT_SIZE - HOP) * sizeof(float));
+            window_fill = FFT_SIZE - HOP;
+        }
+    }
+    previous_filtered = filtered;
+}
+
+void Fingerprinter::analyse_frame() {
+    // Windowed radix-2 FFT, bins in bit-reversed order first
+    std::vector<std::complex<float>> bins(FFT_SIZE);
+    for (size_t i = 0, j = 0; i < FFT_SIZE; ++i) {
+        bins[j] = window[i] * hann[i];
+        for (size_t bit = FFT_SIZE >> 1; (j ^= bit) < bit; bit >>= 1) {
+        }
+    }
+    for (size_t length = 2; length <= FFT_SIZE; length <<= 1) {
+        size_t half = length / 2;
+        size_t stride = FFT_SIZE / length;
+        for (size_t start = 0; start < FFT_SIZE; start += length) {
+            for (size_t k = 0; k < half; ++k) {
+                std::complex<float> twiddle(cosines[k * stride], sines[k * stride]);
+                std::complex<float> odd = bins[start + k + half] * twiddle;
+                bins[start + k + half] = bins[start + k] - odd;
+                bins[start + k] += odd;
+            }
+        }
+    }
+
+    // Strongest bin per octave band (about 86 Hz to 5.5 kHz); keep those at
+    // least as loud as the frame's average band maximum
+    uint16_t best_bin[BAND_COUNT];
+    float best_power[BAND_COUNT];
+    float log_sum = 0;
+    size_t band_start = 8;
+    for (size_t band = 0; band < BAND_COUNT; ++band) {
+        size_t band_end = std::min(FFT_SIZE / 2, band_start * 2);
+        best_bin[band] = static_cast<uint16_t>(band_start);
+        best_power[band] = 0;
+        for (size_t b = band_start; b < band_end; ++b) {
+            float power = std::norm(bins[b]);
+            if (power > best_power[band]) {
+                best_power[band] = power;
+                best_bin[band] = static_cast<uint16_t>(b);
+            }
+        }
+        log_sum += std::log(best_power[band] + 1e-12f);
+        band_start = band_end;
+    }
+    float log_mean = log_sum / BAND_COUNT;
+    for (size_t band = 0; band < BAND_COUNT; ++band) {
+        if (best_power[band] > SILENCE_POWER && std::log(best_power[band] + 1e-12f) >= log_mean) {
+            peaks.push_back({frame_index, best_bin[band]});
+        }
+    }
+    frame_index++;
+}
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+std::vector<Landmark> Fingerprinter::finish() {
+    std::vector<Landmark> landmarks;
+    // A held note gives the same triplet frame after frame; only its first
+    // is kept, otherwise it would vote for every offset nearby
+    std::unordered_map<uint32_t, uint32_t> last_frame;
+    for (size_t a = 0; a < peaks.size(); ++a) {
+        const Peak& anchor = peaks[a];
+        // The first FAN_OUT peaks in later frames within reach
+        size_t partners[FAN_OUT];
+        size_t partner_count = 0;
+        for (size_t p = a + 1; p < peaks.size() && partner_count < FAN_OUT; ++p) {
+            if (peaks[p].frame == anchor.frame) {
+                continue;
+            }
+            if (peaks[p].frame > anchor.frame + TARGET_FRAMES) {
+                break;
+            }
+            partners[partner_count++] = p;
+        }
+        for (size_t i = 0; i < partner_count; ++i) {
+            for (size_t j = i + 1; j < partner_count; ++j) {
+                const Peak& first = peaks[partners[i]];
+                const Peak& second = peaks[partners[j]];
+                uint64_t key = uint64_t(anchor.bin) | uint64_t(first.bin) << 9 | uint64_t(second.bin) << 18 |
+                               uint64_t(first.frame - anchor.frame) << 27 | uint64_t(second.frame - anchor.frame) << 33;
+                uint64_t hash = mix64(key);
+                if ((hash >> 32) % SAMPLING != 0) {
+                    continue;
+                }
+                auto seen = last_frame.emplace(static_cast<uint32_t>(hash), anchor.frame);
+                if (!seen.second) {
+                    uint32_t previous = seen.first->second;
+                    seen.first->second = anchor.frame;
+                    if (anchor.frame - previous <= TARGET_FRAMES) {
+                        continue;
+                    }
+                }
+                landmarks.push_back({static_cast<uint32_t>(hash), anchor.frame});
+            }
+        }
+    }
+    return landmarks;
+}
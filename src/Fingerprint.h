@@ -0,0 +1,65 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One hashed constellation feature of a recording: three spectral peaks
+// (an anchor and two later peaks near it) and the frame the anchor is in
+struct Landmark {
+    uint32_t hash;
+    uint32_t frame; // FRAME_SECONDS each
+};
+
+// Spectral-peak fingerprint of a track, fed decoded PCM a chunk at a time.
+// Audio is mixed to mono and resampled to 11025 Hz, so any two encodings of
+// a recording are fingerprinted alike whatever their sample rate. Each
+// 1024-point frame contributes its strongest peak per octave band; every
+// anchor peak is hashed with pairs of the next peaks in a window after it.
+// Only hashes with a fixed pattern of low bits are kept (1 in SAMPLING),
+// which thins every track the same way, so copies keep matching while
+// the index stays near 5 landmarks (40 bytes) per second of audio.
+class Fingerprinter {
+public:
+    static const unsigned ANALYSIS_RATE = 11025;
+    static const size_t FFT_SIZE = 1024;
+    static const size_t HOP = 512;
+    static constexpr double FRAME_SECONDS = double(HOP) / ANALYSIS_RATE;
+    static const uint32_t SAMPLING = 32;
+
+    Fingerprinter(unsigned sample_rate, unsigned channel_count);
+    void add_frames(const int16_t* samples, size_t frame_count); // Interleaved
+    std::vector<Landmark> finish(); // Landmarks in frame order
+
+private:
+    struct Peak {
+        uint32_t frame;
+        uint16_t bin;
+    };
+
+    static const size_t BAND_COUNT = 6;
+    static const uint32_t TARGET_FRAMES = 32; // How far after an anchor its partners may be
+    static const size_t FAN_OUT = 4; // Partners considered per anchor
+
+    unsigned channel_count;
+    double step; // Input samples per output sample
+    size_t box_width; // Moving-average length: the anti-alias filter
+    std::vector<float> box_history; // Last box_width mono samples, circular
+    size_t box_pos;
+    double box_sum;
+    uint64_t input_count; // Filtered input samples so far
+    double next_output; // Input position of the next output sample
+    float previous_filtered; // For interpolating between input samples
+    std::vector<float> window; // Analysis input, FFT_SIZE once full
+    size_t window_fill;
+    uint32_t frame_index;
+    std::vector<float> hann;
+    std::vector<float> cosines, sines; // FFT twiddles
+    std::vector<Peak> peaks;
+
+    void push_mono(float value);
+    void analyse_frame();
+};
+
+#endif // FINGERPRINT_H
@@ -0,0 +1,88 @@
+#include "FuzzyMatcher.h"
+#include <algorithm>
+
+FuzzyMatcher::FuzzyMatcher(std::string_view pattern) : pattern(pattern) {
+    std::fill(std::begin(peq), std::end(peq), 0);
+    for (size_t i = 0; i < pattern.size() && i < 64; ++i) {
+        peq[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+    }
+}
+
+size_t FuzzyMatcher::distance(std::string_view text, size_t max_distance) const {
+    size_t m = pattern.size();
+    size_t n = text.size();
+    size_t length_gap = m > n ? m - n : n - m;
+    if (length_gap > max_distance) {
+        return max_distance + 1; // Needs at least that many inserts/deletes
+    }
+    if (m == 0) {
+        return n;
+    }
+    if (m > 64) {
+        return distance_banded(text, max_distance);
+    }
+
+    // Myers/Hyyrö: Pv/Mv hold the +1/-1 vertical deltas of the current column,
+    // score tracks the bottom cell, i.e. the distance for the prefix read so far
+    uint64_t pv = ~uint64_t(0);
+    uint64_t mv = 0;
+    const uint64_t last = uint64_t(1) << (m - 1);
+    size_t score = m;
+    for (size_t j = 0; j < n; ++j) {
+        uint64_t eq = peq[static_cast<unsigned char>(text[j])];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            score++;
+        } else if (mh & last) {
+            score--;
+        }
+        // Top row is 0, 1, 2, ...: every step right adds one
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        // The bottom cell can drop by at most one per remaining text byte
+        size_t remaining = n - j - 1;
+        if (score > max_distance + remaining) {
+            return max_distance + 1;
+        }
+    }
+    return std::min(score, max_distance + 1);
+}
+
+size_t FuzzyMatcher::distance_banded(std::string_view text, size_t max_distance) const {
+    // Only cells within max_distance of the diagonal can stay under the limit
+    const size_t m = pattern.size();
+    const size_t n = text.size();
+    const size_t over = max_distance + 1;
+    std::vector<size_t> previous(n + 1), current(n + 1);
+    for (size_t j = 0; j <= n; ++j) {
+        previous[j] = std::min(j, over);
+    }
+    for (size_t i = 1; i <= m; ++i) {
+        size_t from = i > max_distance ? i - max_distance : 1;
+        size_t to = std::min(n, i + max_distance);
+        current[from - 1] = from == 1 ? std::min(i, over) : over;
+        size_t row_min = current[from - 1];
+        for (size_t j = from; j <= to; ++j) {
+            size_t cost = pattern[i - 1] == text[j - 1] ? 0 : 1;
+            size_t best = previous[j - 1] + cost;
+            best = std::min(best, previous[j] + 1);
+            best = std::min(best, current[j - 1] + 1);
+            current[j] = std::min(best, over);
+            row_min = std::min(row_min, current[j]);
+        }
+        if (to < n) {
+            current[to + 1] = over;
+        }
+        if (row_min >= over) {
+            return over;
+        }
+        std::swap(previous, current);
+    }
+    return previous[n];
+}
@@ -0,0 +1,28 @@
+#ifndef FUZZY_MATCHER_H
+#define FUZZY_MATCHER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Levenshtein distance from one pattern to many texts. Patterns of up to 64
+// bytes use Myers' bit-parallel algorithm (one 64-bit word holds a whole DP
+// column, so each text byte costs a handful of integer ops); longer patterns
+// fall back to a banded two-row DP. Build one matcher per pattern and reuse it.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(std::string_view pattern);
+    // Edit distance to text, or max_distance + 1 once it's known to be larger
+    size_t distance(std::string_view text, size_t max_distance) const;
+    size_t pattern_length() const { return pattern.size(); }
+
+private:
+    std::string pattern;
+    uint64_t peq[256]; // Bit i set where pattern[i] is that byte
+
+    size_t distance_banded(std::string_view text, size_t max_distance) const;
+};
+
+#endif // FUZZY_MATCHER_H
@@ -0,0 +1,72 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+// Values below 2 * SUB_COUNT map to themselves. Above that, a value with its
+// top bit at position b keeps its SUB_BITS + 1 leading bits, i.e. one of
+// SUB_COUNT buckets per power of two, each 1/32 of it wide.
+size_t LatencyHistogram::index_of(uint64_t ns) {
+    if (ns < 2 * SUB_COUNT) {
+        return static_cast<size_t>(ns);
+    }
+    int top_bit = 63 - __builtin_clzll(ns);
+    int shift = top_bit - SUB_BITS;
+    size_t leading = static_cast<size_t>(ns >> shift); // In [SUB_COUNT, 2 * SUB_COUNT)
+    return (static_cast<size_t>(shift) + 1) * SUB_COUNT + (leading - SUB_COUNT);
+}
+
+uint64_t LatencyHistogram::value_at(size_t index) {
+    if (index < 2 * SUB_COUNT) {
+        return index;
+    }
+    int shift = static_cast<int>(index / SUB_COUNT) - 1;
+    uint64_t low = static_cast<uint64_t>(index % SUB_COUNT + SUB_COUNT) << shift;
+    return low + (uint64_t(1) << shift) / 2;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (ns > seen && !maximum.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    // Rank of the sample wanted, 1-based; p = 1 is the maximum, which we know exactly
+    uint64_t rank = static_cast<uint64_t>(p * n + 0.5);
+    rank = rank < 1 ? 1 : rank;
+    if (rank >= n) {
+        return max();
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t value = value_at(i);
+            return value < max() ? value : max();
+        }
+    }
+    return max();
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? double(sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,223 @@
+#include "LibraryIndex.h"
+#include <cstdio>
+#include <cstring>
+
+static const char INDEX_MAGIC[8] = {'N', 'Z', '2', 'L', 'I', 'B', 0, 0};
+
+static_assert(sizeof(TitleIndex::Slot) == 16, "title table layout is part of the file format");
+static_assert(sizeof(LibraryIndex::Record) == 64, "record layout is part of the file format");
+static_assert(sizeof(SongId) == 4, "orders and search lists are part of the file format");
+
+// True if count items of item_size at offset lie within size bytes, aligned
+// for their type. Offset and count come from the file, so nothing is added
+// or multiplied that could wrap around.
+static bool fits(uint64_t offset, uint64_t count, size_t item_size, size_t alignment, uint64_t size) {
+    return offset <= size && offset % alignment == 0 && count <= (size - offset) / item_size;
+}
+
+bool LibraryIndex::open(const std::string& path) {
+    close();
+    if (!file.open(path) || !file.map()) {
+        close();
+        return false;
+    }
+    const unsigned char* data = file.data();
+    uint64_t size = file.size();
+    if (size < sizeof(Header)) {
+        close();
+        return false;
+    }
+
+    const Header* candidate = reinterpret_cast<const Header*>(data);
+    bool valid = std::memcmp(candidate->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                 candidate->version == VERSION &&
+                 fits(candidate->records_offset, candidate->record_count, sizeof(Record), alignof(Record), size) &&
+                 fits(candidate->table_offset, candidate->table_capacity, sizeof(TitleIndex::Slot),
+                      alignof(TitleIndex::Slot), size) &&
+                 fits(candidate->strings_offset, candidate->strings_size, 1, 1, size) &&
+                 fits(candidate->orders_offset, uint64_t(candidate->record_count) * ORDER_COUNT, sizeof(SongId),
+                      alignof(SongId), size) &&
+                 fits(candidate->search_keys_offset, candidate->search_key_count, 2 * sizeof(uint32_t),
+                      alignof(uint32_t), size) &&
+                 fits(candidate->search_ids_offset, candidate->search_id_count, sizeof(SongId), alignof(SongId),
+                      size) &&
+                 fits(candidate->search_lengths_offset, uint64_t(candidate->record_count) * 3, sizeof(uint32_t),
+                      alignof(uint32_t), size) &&
+                 fits(candidate->search_text_offset, candidate->search_text_size, 1, 1, size);
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    header = candidate;
+    records = reinterpret_cast<const Record*>(data + header->records_offset);
+    table = reinterpret_cast<const TitleIndex::Slot*>(data + header->table_offset);
+    orders = reinterpret_cast<const SongId*>(data + header->orders_offset);
+    strings = reinterpret_cast<const char*>(data + header->strings_offset);
+
+    // Every string must lie inside the pool
+    for (size_t i = 0; i < header->record_count; ++i) {
+        const StringRef* refs[] = {&records[i].title, &records[i].artist, &records[i].album, &records[i].file_path};
+        for (const StringRef* ref : refs) {
+            if (uint64_t(ref->offset) + ref->length > header->strings_size) {
+                close();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void LibraryIndex::close() {
+    file.close();
+    header = nullptr;
+    records = nullptr;
+    table = nullptr;
+    orders = nullptr;
+    strings = nullptr;
+}
+
+Song LibraryIndex::song(size_t index) const {
+    const Record& r = records[index];
+    Song song = {string(r.title), string(r.artist), string(r.album), r.duration_seconds, string(r.file_path)};
+    song.loudness_lufs = r.loudness_lufs;
+    song.true_peak_dbtp = r.true_peak_dbtp;
+    return song;
+}
+
+SearchIndex::FlatView LibraryIndex::search_index() const {
+    SearchIndex::FlatView flat;
+    if (!header) {
+        return flat;
+    }
+    const unsigned char* data = file.data();
+    flat.keys = reinterpret_cast<const uint32_t*>(data + header->search_keys_offset);
+    flat.key_count = static_cast<size_t>(header->search_key_count);
+    flat.list_ends = flat.keys + flat.key_count;
+    flat.ids = reinterpret_cast<const SongId*>(data + header->search_ids_offset);
+    flat.id_count = static_cast<size_t>(header->search_id_count);
+    flat.text_lengths = reinterpret_cast<const uint32_t*>(data + header->search_lengths_offset);
+    flat.text = reinterpret_cast<const char*>(data + header->search_text_offset);
+    flat.text_size = static_cast<size_t>(header->search_text_size);
+    flat.song_count = size();
+    return flat;
+}
+
+FileStamp LibraryIndex::stamp(size_t index) const {
+    FileStamp stamp;
+    stamp.mtime_ns = records[index].mtime_ns;
+    stamp.size = records[index].file_size;
+    return stamp;
+}
+
+bool LibraryIndex::write(const std::string& path, const std::vector<const Song*>& songs,
+                         const std::vector<FileStamp>& stamps, const Orders& orders,
+                         const SearchIndex::Flat& search) {
+    for (const std::vector<SongId>& order : orders) {
+        if (order.size() != songs.size()) {
+            return false;
+        }
+    }
+    if (search.song_count != songs.size() || search.text_lengths.size() != 3 * songs.size()) {
+        return false;
+    }
+
+    // Same sizing and probing as TitleIndex so the table can be adopted as-is
+    size_t capacity = TitleIndex::MIN_CAPACITY;
+    while (capacity * TitleIndex::MAX_LOAD_PERCENT < songs.size() * 100) {
+        capacity *= 2;
+    }
+
+    std::vector<Record> out_records(songs.size());
+    std::vector<TitleIndex::Slot> out_table(capacity);
+    std::memset(out_table.data(), 0, out_table.size() * sizeof(TitleIndex::Slot)); // Padding too
+    std::string pool;
+
+    auto add_string = [&pool](std::string_view text) {
+        StringRef ref;
+        ref.offset = static_cast<uint32_t>(pool.size());
+        ref.length = static_cast<uint32_t>(text.size());
+        pool += text;
+        return ref;
+    };
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < songs.size(); ++i) {
+        const Song& song = *songs[i];
+        Record& r = out_records[i];
+        std::memset(&r, 0, sizeof(r));
+        r.title = add_string(song.title);
+        r.artist = add_string(song.artist);
+        r.album = add_string(song.album);
+        r.file_path = add_string(song.file_path.str());
+        r.duration_seconds = song.duration_seconds;
+        r.loudness_lufs = song.loudness_lufs;
+        r.true_peak_dbtp = song.true_peak_dbtp;
+        if (i < stamps.size()) {
+            r.mtime_ns = stamps[i].mtime_ns;
+            r.file_size = stamps[i].size;
+        }
+
+        uint64_t hash = TitleIndex::hash_title(song.title.data(), song.title.size());
+        size_t pos = hash & mask;
+        while (out_table[pos].hash != 0) {
+            pos = (pos + 1) & mask;
+        }
+        out_table[pos].hash = hash;
+        out_table[pos].id = static_cast<SongId>(i);
+        if (pool.size() > 0xFFFFFFFFull) {
+            return false; // Offsets are 32-bit
+        }
+    }
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    h.version = VERSION;
+    h.record_count = static_cast<uint32_t>(songs.size());
+    h.records_offset = sizeof(Header);
+    h.table_offset = h.records_offset + out_records.size() * sizeof(Record);
+    h.table_capacity = capacity;
+    h.orders_offset = h.table_offset + out_table.size() * sizeof(TitleIndex::Slot);
+    h.search_keys_offset = h.orders_offset + ORDER_COUNT * songs.size() * sizeof(SongId);
+    h.search_key_count = search.keys.size();
+    h.search_ids_offset = h.search_keys_offset + 2 * search.keys.size() * sizeof(uint32_t);
+    h.search_id_count = search.ids.size();
+    h.search_lengths_offset = h.search_ids_offset + search.ids.size() * sizeof(SongId);
+    h.search_text_offset = h.search_lengths_offset + search.text_lengths.size() * sizeof(uint32_t);
+    h.search_text_size = search.text.size();
+    h.strings_offset = h.search_text_offset + search.text.size();
+    h.strings_size = pool.size();
+
+    std::string temp_path = path + ".tmp";
+    FILE* out = std::fopen(temp_path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    auto put = [out](const void* items, size_t item_size, size_t count) {
+        return count == 0 || std::fwrite(items, item_size, count, out) == count;
+    };
+    bool ok = put(&h, sizeof(h), 1) && put(out_records.data(), sizeof(Record), out_records.size()) &&
+              put(out_table.data(), sizeof(TitleIndex::Slot), out_table.size());
+    for (const std::vector<SongId>& order : orders) {
+        ok = ok && put(order.data(), sizeof(SongId), order.size());
+    }
+    ok = ok && put(search.keys.data(), sizeof(uint32_t), search.keys.size()) &&
+         put(search.list_ends.data(), sizeof(uint32_t), search.list_ends.size()) &&
+         put(search.ids.data(), sizeof(SongId), search.ids.size()) &&
+         put(search.text_lengths.data(), sizeof(uint32_t), search.text_lengths.size()) &&
+         put(search.text.data(), 1, search.text.size()) && put(pool.data(), 1, pool.size());
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename() won't replace an existing file on Windows
+#endif
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
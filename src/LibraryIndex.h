@@ -0,0 +1,102 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include "DirectoryScanner.h"
+#include "MappedFile.h"
+#include "SearchIndex.h"
+#include "Song.h"
+#include "SortedIndex.h"
+#include "TitleIndex.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk snapshot of a MusicLibrary, laid out so it can be mapped and used
+// as-is: a header, fixed-size song records, a string pool the records point
+// into, and the library's indexes with record numbers as IDs: the title
+// hash table in TitleIndex's slot format, each SortField's order, and the
+// search index in SearchIndex's flat form. Nothing is parsed on open beyond
+// validating the header and the string references; the indexes are checked
+// by whatever adopts them.
+//
+//   Header | Record[record_count] | TitleIndex::Slot[table_capacity]
+//   | SongId orders[ORDER_COUNT][record_count]
+//   | uint32_t search keys[search_key_count], list ends[search_key_count]
+//   | SongId search ids[search_id_count] | uint32_t text lengths[3 * record_count]
+//   | search text | strings
+class LibraryIndex {
+public:
+    static const uint32_t VERSION = 3;
+    static const size_t ORDER_COUNT = 4; // By SortField
+    using Orders = std::array<std::vector<SongId>, ORDER_COUNT>;
+
+    struct Header {
+        char magic[8]; // "NZ2LIB\0\0"
+        uint32_t version;
+        uint32_t record_count;
+        uint64_t records_offset;
+        uint64_t table_offset;
+        uint64_t table_capacity;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+        uint64_t orders_offset;
+        uint64_t search_keys_offset; // The keys, then their list ends
+        uint64_t search_key_count;
+        uint64_t search_ids_offset;
+        uint64_t search_id_count;
+        uint64_t search_lengths_offset;
+        uint64_t search_text_offset;
+        uint64_t search_text_size;
+    };
+
+    struct StringRef {
+        uint32_t offset; // Into the string pool
+        uint32_t length;
+    };
+
+    struct Record {
+        StringRef title;
+        StringRef artist;
+        StringRef album;
+        StringRef file_path;
+        int32_t duration_seconds;
+        float loudness_lufs; // NaN if not analysed yet
+        float true_peak_dbtp;
+        uint32_t reserved;
+        int64_t mtime_ns;
+        uint64_t file_size;
+    };
+
+    bool open(const std::string& path); // Maps and validates the file
+    void close();
+
+    size_t size() const { return header ? header->record_count : 0; }
+    const Record& record(size_t index) const { return records[index]; }
+    std::string_view string(const StringRef& ref) const { return std::string_view(strings + ref.offset, ref.length); }
+    Song song(size_t index) const;
+    FileStamp stamp(size_t index) const;
+
+    // The title table, for TitleIndex::adopt (which validates it)
+    const TitleIndex::Slot* title_table() const { return table; }
+    size_t title_table_capacity() const { return header ? static_cast<size_t>(header->table_capacity) : 0; }
+    // Record numbers in the field's order, size() of them, for SortedIndex::adopt
+    const SongId* order(SortField field) const { return orders + static_cast<size_t>(field) * size(); }
+    SearchIndex::FlatView search_index() const; // For SearchIndex::adopt
+
+    // Writes songs (with their stamps) and their indexes, numbered by
+    // position in songs, to a temporary file and renames it over `path`,
+    // so a crash never leaves a half-written index behind
+    static bool write(const std::string& path, const std::vector<const Song*>& songs,
+                      const std::vector<FileStamp>& stamps, const Orders& orders, const SearchIndex::Flat& search);
+
+private:
+    MappedFile file;
+    const Header* header = nullptr;
+    const Record* records = nullptr;
+    const TitleIndex::Slot* table = nullptr;
+    const SongId* orders = nullptr;
+    const char* strings = nullptr;
+};
+
+#endif // LIBRARY_INDEX_H
@@ -0,0 +1,69 @@
+#include "LibrarySnapshot.h"
+#include <algorithm>
+
+LibrarySnapshot::Order::Order(const SongStore& store, const SortedIndex& title, const SortedIndex& artist,
+                              const SortedIndex& album, const SortedIndex& path)
+    : songs(store), by_title(title, songs), by_artist(artist, songs), by_album(album, songs), by_path(path, songs) {}
+
+LibrarySnapshot::LibrarySnapshot(const SongStore& store, std::shared_ptr<const Order> order, uint64_t version)
+    : songs(store), order(std::move(order)), version(version) {}
+
+const Song* LibrarySnapshot::get_song(SongId id) const {
+    return songs.is_live(id) ? &songs[id] : nullptr;
+}
+
+const Song* LibrarySnapshot::get_song_by_index(int index) const {
+    if (index < 1) {
+        return nullptr;
+    }
+    return get_song(static_cast<SongId>(index - 1));
+}
+
+const Song* LibrarySnapshot::find_song(std::string_view title) const {
+    // Titles equal to this one ignoring case come first among those starting
+    // with it; the exact matches are among them, in artist order
+    size_t begin, end;
+    order->by_title.prefix_range(title, begin, end);
+    SongId best = INVALID_SONG_ID;
+    const size_t step = 64;
+    for (size_t position = begin; position < end; position += step) {
+        for (SongId id : order->by_title.range(position, std::min(end, position + step))) {
+            std::string_view candidate = songs[id].title;
+            if (candidate.size() != title.size()) {
+                return best == INVALID_SONG_ID ? nullptr : &songs[best];
+            }
+            if (candidate == title && id < best) {
+                best = id;
+            }
+        }
+    }
+    return best == INVALID_SONG_ID ? nullptr : &songs[best];
+}
+
+const SortedIndex& LibrarySnapshot::sorted_index(SortField field) const {
+    switch (field) {
+    case SortField::Artist:
+        return order->by_artist;
+    case SortField::Album:
+        return order->by_album;
+    case SortField::Path:
+        return order->by_path;
+    case SortField::Title:
+        break;
+    }
+    return order->by_title;
+}
+
+std::vector<SongId> LibrarySnapshot::list_sorted(SortField field, std::string_view prefix, size_t offset,
+                                                 size_t count, size_t& total) const {
+    const SortedIndex& index = sorted_index(field);
+    size_t begin = 0, end = index.size();
+    if (!prefix.empty()) {
+        index.prefix_range(prefix, begin, end);
+    }
+    total = end - begin;
+    if (offset >= total) {
+        return {};
+    }
+    return index.range(begin + offset, begin + offset + std::min(count, total - offset));
+}
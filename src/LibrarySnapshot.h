@@ -0,0 +1,71 @@
+#ifndef LIBRARY_SNAPSHOT_H
+#define LIBRARY_SNAPSHOT_H
+
+#include "SongStore.h"
+#include "SortedIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// The library as it was at one MusicLibrary::publish(): its songs and
+// sorted indexes, never changed afterwards. Any number of threads can read
+// one while the library goes on changing, and a const Song* from it stays
+// valid for as long as the snapshot is held. Publishing is cheap: songs are
+// shared with the library chunk by chunk until it edits them (see
+// SongStore), and the sorted indexes block by block until it reorders them
+// (see SortedIndex); new index copies are only made when the order changed.
+class LibrarySnapshot {
+public:
+    LibrarySnapshot(const LibrarySnapshot&) = delete;
+    LibrarySnapshot& operator=(const LibrarySnapshot&) = delete;
+
+    uint64_t get_version() const { return version; } // Higher is newer
+    int get_song_count() const { return static_cast<int>(songs.size()); }
+    const Song* get_song(SongId id) const; // nullptr if the ID is unknown or removed
+    const Song* get_song_by_index(int index) const; // 1-based, as MusicLibrary's
+    const Song* find_song(std::string_view title) const; // Exact title; the oldest song if several
+    // As MusicLibrary::list_sorted
+    std::vector<SongId> list_sorted(SortField field, std::string_view prefix, size_t offset, size_t count,
+                                    size_t& total) const;
+    template <typename Fn>
+    void for_each_song(Fn fn) const; // fn(id, song) for every song in ID order
+
+private:
+    friend class MusicLibrary;
+
+    // Sorted indexes over the songs they were copied with. Later snapshots
+    // share it while no song is added, removed or re-keyed; only the sort
+    // keys are read through it, and those are the same in both.
+    struct Order {
+        SongStore songs;
+        SortedIndex by_title, by_artist, by_album, by_path;
+
+        Order(const SongStore& store, const SortedIndex& title, const SortedIndex& artist, const SortedIndex& album,
+              const SortedIndex& path);
+    };
+
+    SongStore songs;
+    std::shared_ptr<const Order> order;
+    uint64_t version;
+
+    LibrarySnapshot(const SongStore& store, std::shared_ptr<const Order> order, uint64_t version);
+    const SortedIndex& sorted_index(SortField field) const;
+};
+
+template <typename Fn>
+void LibrarySnapshot::for_each_song(Fn fn) const {
+    SongId id = 0;
+    for (size_t chunk = 0; chunk < songs.chunk_count(); ++chunk) {
+        const Song* data = songs.chunk_data(chunk);
+        size_t length = songs.chunk_length(chunk);
+        for (size_t i = 0; i < length; ++i, ++id) {
+            if (songs.is_live(id)) {
+                fn(id, data[i]);
+            }
+        }
+    }
+}
+
+#endif // LIBRARY_SNAPSHOT_H
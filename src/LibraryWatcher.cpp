@@ -0,0 +1,367 @@
+#include "LibraryWatcher.h"
+#include "Logger.h"
+#include <algorithm>
+#ifdef __linux__
+    #include <cerrno>
+    #include <dirent.h>
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/inotify.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+bool LibraryChanges::empty() const {
+    return renamed_directories.empty() && renamed_files.empty() && removed_directories.empty() &&
+           removed_files.empty() && changed_files.empty() && rescan_directories.empty();
+}
+
+LibraryWatcher::~LibraryWatcher() {
+    stop();
+}
+
+std::vector<LibraryChanges> LibraryWatcher::collect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<LibraryChanges> out;
+    out.swap(ready);
+    return out;
+}
+
+#ifdef __linux__
+
+static std::string join(const std::string& directory, const std::string& name) {
+    return directory.empty() ? name : directory + "/" + name;
+}
+
+// True if path is directory or inside it
+static bool is_within(const std::string& path, const std::string& directory) {
+    return directory.empty() ||
+           (path.compare(0, directory.size(), directory) == 0 &&
+            (path.size() == directory.size() || path[directory.size()] == '/'));
+}
+
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+bool LibraryWatcher::start(const std::string& resolved_path, FileFilter file_filter) {
+    stop();
+    root = resolved_path;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    filter = std::move(file_filter);
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd < 0 || wake_fd < 0) {
+        log_warning() << "Could not watch " << root << " for changes; rescan to pick them up";
+        stop();
+        return false;
+    }
+    watch_tree("");
+    if (directories.empty()) {
+        log_warning() << "Could not watch " << root << " for changes; rescan to pick them up";
+        stop();
+        return false;
+    }
+    worker = std::thread(&LibraryWatcher::run, this);
+    log_info() << "Watching " << directories.size() << " director" << (directories.size() == 1 ? "y" : "ies")
+               << " under " << root << " for changes";
+    return true;
+}
+
+void LibraryWatcher::stop() {
+    if (worker.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(wake_fd, &one, sizeof(one));
+        (void)written; // The counter can't overflow from one write
+        worker.join();
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd); // Drops every watch
+        inotify_fd = -1;
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    directories.clear();
+}
+
+void LibraryWatcher::run() {
+    for (;;) {
+        int timeout = -1;
+        if (has_pending) {
+            auto now = Clock::now();
+            auto deadline = std::min(last_event + std::chrono::milliseconds(DEBOUNCE_MS),
+                                     first_event + std::chrono::milliseconds(MAX_DELAY_MS));
+            timeout = static_cast<int>(std::max<int64_t>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()));
+        }
+        pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+        int ready_count = poll(fds, 2, timeout);
+        if (ready_count < 0 && errno != EINTR) {
+            log_error() << "Stopped watching " << root << ": poll failed";
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            read_events();
+        }
+        if (has_pending) {
+            auto now = Clock::now();
+            if (now - last_event >= std::chrono::milliseconds(DEBOUNCE_MS) ||
+                now - first_event >= std::chrono::milliseconds(MAX_DELAY_MS)) {
+                publish();
+            }
+        }
+    }
+}
+
+void LibraryWatcher::read_events() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return; // EAGAIN: drained
+        }
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            std::string name = event->len > 0 ? std::string(event->name) : std::string();
+            handle_event(event->wd, event->mask, event->cookie, name);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+void LibraryWatcher::handle_event(int wd, uint32_t mask, uint32_t cookie, const std::string& name) {
+    auto now = Clock::now();
+    if (!has_pending) {
+        first_event = now;
+    }
+    last_event = now;
+
+    if (mask & IN_Q_OVERFLOW) {
+        // Events were lost: forget what is pending and look at everything
+        files.clear();
+        renamed_directories.clear();
+        renamed_files.clear();
+        removed_directories.clear();
+        moved_out.clear();
+        rescan_directories = {""};
+        watch_tree(""); // Picks up directories created meanwhile
+        has_pending = true;
+        log_warning() << "Too many changes under " << root << " at once; rescanning it";
+        return;
+    }
+    auto it = directories.find(wd);
+    if (it == directories.end()) {
+        return;
+    }
+    const std::string directory = it->second;
+    if (mask & IN_IGNORED) {
+        directories.erase(it); // The directory is gone, or was unwatched
+        return;
+    }
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (directory.empty()) {
+            log_warning() << "Library directory " << root << " was moved or deleted; no longer following changes";
+        }
+        return; // Subdirectories are reported by their parent
+    }
+    if (name.empty() || name[0] == '.') {
+        return;
+    }
+    std::string path = join(directory, name);
+    bool is_directory = (mask & IN_ISDIR) != 0;
+
+    if (is_directory) {
+        if (mask & IN_CREATE) {
+            // Files may land in it before its watch exists, so scan it too
+            watch_tree(path);
+            rescan_directories.insert(path);
+        } else if (mask & IN_DELETE) {
+            removed_directories.insert(path);
+        } else if (mask & IN_MOVED_FROM) {
+            moved_out[cookie] = {path, true};
+        } else if (mask & IN_MOVED_TO) {
+            auto from = moved_out.find(cookie);
+            if (from != moved_out.end() && from->second.second) {
+                cancel_removals(path);
+                renamed_directories.emplace_back(from->second.first, path);
+                rename_watches(from->second.first, path);
+                moved_out.erase(from);
+            } else {
+                watch_tree(path);
+                rescan_directories.insert(path);
+            }
+        }
+        has_pending = true;
+        return;
+    }
+
+    bool wanted = filter(name);
+    if (mask & IN_CLOSE_WRITE) {
+        if (wanted) {
+            files[path] = false;
+        }
+    } else if (mask & IN_DELETE) {
+        if (wanted) {
+            files[path] = true;
+        }
+    } else if (mask & IN_MOVED_FROM) {
+        moved_out[cookie] = {path, false};
+    } else if (mask & IN_MOVED_TO) {
+        auto from = moved_out.find(cookie);
+        if (from == moved_out.end() || from->second.second) {
+            if (wanted) {
+                files[path] = false; // Moved in from outside the tree
+            }
+        } else {
+            const std::string& old_path = from->second.first;
+            std::string old_name = old_path.substr(old_path.find_last_of('/') + 1);
+            auto pending = files.find(old_path);
+            if (!filter(old_name)) {
+                if (wanted) {
+                    files[path] = false; // e.g. a download renamed from .part when done
+                }
+            } else if (!wanted) {
+                files[old_path] = true;
+            } else if (pending != files.end() && !pending->second) {
+                // Written and renamed in one batch: read it under its new name
+                pending->second = true;
+                files[path] = false;
+            } else {
+                cancel_removals(path);
+                renamed_files.emplace_back(old_path, path);
+            }
+            moved_out.erase(from);
+        }
+    }
+    has_pending = true;
+}
+
+void LibraryWatcher::cancel_removals(const std::string& path) {
+    // Renames are applied before removals, so a removal still pending at the
+    // target would take out what was just renamed there. The library drops
+    // whatever the rename replaces itself.
+    for (auto it = removed_directories.begin(); it != removed_directories.end();) {
+        it = is_within(path, *it) ? removed_directories.erase(it) : std::next(it);
+    }
+    auto exact = files.find(path);
+    if (exact != files.end() && exact->second) {
+        files.erase(exact);
+    }
+    std::string under = path + "/";
+    for (auto it = files.lower_bound(under); it != files.end() && it->first.compare(0, under.size(), under) == 0;) {
+        it = it->second ? files.erase(it) : std::next(it);
+    }
+}
+
+void LibraryWatcher::watch_tree(const std::string& relative) {
+    std::vector<std::string> stack = {relative};
+    while (!stack.empty()) {
+        std::string directory = stack.back();
+        stack.pop_back();
+        std::string full = directory.empty() ? root : root + "/" + directory;
+        int wd = inotify_add_watch(inotify_fd, full.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            if (errno == ENOSPC && !watch_limit_warned) {
+                watch_limit_warned = true;
+                log_warning() << "Out of inotify watches (fs.inotify.max_user_watches); changes under " << full
+                              << " and further directories won't be seen until a rescan";
+            }
+            continue;
+        }
+        auto existing = directories.find(wd);
+        if (existing != directories.end() && existing->second != directory) {
+            continue; // Already watched under another path (a symlink loop or a second link)
+        }
+        directories[wd] = directory;
+
+        DIR* dir = opendir(full.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            bool is_directory = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+                struct stat info;
+                is_directory = stat((full + "/" + entry->d_name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+            }
+            if (is_directory) {
+                stack.push_back(join(directory, entry->d_name));
+            }
+        }
+        closedir(dir);
+    }
+}
+
+void LibraryWatcher::unwatch_tree(const std::string& relative) {
+    for (auto it = directories.begin(); it != directories.end();) {
+        if (is_within(it->second, relative)) {
+            inotify_rm_watch(inotify_fd, it->first);
+            it = directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LibraryWatcher::rename_watches(const std::string& from, const std::string& to) {
+    for (auto& entry : directories) {
+        if (is_within(entry.second, from)) {
+            entry.second = to + entry.second.substr(from.size());
+        }
+    }
+}
+
+void LibraryWatcher::publish() {
+    LibraryChanges changes;
+    changes.root = root;
+    // Moved out of the tree: as good as deleted here
+    for (const auto& entry : moved_out) {
+        const std::string& path = entry.second.first;
+        if (entry.second.second) {
+            removed_directories.insert(path);
+            unwatch_tree(path);
+        } else if (filter(path.substr(path.find_last_of('/') + 1))) {
+            files[path] = true;
+        }
+    }
+    changes.renamed_directories = std::move(renamed_directories);
+    changes.renamed_files = std::move(renamed_files);
+    changes.removed_directories.assign(removed_directories.begin(), removed_directories.end());
+    for (const auto& entry : files) {
+        (entry.second ? changes.removed_files : changes.changed_files).push_back(entry.first);
+    }
+    changes.rescan_directories.assign(rescan_directories.begin(), rescan_directories.end());
+
+    renamed_directories.clear();
+    renamed_files.clear();
+    removed_directories.clear();
+    rescan_directories.clear();
+    files.clear();
+    moved_out.clear();
+    has_pending = false;
+    if (changes.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.push_back(std::move(changes));
+}
+
+#else
+
+bool LibraryWatcher::start(const std::string& resolved_path, FileFilter) {
+    log_info() << "Watching " << resolved_path << " for changes isn't supported on this platform; rescan to pick them up";
+    return false;
+}
+
+void LibraryWatcher::stop() {}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LIBRARY_WATCHER_H
+#define LIBRARY_WATCHER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One batch of changes under a watched directory. Paths are relative to it
+// and '/' separated. MusicLibrary::apply_changes applies them in the order
+// the fields are listed.
+struct LibraryChanges {
+    std::string root; // The watched directory, as opened
+    std::vector<std::pair<std::string, std::string>> renamed_directories; // From, to; in event order
+    std::vector<std::pair<std::string, std::string>> renamed_files;
+    std::vector<std::string> removed_directories;
+    std::vector<std::string> removed_files;
+    std::vector<std::string> changed_files; // Written or moved in
+    // Directories whose contents weren't seen arriving (moved in from
+    // outside, or events were lost): "" is the whole tree
+    std::vector<std::string> rescan_directories;
+
+    bool empty() const;
+};
+
+// Watches a library directory tree for added, removed, renamed and rewritten
+// audio files, so the library can follow them without a full rescan. A
+// background thread reads inotify events for every directory in the tree,
+// merges them per path and publishes a batch once they have been quiet for
+// DEBOUNCE_MS (or MAX_DELAY_MS into a steady stream), so copying an album
+// is one batch rather than hundreds. The UI thread collects batches and
+// applies them to the library between actions, so the library itself is
+// never touched from the watcher thread and playback carries on meanwhile.
+// If the kernel's event queue overflows, the batch asks for the whole tree
+// to be rescanned instead (cheap for unchanged files, their stamps match).
+// Linux only; start() returns false elsewhere.
+class LibraryWatcher {
+public:
+    using FileFilter = std::function<bool(const std::string& filename)>;
+
+    static constexpr int DEBOUNCE_MS = 500;
+    static constexpr int MAX_DELAY_MS = 3000;
+
+    LibraryWatcher() = default;
+    ~LibraryWatcher();
+    LibraryWatcher(const LibraryWatcher&) = delete;
+    LibraryWatcher& operator=(const LibraryWatcher&) = delete;
+
+    // Watches resolved_path and everything below it; only files the filter
+    // accepts are reported. Hidden entries (leading '.') are ignored.
+    bool start(const std::string& resolved_path, FileFilter filter);
+    void stop();
+    bool is_watching() const { return worker.joinable(); }
+    std::vector<LibraryChanges> collect(); // Batches published since the last call
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string root;
+    FileFilter filter;
+    int inotify_fd = -1;
+    int wake_fd = -1; // Written by stop() to end the thread's poll
+    std::thread worker;
+    std::mutex mutex; // Guards ready
+    std::vector<LibraryChanges> ready;
+
+    // Watcher thread only
+    std::unordered_map<int, std::string> directories; // Watch descriptor -> relative path
+    bool watch_limit_warned = false;
+    std::map<std::string, bool> files; // Path -> removed (else changed), pending publication
+    std::vector<std::pair<std::string, std::string>> renamed_directories;
+    std::vector<std::pair<std::string, std::string>> renamed_files;
+    std::set<std::string> removed_directories;
+    std::set<std::string> rescan_directories;
+    std::unordered_map<uint32_t, std::pair<std::string, bool>> moved_out; // Cookie -> path, is directory
+    bool has_pending = false;
+    Clock::time_point first_event;
+    Clock::time_point last_event;
+
+    void run();
+    void read_events();
+    void handle_event(int wd, uint32_t mask, uint32_t cookie, const std::string& name);
+    void watch_tree(const std::string& relative); // Adds watches for a directory and everything below it
+    void unwatch_tree(const std::string& relative);
+    void rename_watches(const std::string& from, const std::string& to);
+    void cancel_removals(const std::string& path); // Before a rename onto path: drops pending removals at or under it
+    void publish();
+};
+
+#endif // LIBRARY_WATCHER_H
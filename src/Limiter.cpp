@@ -0,0 +1,57 @@
+#include "Limiter.h"
+#include <algorithm>
+#include <cmath>
+
+Limiter::Limiter(unsigned sample_rate, double ceiling_db, double release_seconds)
+    : ceiling(static_cast<float>(std::pow(10.0, ceiling_db / 20.0))),
+      release(static_cast<float>(1.0 - std::exp(-double(BLOCK) / (std::max(release_seconds, 0.001) * sample_rate)))),
+      gain(1.0f), limited_blocks(0), delay(DELAY_FRAMES * 2) {
+    reset();
+}
+
+void Limiter::reset() {
+    std::fill(delay.begin(), delay.end(), 0.0f);
+    write_block = 0;
+    filled = 0;
+    block_peak = 0;
+    applied_gain = gain.load(std::memory_order_relaxed);
+    safe_gain = 1;
+    ramp_from = ramp_to = 1;
+}
+
+void Limiter::process(float* frames, size_t frame_count) {
+    float input_gain = gain.load(std::memory_order_relaxed);
+    if (applied_gain != 1.0f || input_gain != 1.0f) {
+        scale_stereo(frames, frame_count, applied_gain, input_gain);
+        applied_gain = input_gain;
+    }
+    while (frame_count > 0) {
+        size_t count = std::min(frame_count, BLOCK - filled);
+        block_peak = std::max(block_peak, peak_abs(frames, count * 2));
+        // The input takes the slots of the frames two blocks older, which play now
+        std::swap_ranges(frames, frames + count * 2, &delay[(write_block * BLOCK + filled) * 2]);
+        float from = ramp_from + (ramp_to - ramp_from) * float(filled) / BLOCK;
+        float to = ramp_from + (ramp_to - ramp_from) * float(filled + count) / BLOCK;
+        if (from != 1.0f || to != 1.0f) {
+            scale_stereo(frames, count, from, to);
+        }
+        frames += count * 2;
+        frame_count -= count;
+        filled += count;
+        if (filled == BLOCK) {
+            // The block about to play ramps to a gain safe for it and for the
+            // one just taken in, so neither exceeds the ceiling at any point
+            float block_safe = block_peak > ceiling ? ceiling / block_peak : 1.0f;
+            float released = ramp_to + (1.0f - ramp_to) * release;
+            ramp_from = ramp_to;
+            ramp_to = std::min({safe_gain, block_safe, released});
+            safe_gain = block_safe;
+            if (block_safe < 1.0f) {
+                limited_blocks.fetch_add(1, std::memory_order_relaxed);
+            }
+            block_peak = 0;
+            filled = 0;
+            write_block ^= 1;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef LIMITER_H
+#define LIMITER_H
+
+#include "DspChain.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Output gain and a look-ahead peak limiter, last in the chain so that
+// crossfades, EQ boosts and gain never clip. The signal is delayed by
+// two blocks of BLOCK frames; the gain for each block is known before it
+// plays, and ramps linearly across it from a level safe for both its
+// neighbours, so no sample exceeds the ceiling and the gain never steps.
+// Once peaks fall back the gain recovers over the release time.
+class Limiter : public DspStage {
+public:
+    static constexpr size_t BLOCK = 64; // Frames per gain decision
+    static constexpr size_t DELAY_FRAMES = 2 * BLOCK; // The look-ahead, ~3 ms at 44.1 kHz
+
+    explicit Limiter(unsigned sample_rate, double ceiling_db = -1.0, double release_seconds = 0.15);
+
+    void set_gain(float linear) { gain.store(linear, std::memory_order_relaxed); } // Any thread; before limiting
+    float get_gain() const { return gain.load(std::memory_order_relaxed); }
+    uint64_t get_limited_blocks() const { return limited_blocks.load(std::memory_order_relaxed); } // Blocks turned down
+
+    void process(float* frames, size_t frame_count) override;
+    void reset() override;
+
+private:
+    float ceiling; // Linear
+    float release; // Fraction of the way back to unity gain per block
+    std::atomic<float> gain;
+    std::atomic<uint64_t> limited_blocks;
+
+    std::vector<float> delay; // Two blocks: each slot's frame is replaced as it plays
+    size_t write_block; // 0 or 1: the block the input is filling
+    size_t filled; // Frames of it so far
+    float block_peak; // Of the input block so far
+    float applied_gain; // Input gain used for the block so far
+    float safe_gain; // Highest gain at which the last complete input block stays under the ceiling
+    float ramp_from, ramp_to; // Gain across the block being played
+};
+
+#endif // LIMITER_H
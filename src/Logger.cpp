@@ -0,0 +1,141 @@
+#include "Logger.h"
+#include <iostream>
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : min_level(LogLevel::Info), head(&stub), tail(&stub), queued(0), written(0), writer_waiting(false),
+      flush_waiters(0), stopping(false) {
+    stub.next.store(nullptr, std::memory_order_relaxed);
+    writer = std::thread(&Logger::writer_loop, this);
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join(); // Drains what's left first
+}
+
+void Logger::write(LogLevel level, std::string text) {
+    if (!enabled(level)) {
+        return;
+    }
+    Node* node = new Node;
+    node->level = level;
+    node->text = std::move(text);
+    push(node);
+    queued.fetch_add(1);
+    // Pairs with the writer setting writer_waiting before it re-checks queued:
+    // either it sees this line or we see it waiting and wake it
+    if (writer_waiting.load() && writer_waiting.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+void Logger::push(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+Logger::Node* Logger::pop() {
+    Node* first = tail;
+    Node* next = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+        if (!next) {
+            return nullptr;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        tail = next;
+        return first;
+    }
+    if (first != head.load(std::memory_order_acquire)) {
+        return nullptr; // A producer has swapped in a newer head but not linked it yet
+    }
+    // first is the only node: put the stub behind it so it can be taken
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return first;
+    }
+    return nullptr;
+}
+
+void Logger::flush() {
+    uint64_t target = queued.load();
+    std::unique_lock<std::mutex> lock(mutex);
+    if (written >= target) {
+        return;
+    }
+    flush_waiters++;
+    wake.notify_one();
+    drained.wait(lock, [&] { return written >= target; });
+    flush_waiters--;
+}
+
+void Logger::writer_loop() {
+    uint64_t taken = 0;
+    std::string out;
+    std::string err;
+    for (;;) {
+        // Gather everything queued so far, keeping stdout/stderr interleaving
+        // by writing a stream's run out whenever the other one comes next
+        while (Node* node = pop()) {
+            bool to_err = node->level >= LogLevel::Warning;
+            if (to_err && !out.empty()) {
+                std::cout.write(out.data(), out.size());
+                std::cout.flush();
+                out.clear();
+            } else if (!to_err && !err.empty()) {
+                std::cerr.write(err.data(), err.size());
+                err.clear();
+            }
+            std::string& target = to_err ? err : out;
+            target += node->text;
+            target += '\n';
+            delete node;
+            taken++;
+        }
+        if (!out.empty()) {
+            std::cout.write(out.data(), out.size());
+            out.clear();
+        }
+        if (!err.empty()) {
+            std::cerr.write(err.data(), err.size());
+            err.clear();
+        }
+        std::cout.flush();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (written != taken) {
+            written = taken;
+            drained.notify_all();
+        }
+        if (queued.load() != taken) {
+            // A push is half done; it will be linked in a moment
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        if (stopping) {
+            return;
+        }
+        writer_waiting.store(true);
+        wake.wait(lock, [&] { return stopping || queued.load() != taken; });
+        writer_waiting.store(false);
+        // Let the rest of a burst arrive so it goes out in one write
+        wake.wait_for(lock, BATCH_DELAY, [&] { return stopping || flush_waiters > 0; });
+    }
+}
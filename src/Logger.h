@@ -0,0 +1,141 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel { Debug, Info, Warning, Error };
+
+// Console output for the library and playlist. Callers only format the line
+// and push it onto a lock-free queue; a background thread writes whatever has
+// piled up in one go and flushes once per batch, so a scan that adds a
+// million songs doesn't pay for a million console flushes. The writer is
+// woken once per burst, not once per line, and lets the burst build up for a
+// moment before writing. Debug and Info go to stdout, Warning and Error to
+// stderr, in the order they were logged.
+// Anything printed directly to std::cout must call flush() first or it can
+// overtake queued lines.
+class Logger {
+public:
+    static Logger& instance();
+
+    void set_level(LogLevel level) { min_level.store(level, std::memory_order_relaxed); }
+    LogLevel get_level() const { return min_level.load(std::memory_order_relaxed); }
+    void set_quiet(bool quiet) { set_level(quiet ? LogLevel::Warning : LogLevel::Info); } // Warnings and errors only
+    bool enabled(LogLevel level) const { return level >= get_level(); }
+
+    void write(LogLevel level, std::string text); // Queues one line (no newline needed); never blocks
+    void flush(); // Returns once every line queued before the call is on the console
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    ~Logger();
+
+private:
+    // Vyukov's intrusive MPSC queue: producers swap themselves in as the
+    // head with one atomic exchange, the writer thread alone walks from tail
+    struct Node {
+        std::atomic<Node*> next;
+        LogLevel level;
+        std::string text;
+    };
+
+    std::atomic<LogLevel> min_level;
+    std::atomic<Node*> head; // Most recently pushed
+    Node* tail; // Next to pop; writer thread only
+    Node stub; // Keeps the queue non-empty so push never touches tail
+
+    std::atomic<uint64_t> queued; // Lines pushed so far
+    uint64_t written; // Lines on the console; guarded by mutex
+    std::atomic<bool> writer_waiting; // Asleep until the next line; the first producer to clear it wakes the writer
+    size_t flush_waiters; // Guarded by mutex
+    bool stopping; // Guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake; // Lines queued, a flush requested, or stopping
+    std::condition_variable drained; // written moved on
+    std::thread writer;
+
+    static constexpr std::chrono::milliseconds BATCH_DELAY{2};
+
+    Logger();
+    void push(Node* node);
+    Node* pop(); // nullptr if empty or a push is half done
+    void writer_loop();
+};
+
+// One log line, built with << and queued when it goes out of scope:
+//   log_info() << "Added '" << song.title << "'";
+// Strings and numbers are appended straight to the line (numbers formatted
+// as iostreams would); other types go through their operator<<. Nothing is
+// formatted if the level is filtered out.
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level(level), enabled(Logger::instance().enabled(level)) {}
+    ~LogLine() {
+        if (enabled) {
+            Logger::instance().write(level, std::move(text));
+        }
+    }
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(std::string_view value) {
+        if (enabled) text += value;
+        return *this;
+    }
+    LogLine& operator<<(const char* value) { return *this << std::string_view(value); }
+    LogLine& operator<<(const std::string& value) { return *this << std::string_view(value); }
+    LogLine& operator<<(char value) {
+        if (enabled) text += value;
+        return *this;
+    }
+    template <typename T>
+    std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value, LogLine&> operator<<(T value) {
+        if (enabled) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            text.append(digits, result.ptr);
+        }
+        return *this;
+    }
+    LogLine& operator<<(double value) {
+        if (enabled) {
+            char digits[32];
+            int length = std::snprintf(digits, sizeof(digits), "%g", value);
+            text.append(digits, length > 0 ? length : 0);
+        }
+        return *this;
+    }
+    template <typename T>
+    std::enable_if_t<!std::is_arithmetic<T>::value && !std::is_convertible<const T&, std::string_view>::value, LogLine&>
+    operator<<(const T& value) {
+        if (enabled) {
+            std::ostringstream stream;
+            stream << value;
+            text += stream.str();
+        }
+        return *this;
+    }
+
+private:
+    LogLevel level;
+    bool enabled;
+    std::string text;
+};
+
+inline LogLine log_debug() { return LogLine(LogLevel::Debug); }
+inline LogLine log_info() { return LogLine(LogLevel::Info); }
+inline LogLine log_warning() { return LogLine(LogLevel::Warning); }
+inline LogLine log_error() { return LogLine(LogLevel::Error); }
+
+#endif // LOGGER_H
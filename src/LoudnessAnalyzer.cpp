@@ -0,0 +1,66 @@
+#include "LoudnessAnalyzer.h"
+#include "AssetResolver.h"
+#include "Logger.h"
+#include "LoudnessMeter.h"
+#include "PcmReader.h"
+
+// Frames decoded per read; small enough that cancelling is quick
+static const size_t CHUNK_FRAMES = 8192;
+
+LoudnessAnalyzer::LoudnessAnalyzer(unsigned thread_count)
+    : pool([this](const PooledPath& file_path, double& audio_seconds,
+                  const std::atomic<bool>& stopping) { return measure(file_path, audio_seconds, stopping); },
+           [](const Totals& totals) {
+               log_info() << "Loudness analysis finished: " << totals.done << " track(s), "
+                          << totals.audio_seconds / 60.0 << " min of audio at " << totals.realtime_per_core()
+                          << "x realtime per core";
+           },
+           thread_count) {}
+
+std::vector<LoudnessResult> LoudnessAnalyzer::collect() {
+    std::lock_guard<std::mutex> lock(finished_mutex);
+    std::vector<LoudnessResult> out;
+    out.swap(finished);
+    return out;
+}
+
+bool LoudnessAnalyzer::measure_file(const std::string& resolved_path, LoudnessResult& result, double& audio_seconds,
+                                    const std::atomic<bool>* cancel) {
+    PcmReader reader;
+    if (!reader.open(resolved_path, PcmReader::Use::Background)) {
+        return false;
+    }
+    unsigned channels = reader.get_channel_count();
+    LoudnessMeter meter(reader.get_sample_rate(), channels);
+    std::vector<int16_t> samples(CHUNK_FRAMES * channels);
+    for (;;) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t frames = reader.read(samples.data(), CHUNK_FRAMES);
+        if (frames == 0) {
+            break;
+        }
+        meter.add_frames(samples.data(), frames);
+    }
+    result.loudness_lufs = static_cast<float>(meter.integrated_lufs());
+    result.true_peak_dbtp = static_cast<float>(meter.true_peak_dbtp());
+    audio_seconds = meter.seconds();
+    return true;
+}
+
+FileWorkerPool::Outcome LoudnessAnalyzer::measure(const PooledPath& file_path, double& audio_seconds,
+                                                   const std::atomic<bool>& stopping) {
+    LoudnessResult result;
+    result.file_path = file_path;
+    std::string resolved = AssetResolver::instance().resolve(file_path);
+    if (!measure_file(resolved, result, audio_seconds, &stopping)) {
+        if (!stopping) {
+            log_warning() << "Loudness analysis: could not decode " << resolved;
+        }
+        return FileWorkerPool::Outcome::Failed;
+    }
+    std::lock_guard<std::mutex> lock(finished_mutex);
+    finished.push_back(result);
+    return FileWorkerPool::Outcome::Done;
+}
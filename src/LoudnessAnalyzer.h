@@ -0,0 +1,49 @@
+#ifndef LOUDNESS_ANALYZER_H
+#define LOUDNESS_ANALYZER_H
+
+#include "FileWorkerPool.h"
+#include "StringPool.h"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct LoudnessResult {
+    PooledPath file_path; // As stored in the Song
+    float loudness_lufs;
+    float true_peak_dbtp;
+};
+
+// Measures library files with LoudnessMeter on a FileWorkerPool.
+// Files are queued with analyse(); finished measurements wait until the UI
+// thread collects them and stores them in its songs (MusicLibrary and
+// Playlist apply_loudness), so no worker ever writes to a Song.
+class LoudnessAnalyzer {
+public:
+    using Totals = FileWorkerPool::Totals; // done: tracks measured
+
+    explicit LoudnessAnalyzer(unsigned thread_count = 0); // 0: one per core, leaving one for playback
+    LoudnessAnalyzer(const LoudnessAnalyzer&) = delete;
+    LoudnessAnalyzer& operator=(const LoudnessAnalyzer&) = delete;
+
+    void analyse(const std::vector<PooledPath>& file_paths) { pool.add(file_paths); }
+    std::vector<LoudnessResult> collect(); // Measurements finished since the last call
+    size_t pending() const { return pool.pending(); } // Queued or being measured
+    Totals get_totals() const { return pool.get_totals(); }
+
+    // Decodes resolved_path and measures it on the calling thread. False if
+    // the file can't be opened or cancel is set before the end.
+    static bool measure_file(const std::string& resolved_path, LoudnessResult& result, double& audio_seconds,
+                             const std::atomic<bool>* cancel = nullptr);
+
+private:
+    std::mutex finished_mutex;
+    std::vector<LoudnessResult> finished;
+    FileWorkerPool pool; // Last, so its workers stop before the rest goes
+
+    FileWorkerPool::Outcome measure(const PooledPath& file_path, double& audio_seconds,
+                                    const std::atomic<bool>& stopping);
+};
+
+#endif // LOUDNESS_ANALYZER_H
@@ -0,0 +1,256 @@
+#include "LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define LOUDNESS_SSE2 1
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const double SAMPLE_SCALE = 1.0 / 32768.0;
+
+LoudnessMeter::LoudnessMeter(unsigned sample_rate, unsigned channel_count)
+    : sample_rate(sample_rate), channel_count(channel_count), padded_channels((channel_count + 1) & ~size_t(1)),
+      frames_in_sub_block(0), sub_block_energy(0), frames_seen(0), history_pos(0), peak(0) {
+    double rate = sample_rate ? sample_rate : 48000;
+
+    // K-weighting: the BS.1770 pre-filter (high shelf, +4 dB) and RLB
+    // high-pass, re-derived for this sample rate
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(PI * f0 / rate);
+    double vh = std::pow(10.0, gain_db / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+             2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(PI * f0 / rate);
+    a0 = 1.0 + k / q + k * k;
+    highpass = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    shelf_z1.assign(padded_channels, 0.0);
+    shelf_z2.assign(padded_channels, 0.0);
+    highpass_z1.assign(padded_channels, 0.0);
+    highpass_z2.assign(padded_channels, 0.0);
+    weights.assign(padded_channels, 0.0);
+    for (unsigned c = 0; c < channel_count; ++c) {
+        weights[c] = 1.0;
+    }
+    if (channel_count == 6) {
+        // 5.1 as L R C LFE Ls Rs: no LFE, surrounds +1.5 dB
+        weights[3] = 0.0;
+        weights[4] = weights[5] = 1.41;
+    }
+    sub_block_frames = std::max<size_t>(1, static_cast<size_t>(rate) / 10);
+
+    // Interpolator: a windowed sinc cut off at the input's Nyquist frequency,
+    // split into phases; each phase is scaled to unity gain at DC
+    oversample = rate < 96000 ? 4 : rate < 192000 ? 2 : 1;
+    size_t length = TAPS * oversample;
+    double centre = (length - 1) / 2.0;
+    std::fill(&taps[0][0], &taps[0][0] + TAPS * PHASES, 0.0f);
+    for (unsigned phase = 0; phase < oversample; ++phase) {
+        double coefficients[TAPS];
+        double sum = 0;
+        for (size_t t = 0; t < TAPS; ++t) {
+            size_t n = phase + t * oversample;
+            double x = (n - centre) / oversample;
+            double sinc = x == 0 ? 1.0 : std::sin(PI * x) / (PI * x);
+            double window = 0.42 - 0.5 * std::cos(2 * PI * (n + 0.5) / length) +
+                            0.08 * std::cos(4 * PI * (n + 0.5) / length);
+            coefficients[t] = sinc * window;
+            sum += coefficients[t];
+        }
+        // coefficients[t] weights the sample t steps back; rows run oldest first
+        for (size_t t = 0; t < TAPS; ++t) {
+            taps[TAPS - 1 - t][phase] = static_cast<float>(coefficients[t] / sum);
+        }
+    }
+    history.assign(2 * TAPS * padded_channels, 0.0f);
+}
+
+void LoudnessMeter::add_frames(const int16_t* samples, size_t frame_count) {
+    if (channel_count == 0) {
+        return;
+    }
+    track_peak(samples, frame_count);
+    frames_seen += frame_count;
+    while (frame_count > 0) {
+        size_t n = std::min(frame_count, sub_block_frames - frames_in_sub_block);
+        sub_block_energy += filter_energy(samples, n);
+        frames_in_sub_block += n;
+        samples += n * channel_count;
+        frame_count -= n;
+        if (frames_in_sub_block == sub_block_frames) {
+            sub_blocks.push_back(sub_block_energy / sub_block_frames);
+            sub_block_energy = 0;
+            frames_in_sub_block = 0;
+            flush_denormals();
+        }
+    }
+}
+
+// Runs frame_count frames through both filters, returning the sum over
+// frames of the weighted squares of the output
+double LoudnessMeter::filter_energy(const int16_t* samples, size_t frame_count) {
+    double energy = 0;
+    size_t c = 0;
+#ifdef LOUDNESS_SSE2
+    const __m128d scale = _mm_set1_pd(SAMPLE_SCALE);
+    const __m128d s_b0 = _mm_set1_pd(shelf.b0), s_b1 = _mm_set1_pd(shelf.b1), s_b2 = _mm_set1_pd(shelf.b2);
+    const __m128d s_a1 = _mm_set1_pd(shelf.a1), s_a2 = _mm_set1_pd(shelf.a2);
+    const __m128d h_a1 = _mm_set1_pd(highpass.a1), h_a2 = _mm_set1_pd(highpass.a2);
+    for (; c + 1 < channel_count; c += 2) {
+        __m128d sz1 = _mm_loadu_pd(&shelf_z1[c]), sz2 = _mm_loadu_pd(&shelf_z2[c]);
+        __m128d hz1 = _mm_loadu_pd(&highpass_z1[c]), hz2 = _mm_loadu_pd(&highpass_z2[c]);
+        __m128d sum = _mm_setzero_pd();
+        const int16_t* frame = samples + c;
+        for (size_t f = 0; f < frame_count; ++f, frame += channel_count) {
+            __m128d x = _mm_mul_pd(_mm_set_pd(frame[1], frame[0]), scale);
+            __m128d y = _mm_add_pd(_mm_mul_pd(s_b0, x), sz1);
+            sz1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(s_b1, x), _mm_mul_pd(s_a1, y)), sz2);
+            sz2 = _mm_sub_pd(_mm_mul_pd(s_b2, x), _mm_mul_pd(s_a2, y));
+            // High-pass numerator is 1, -2, 1
+            __m128d z = _mm_add_pd(y, hz1);
+            hz1 = _mm_sub_pd(_mm_sub_pd(hz2, _mm_add_pd(y, y)), _mm_mul_pd(h_a1, z));
+            hz2 = _mm_sub_pd(y, _mm_mul_pd(h_a2, z));
+            sum = _mm_add_pd(sum, _mm_mul_pd(z, z));
+        }
+        _mm_storeu_pd(&shelf_z1[c], sz1);
+        _mm_storeu_pd(&shelf_z2[c], sz2);
+        _mm_storeu_pd(&highpass_z1[c], hz1);
+        _mm_storeu_pd(&highpass_z2[c], hz2);
+        double lanes[2];
+        _mm_storeu_pd(lanes, sum);
+        energy += weights[c] * lanes[0] + weights[c + 1] * lanes[1];
+    }
+#endif
+    for (; c < channel_count; ++c) {
+        double sz1 = shelf_z1[c], sz2 = shelf_z2[c], hz1 = highpass_z1[c], hz2 = highpass_z2[c];
+        double sum = 0;
+        const int16_t* frame = samples + c;
+        for (size_t f = 0; f < frame_count; ++f, frame += channel_count) {
+            double x = *frame * SAMPLE_SCALE;
+            double y = shelf.b0 * x + sz1;
+            sz1 = shelf.b1 * x - shelf.a1 * y + sz2;
+            sz2 = shelf.b2 * x - shelf.a2 * y;
+            double z = y + hz1;
+            hz1 = hz2 - 2.0 * y - highpass.a1 * z;
+            hz2 = y - highpass.a2 * z;
+            sum += z * z;
+        }
+        shelf_z1[c] = sz1;
+        shelf_z2[c] = sz2;
+        highpass_z1[c] = hz1;
+        highpass_z2[c] = hz2;
+        energy += weights[c] * sum;
+    }
+    return energy;
+}
+
+void LoudnessMeter::track_peak(const int16_t* samples, size_t frame_count) {
+    const float scale = static_cast<float>(SAMPLE_SCALE);
+    if (oversample == 1) {
+        size_t n = frame_count * channel_count;
+        for (size_t i = 0; i < n; ++i) {
+            peak = std::max(peak, std::fabs(samples[i] * scale));
+        }
+        return;
+    }
+    for (size_t f = 0; f < frame_count; ++f) {
+        for (unsigned c = 0; c < channel_count; ++c) {
+            float x = samples[f * channel_count + c] * scale;
+            float* h = &history[c * 2 * TAPS];
+            h[history_pos] = x;
+            h[history_pos + TAPS] = x;
+            const float* window = h + history_pos + 1; // Last TAPS samples, oldest first
+#ifdef LOUDNESS_SSE2
+            // All phases at once: lane p accumulates phase p
+            __m128 acc = _mm_setzero_ps();
+            for (size_t j = 0; j < TAPS; ++j) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(taps[j]), _mm_set1_ps(window[j])));
+            }
+            acc = _mm_andnot_ps(_mm_set1_ps(-0.0f), acc); // fabs
+            acc = _mm_max_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 0, 3, 2)));
+            acc = _mm_max_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1)));
+            peak = std::max(peak, _mm_cvtss_f32(acc));
+#else
+            float acc[PHASES] = {};
+            for (size_t j = 0; j < TAPS; ++j) {
+                for (size_t p = 0; p < PHASES; ++p) {
+                    acc[p] += taps[j][p] * window[j];
+                }
+            }
+            for (size_t p = 0; p < PHASES; ++p) {
+                peak = std::max(peak, std::fabs(acc[p]));
+            }
+#endif
+            peak = std::max(peak, std::fabs(x));
+        }
+        history_pos = history_pos + 1 == TAPS ? 0 : history_pos + 1;
+    }
+}
+
+// Filter state decaying through silence would otherwise go denormal and
+// slow every later sample down
+void LoudnessMeter::flush_denormals() {
+    for (std::vector<double>* state : {&shelf_z1, &shelf_z2, &highpass_z1, &highpass_z2}) {
+        for (double& z : *state) {
+            if (std::fabs(z) < 1e-30) {
+                z = 0.0;
+            }
+        }
+    }
+}
+
+static double energy_to_lufs(double energy) {
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double LoudnessMeter::integrated_lufs() const {
+    // 400 ms blocks every 100 ms, as the mean of four sub-blocks
+    std::vector<double> blocks;
+    for (size_t i = 0; i + 4 <= sub_blocks.size(); ++i) {
+        blocks.push_back((sub_blocks[i] + sub_blocks[i + 1] + sub_blocks[i + 2] + sub_blocks[i + 3]) / 4.0);
+    }
+    // Absolute gate at -70 LUFS, then relative gate 10 LU below what passed it
+    double absolute = std::pow(10.0, (SILENCE_LUFS + 0.691) / 10.0);
+    double sum = 0;
+    size_t count = 0;
+    for (double block : blocks) {
+        if (block > absolute) {
+            sum += block;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return SILENCE_LUFS;
+    }
+    double relative = sum / count * 0.1;
+    double gate = std::max(absolute, relative);
+    sum = 0;
+    count = 0;
+    for (double block : blocks) {
+        if (block > gate) {
+            sum += block;
+            count++;
+        }
+    }
+    return count ? energy_to_lufs(sum / count) : SILENCE_LUFS;
+}
+
+double LoudnessMeter::true_peak_dbtp() const {
+    return peak > 0 ? 20.0 * std::log10(peak) : -std::numeric_limits<double>::infinity();
+}
+
+double LoudnessMeter::replay_gain_db(double integrated_lufs, double true_peak_dbtp) {
+    if (integrated_lufs <= SILENCE_LUFS) {
+        return 0.0; // Nothing to measure; don't boost near-silence
+    }
+    double gain = REFERENCE_LUFS - integrated_lufs;
+    return std::min(gain, PEAK_CEILING_DBTP - true_peak_dbtp);
+}
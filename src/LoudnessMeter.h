@@ -0,0 +1,68 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Integrated loudness (EBU R128 / ITU-R BS.1770-4) and true peak of one
+// track, fed decoded PCM a chunk at a time. Each channel is K-weighted by two
+// biquads and its squares summed into 100 ms sub-blocks; the gated, 75%
+// overlapping 400 ms blocks are only formed at the end. True peak is the
+// largest sample of a 4x oversampled copy (2x from 96 kHz, none from 192 kHz).
+//
+// The kernels run two channels per SSE2 register (the filters are recursive,
+// so channels are the parallel dimension) and all four interpolation phases
+// of a sample in one; other targets use the scalar loops.
+class LoudnessMeter {
+public:
+    static constexpr double SILENCE_LUFS = -70.0; // Reported when every block is gated out
+    static constexpr double REFERENCE_LUFS = -18.0; // ReplayGain 2.0 target
+    static constexpr double PEAK_CEILING_DBTP = -1.0;
+
+    LoudnessMeter(unsigned sample_rate, unsigned channel_count);
+
+    void add_frames(const int16_t* samples, size_t frame_count); // Interleaved
+    double integrated_lufs() const;
+    double true_peak_dbtp() const; // -inf for digital silence
+    double seconds() const { return sample_rate ? double(frames_seen) / sample_rate : 0.0; }
+
+    // Gain that brings a track to REFERENCE_LUFS, reduced as needed to keep
+    // its true peak at or below PEAK_CEILING_DBTP
+    static double replay_gain_db(double integrated_lufs, double true_peak_dbtp);
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2; // a0 normalised to 1
+    };
+
+    static const size_t TAPS = 12; // Per interpolation phase
+    static const size_t PHASES = 4; // Lanes of the interpolator; unused ones have zero taps
+
+    unsigned sample_rate;
+    unsigned channel_count;
+    size_t padded_channels; // Rounded up to a whole SIMD pair
+    Biquad shelf;
+    Biquad highpass;
+    // Transposed direct form II state, one entry per channel so a pair is contiguous
+    std::vector<double> shelf_z1, shelf_z2, highpass_z1, highpass_z2;
+    std::vector<double> weights; // BS.1770 channel weights, 0 for LFE and padding
+
+    size_t sub_block_frames;
+    size_t frames_in_sub_block;
+    double sub_block_energy; // Weighted sum of squares so far
+    std::vector<double> sub_blocks; // Weighted mean square of each finished sub-block
+    uint64_t frames_seen;
+
+    unsigned oversample;
+    float taps[TAPS][PHASES]; // Row j weights the j-th oldest of the last TAPS samples
+    std::vector<float> history; // 2 * TAPS per channel, each sample written twice
+    size_t history_pos;
+    float peak; // Linear, full scale = 1
+
+    double filter_energy(const int16_t* samples, size_t frame_count);
+    void track_peak(const int16_t* samples, size_t frame_count);
+    void flush_denormals();
+};
+
+#endif // LOUDNESS_METER_H
@@ -0,0 +1,196 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : view(nullptr), view_size(0), view_offset(0), total_size(0), mapping_base(nullptr), mapping_size(0)
+#ifdef _WIN32
+    , file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+#else
+    , fd(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::is_open() const {
+    return file_handle != INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_handle, &size)) {
+        close();
+        return false;
+    }
+    total_size = static_cast<uint64_t>(size.QuadPart);
+    if (total_size > 0) {
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_handle) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MappedFile::map(uint64_t offset, size_t length) {
+    unmap();
+    if (!is_open() || offset > total_size) {
+        return false;
+    }
+    uint64_t available = total_size - offset;
+    if (length == 0 || length > available) {
+        length = static_cast<size_t>(available);
+    }
+    view_offset = offset;
+    if (length == 0) {
+        return true;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    uint64_t aligned = offset - offset % info.dwAllocationGranularity;
+    size_t delta = static_cast<size_t>(offset - aligned);
+    void* base = MapViewOfFile(mapping_handle, FILE_MAP_READ, static_cast<DWORD>(aligned >> 32),
+                               static_cast<DWORD>(aligned & 0xFFFFFFFFu), length + delta);
+    if (!base) {
+        return false;
+    }
+    mapping_base = base;
+    mapping_size = length + delta;
+    view = static_cast<const unsigned char*>(base) + delta;
+    view_size = length;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (mapping_base) {
+        UnmapViewOfFile(mapping_base);
+    }
+    mapping_base = nullptr;
+    mapping_size = 0;
+    view = nullptr;
+    view_size = 0;
+    view_offset = 0;
+}
+
+void MappedFile::close() {
+    unmap();
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+        file_handle = INVALID_HANDLE_VALUE;
+    }
+    total_size = 0;
+}
+
+void MappedFile::advise(Access, bool) const {
+    // The Windows cache manager picks its own readahead for mapped views
+}
+
+#else
+
+bool MappedFile::is_open() const {
+    return fd >= 0;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close();
+        return false;
+    }
+    total_size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool MappedFile::map(uint64_t offset, size_t length) {
+    unmap();
+    if (!is_open() || offset > total_size) {
+        return false;
+    }
+    uint64_t available = total_size - offset;
+    if (length == 0 || length > available) {
+        length = static_cast<size_t>(available);
+    }
+    view_offset = offset;
+    if (length == 0) {
+        return true;
+    }
+
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t aligned = offset - offset % page_size;
+    size_t delta = static_cast<size_t>(offset - aligned);
+    void* base = mmap(nullptr, length + delta, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(aligned));
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    mapping_base = base;
+    mapping_size = length + delta;
+    view = static_cast<const unsigned char*>(base) + delta;
+    view_size = length;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (mapping_base) {
+        munmap(mapping_base, mapping_size);
+    }
+    mapping_base = nullptr;
+    mapping_size = 0;
+    view = nullptr;
+    view_size = 0;
+    view_offset = 0;
+}
+
+void MappedFile::close() {
+    unmap();
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    total_size = 0;
+}
+
+void MappedFile::advise(Access access, bool will_need) const {
+    if (!mapping_base) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (access == Access::Sequential) {
+        advice = MADV_SEQUENTIAL;
+    } else if (access == Access::Random) {
+        advice = MADV_RANDOM;
+    }
+    madvise(mapping_base, mapping_size, advice);
+    if (will_need) {
+        madvise(mapping_base, mapping_size, MADV_WILLNEED);
+    }
+}
+
+#endif
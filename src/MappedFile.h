@@ -0,0 +1,51 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a file, or of a window into it. The file stays
+// open between map() calls so a reader can look at the head, then the tail,
+// without re-opening it. Windows uses CreateFileMapping, everything else mmap.
+class MappedFile {
+public:
+    enum class Access { Normal, Sequential, Random };
+
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path); // Opens the file, maps nothing yet
+    // Maps [offset, offset + length), clamped to the file; length 0 means "to
+    // the end". Replaces any previous window. Empty files map to an empty view.
+    bool map(uint64_t offset = 0, size_t length = 0);
+    void unmap();
+    void close();
+
+    // Hints for the kernel's readahead; no-ops where unsupported
+    void advise(Access access, bool will_need = false) const;
+
+    bool is_open() const;
+    const unsigned char* data() const { return view; }
+    size_t size() const { return view_size; }
+    uint64_t offset() const { return view_offset; }
+    uint64_t file_size() const { return total_size; }
+
+private:
+    const unsigned char* view; // Start of the requested window
+    size_t view_size;
+    uint64_t view_offset;
+    uint64_t total_size;
+    void* mapping_base; // Page/granularity aligned start actually mapped
+    size_t mapping_size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int fd;
+#endif
+};
+
+#endif // MAPPED_FILE_H
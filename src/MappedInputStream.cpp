@@ -0,0 +1,99 @@
+#include "MappedInputStream.h"
+#include "DirectoryScanner.h"
+#include <algorithm>
+#include <cstring>
+
+MappingCache& MappingCache::instance() {
+    static MappingCache cache;
+    return cache;
+}
+
+std::shared_ptr<const MappedFile> MappingCache::get(const std::string& resolved_path) {
+    // Size and modification time, to notice files replaced since they were mapped
+    FileStamp stamp;
+    if (!read_file_stamp(resolved_path, stamp)) {
+        return nullptr;
+    }
+    int64_t mtime_ns = stamp.mtime_ns;
+    uint64_t size = stamp.size;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->path == resolved_path) {
+            if (it->mtime_ns == mtime_ns && it->size == size) {
+                entries.splice(entries.begin(), entries, it);
+                // Playback is about to read it from the start again
+                it->file->advise(MappedFile::Access::Sequential, true);
+                return it->file;
+            }
+            entries.erase(it); // Stale; streams still using it keep it alive
+            break;
+        }
+    }
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(resolved_path) || !file->map()) {
+        return nullptr;
+    }
+    file->advise(MappedFile::Access::Sequential, true);
+
+    entries.push_front({resolved_path, mtime_ns, size, file});
+    while (entries.size() > capacity) {
+        entries.pop_back();
+    }
+    return file;
+}
+
+void MappingCache::set_capacity(size_t max_entries) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = max_entries;
+    while (entries.size() > capacity) {
+        entries.pop_back();
+    }
+}
+
+void MappingCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
+
+MappedInputStream::MappedInputStream(const std::string& resolved_path, bool cached) : position(0) {
+    if (cached) {
+        file = MappingCache::instance().get(resolved_path);
+        return;
+    }
+    std::shared_ptr<MappedFile> own = std::make_shared<MappedFile>();
+    if (own->open(resolved_path) && own->map()) {
+        own->advise(MappedFile::Access::Sequential);
+        file = std::move(own);
+    }
+}
+
+sf::Int64 MappedInputStream::read(void* data, sf::Int64 size) {
+    if (!file || size < 0) {
+        return -1;
+    }
+    uint64_t available = file->size() - std::min<uint64_t>(position, file->size());
+    uint64_t count = std::min<uint64_t>(static_cast<uint64_t>(size), available);
+    if (count > 0) {
+        std::memcpy(data, file->data() + position, static_cast<size_t>(count));
+        position += count;
+    }
+    return static_cast<sf::Int64>(count);
+}
+
+sf::Int64 MappedInputStream::seek(sf::Int64 position) {
+    if (!file || position < 0) {
+        return -1;
+    }
+    this->position = std::min<uint64_t>(static_cast<uint64_t>(position), file->size());
+    return static_cast<sf::Int64>(this->position);
+}
+
+sf::Int64 MappedInputStream::tell() {
+    return file ? static_cast<sf::Int64>(position) : -1;
+}
+
+sf::Int64 MappedInputStream::getSize() {
+    return file ? static_cast<sf::Int64>(file->size()) : -1;
+}
@@ -0,0 +1,62 @@
+#ifndef MAPPED_INPUT_STREAM_H
+#define MAPPED_INPUT_STREAM_H
+
+#include "MappedFile.h"
+#include <SFML/System/InputStream.hpp>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Process-wide cache of whole-file read-only mappings, keyed by resolved
+// path. Re-playing a recently played song reuses the mapping (and whatever
+// of it is still in the page cache) instead of opening the file again.
+// Entries are dropped least-recently-used first, and re-validated against
+// the file's size and mtime on every lookup.
+class MappingCache {
+public:
+    static MappingCache& instance();
+
+    // Returns nullptr if the file can't be opened or mapped
+    std::shared_ptr<const MappedFile> get(const std::string& resolved_path);
+    void set_capacity(size_t max_entries);
+    void clear();
+
+private:
+    struct Entry {
+        std::string path;
+        int64_t mtime_ns;
+        uint64_t size;
+        std::shared_ptr<const MappedFile> file;
+    };
+
+    MappingCache() : capacity(16) {}
+
+    std::mutex mutex;
+    std::list<Entry> entries; // Most recently used first
+    size_t capacity;
+};
+
+// sf::InputStream straight over a mapped file: read() is a single memcpy from
+// the mapping into the decoder's buffer, with no intermediate file buffer.
+class MappedInputStream : public sf::InputStream {
+public:
+    // Maps through MappingCache, or if not cached, on its own with no
+    // read-ahead beyond what sequential reading brings; check is_open()
+    // afterwards
+    explicit MappedInputStream(const std::string& resolved_path, bool cached = true);
+
+    bool is_open() const { return file != nullptr; }
+
+    sf::Int64 read(void* data, sf::Int64 size) override;
+    sf::Int64 seek(sf::Int64 position) override;
+    sf::Int64 tell() override;
+    sf::Int64 getSize() override;
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    uint64_t position;
+};
+
+#endif // MAPPED_INPUT_STREAM_H
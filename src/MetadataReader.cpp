@@ -0,0 +1,613 @@
+#include "MetadataReader.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+const size_t HEAD_WINDOW = 16 * 1024; // Enough for headers when there is no big tag
+const size_t TAIL_WINDOW = 16 * 1024; // ID3v1 and (usually) the last Ogg page
+const size_t MAX_OGG_PAGE = 65307; // 27 + 255 + 255 * 255
+const size_t MAX_HEAD_BYTES = 16 * 1024 * 1024; // Cap for tags with embedded artwork
+
+uint32_t read_be32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint32_t read_le32(const unsigned char* p) {
+    return (uint32_t(p[3]) << 24) | (uint32_t(p[2]) << 16) | (uint32_t(p[1]) << 8) | p[0];
+}
+
+uint64_t read_le64(const unsigned char* p) {
+    return (uint64_t(read_le32(p + 4)) << 32) | read_le32(p);
+}
+
+uint32_t read_syncsafe(const unsigned char* p) {
+    return (uint32_t(p[0] & 0x7F) << 21) | (uint32_t(p[1] & 0x7F) << 14) | (uint32_t(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+void trim(std::string& text) {
+    size_t end = text.find_last_not_of(std::string(" \t\r\n\0", 5));
+    text.erase(end == std::string::npos ? 0 : end + 1);
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    text.erase(0, begin == std::string::npos ? text.size() : begin);
+}
+
+std::string latin1_to_utf8(const unsigned char* p, size_t length) {
+    std::string out;
+    out.reserve(length);
+    for (size_t i = 0; i < length && p[i] != 0; ++i) {
+        append_utf8(out, p[i]);
+    }
+    trim(out);
+    return out;
+}
+
+std::string utf16_to_utf8(const unsigned char* p, size_t length, bool big_endian) {
+    std::string out;
+    out.reserve(length / 2);
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        uint32_t unit = big_endian ? (uint32_t(p[i]) << 8 | p[i + 1]) : (uint32_t(p[i + 1]) << 8 | p[i]);
+        if (unit == 0) {
+            break;
+        }
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < length) {
+            uint32_t low = big_endian ? (uint32_t(p[i + 2]) << 8 | p[i + 3]) : (uint32_t(p[i + 3]) << 8 | p[i + 2]);
+            if (low >= 0xDC00 && low < 0xE000) {
+                append_utf8(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                i += 2;
+                continue;
+            }
+        }
+        append_utf8(out, unit);
+    }
+    trim(out);
+    return out;
+}
+
+std::string utf8_field(const unsigned char* p, size_t length) {
+    const unsigned char* end = static_cast<const unsigned char*>(std::memchr(p, 0, length));
+    std::string out(reinterpret_cast<const char*>(p), end ? static_cast<size_t>(end - p) : length);
+    trim(out);
+    return out;
+}
+
+// ID3v2 text frame payload: one encoding byte, then the (first) string
+std::string decode_id3_text(const unsigned char* p, size_t length) {
+    if (length < 2) {
+        return std::string();
+    }
+    unsigned char encoding = p[0];
+    p++;
+    length--;
+    switch (encoding) {
+    case 0: return latin1_to_utf8(p, length);
+    case 1:
+        if (length >= 2 && p[0] == 0xFE && p[1] == 0xFF) return utf16_to_utf8(p + 2, length - 2, true);
+        if (length >= 2 && p[0] == 0xFF && p[1] == 0xFE) return utf16_to_utf8(p + 2, length - 2, false);
+        return utf16_to_utf8(p, length, false);
+    case 2: return utf16_to_utf8(p, length, true);
+    case 3: return utf8_field(p, length);
+    default: return std::string();
+    }
+}
+
+// Removes the 0x00 stuffed after every 0xFF by ID3 unsynchronisation
+std::string remove_unsync(const unsigned char* p, size_t length) {
+    std::string out;
+    out.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        out += static_cast<char>(p[i]);
+        if (p[i] == 0xFF && i + 1 < length && p[i + 1] == 0x00) {
+            i++;
+        }
+    }
+    return out;
+}
+
+void set_if_empty(std::string& field, const std::string& value) {
+    if (field.empty() && !value.empty()) {
+        field = value;
+    }
+}
+
+// Parses an ID3v2 tag that starts at the beginning of `tag`
+void parse_id3v2(const unsigned char* tag, size_t available, AudioMetadata& metadata, int& tlen_ms) {
+    unsigned version = tag[3];
+    unsigned char flags = tag[5];
+    size_t tag_end = std::min<size_t>(available, 10 + read_syncsafe(tag + 6));
+
+    std::string unsynced;
+    const unsigned char* body = tag + 10;
+    size_t body_size = tag_end - 10;
+    if ((flags & 0x80) && version < 4) {
+        // v2.2/v2.3 unsynchronise the whole tag body
+        unsynced = remove_unsync(body, body_size);
+        body = reinterpret_cast<const unsigned char*>(unsynced.data());
+        body_size = unsynced.size();
+    }
+
+    size_t pos = 0;
+    if ((flags & 0x40) && version >= 3 && body_size >= 4) {
+        size_t ext = (version == 3) ? read_be32(body) + 4 : read_syncsafe(body);
+        pos = std::min(ext, body_size);
+    }
+
+    const size_t header_size = (version == 2) ? 6 : 10;
+    std::string artist_fallback;
+    while (pos + header_size <= body_size) {
+        const unsigned char* frame = body + pos;
+        if (frame[0] == 0) {
+            break; // Padding
+        }
+        std::string id;
+        size_t frame_size;
+        unsigned char format_flags = 0;
+        if (version == 2) {
+            id.assign(reinterpret_cast<const char*>(frame), 3);
+            frame_size = (size_t(frame[3]) << 16) | (size_t(frame[4]) << 8) | frame[5];
+        } else {
+            id.assign(reinterpret_cast<const char*>(frame), 4);
+            frame_size = (version == 4) ? read_syncsafe(frame + 4) : read_be32(frame + 4);
+            format_flags = frame[9];
+        }
+        pos += header_size;
+        if (frame_size > body_size - pos) {
+            break;
+        }
+        const unsigned char* data = body + pos;
+        size_t data_size = frame_size;
+        pos += frame_size;
+
+        bool compressed_or_encrypted = (version == 3) ? (format_flags & 0xC0) != 0
+                                     : (version == 4) ? (format_flags & 0x0C) != 0 : false;
+        if (compressed_or_encrypted) {
+            continue;
+        }
+        std::string frame_unsynced;
+        if (version == 4) {
+            if (format_flags & 0x01) { // Data length indicator
+                if (data_size < 4) continue;
+                data += 4;
+                data_size -= 4;
+            }
+            if ((format_flags & 0x02) || (flags & 0x80)) {
+                frame_unsynced = remove_unsync(data, data_size);
+                data = reinterpret_cast<const unsigned char*>(frame_unsynced.data());
+                data_size = frame_unsynced.size();
+            }
+        }
+
+        if (id == "TIT2" || id == "TT2") {
+            set_if_empty(metadata.title, decode_id3_text(data, data_size));
+        } else if (id == "TPE1" || id == "TP1") {
+            set_if_empty(metadata.artist, decode_id3_text(data, data_size));
+        } else if (id == "TPE2" || id == "TP2") {
+            set_if_empty(artist_fallback, decode_id3_text(data, data_size));
+        } else if (id == "TALB" || id == "TAL") {
+            set_if_empty(metadata.album, decode_id3_text(data, data_size));
+        } else if (id == "TLEN" || id == "TLE") {
+            std::string text = decode_id3_text(data, data_size);
+            auto is_digit = [](unsigned char c) { return c >= '0' && c <= '9'; };
+            if (!text.empty() && std::all_of(text.begin(), text.end(), is_digit) && text.size() < 10) {
+                tlen_ms = std::stoi(text);
+            }
+        }
+    }
+    set_if_empty(metadata.artist, artist_fallback);
+}
+
+void parse_id3v1(const unsigned char* tag, AudioMetadata& metadata) {
+    set_if_empty(metadata.title, latin1_to_utf8(tag + 3, 30));
+    set_if_empty(metadata.artist, latin1_to_utf8(tag + 33, 30));
+    set_if_empty(metadata.album, latin1_to_utf8(tag + 63, 30));
+}
+
+// "KEY=value" comments shared by FLAC and Ogg (little-endian lengths)
+void parse_vorbis_comments(const unsigned char* p, size_t length, AudioMetadata& metadata) {
+    if (length < 8) {
+        return;
+    }
+    size_t pos = 4 + static_cast<size_t>(read_le32(p)); // Skip the vendor string
+    if (pos + 4 > length) {
+        return;
+    }
+    uint32_t count = read_le32(p + pos);
+    pos += 4;
+    std::string artist_fallback;
+    for (uint32_t i = 0; i < count && pos + 4 <= length; ++i) {
+        size_t comment_size = read_le32(p + pos);
+        pos += 4;
+        if (comment_size > length - pos) {
+            break; // Truncated by the window (e.g. a huge embedded picture)
+        }
+        const char* comment = reinterpret_cast<const char*>(p + pos);
+        pos += comment_size;
+        const char* equals = static_cast<const char*>(std::memchr(comment, '=', comment_size));
+        if (!equals) {
+            continue;
+        }
+        std::string key(comment, equals);
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::toupper(c); });
+        std::string value(equals + 1, comment + comment_size);
+        trim(value);
+        if (key == "TITLE") {
+            set_if_empty(metadata.title, value);
+        } else if (key == "ARTIST") {
+            set_if_empty(metadata.artist, value);
+        } else if (key == "ALBUMARTIST" || key == "ALBUM ARTIST") {
+            set_if_empty(artist_fallback, value);
+        } else if (key == "ALBUM") {
+            set_if_empty(metadata.album, value);
+        }
+    }
+    set_if_empty(metadata.artist, artist_fallback);
+}
+
+struct Mp3Info {
+    bool found = false;
+    uint64_t audio_start = 0; // File offset of the first frame
+    int bitrate_kbps = 0;
+    int sample_rate = 0;
+    int samples_per_frame = 0;
+    uint32_t frame_count = 0; // From Xing/Info/VBRI, 0 for plain CBR
+};
+
+bool parse_mp3_header(const unsigned char* h, int& bitrate_kbps, int& sample_rate, int& samples_per_frame,
+                      size_t& frame_length, int& version_id, int& channel_mode) {
+    static const int bitrates[2][3][16] = {
+        { // MPEG-1: layer I, II, III
+            {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+            {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0},
+        },
+        { // MPEG-2 / 2.5
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+        },
+    };
+    static const int sample_rates[3] = {44100, 48000, 32000};
+
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+    version_id = (h[1] >> 3) & 3; // 0 = 2.5, 2 = 2, 3 = 1
+    int layer_bits = (h[1] >> 1) & 3; // 1 = III, 2 = II, 3 = I
+    int bitrate_index = h[2] >> 4;
+    int rate_index = (h[2] >> 2) & 3;
+    if (version_id == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return false;
+    }
+    int layer = 4 - layer_bits;
+    bool mpeg1 = version_id == 3;
+    bitrate_kbps = bitrates[mpeg1 ? 0 : 1][layer - 1][bitrate_index];
+    sample_rate = sample_rates[rate_index] >> (mpeg1 ? 0 : (version_id == 2 ? 1 : 2));
+    int padding = (h[2] >> 1) & 1;
+    channel_mode = h[3] >> 6;
+    if (layer == 1) {
+        samples_per_frame = 384;
+        frame_length = static_cast<size_t>((12 * bitrate_kbps * 1000 / sample_rate + padding) * 4);
+    } else {
+        samples_per_frame = (layer == 3 && !mpeg1) ? 576 : 1152;
+        frame_length = static_cast<size_t>(samples_per_frame / 8 * bitrate_kbps * 1000 / sample_rate + padding);
+    }
+    return frame_length > 4;
+}
+
+// Finds the first frame at or after `start` (requiring a second valid header
+// right behind it, so stray 0xFF bytes aren't mistaken for a sync word)
+void parse_mp3(const unsigned char* data, size_t size, size_t start, uint64_t base_offset, Mp3Info& info) {
+    for (size_t pos = start; pos + 4 <= size; ++pos) {
+        if (data[pos] != 0xFF || (data[pos + 1] & 0xE0) != 0xE0) {
+            continue;
+        }
+        int bitrate, rate, spf, version, channels;
+        size_t length;
+        if (!parse_mp3_header(data + pos, bitrate, rate, spf, length, version, channels)) {
+            continue;
+        }
+        if (pos + length + 4 <= size) {
+            int b2, r2, s2, v2, c2;
+            size_t l2;
+            if (!parse_mp3_header(data + pos + length, b2, r2, s2, l2, v2, c2) || r2 != rate) {
+                continue;
+            }
+        }
+
+        info.found = true;
+        info.audio_start = base_offset + pos;
+        info.bitrate_kbps = bitrate;
+        info.sample_rate = rate;
+        info.samples_per_frame = spf;
+
+        // Xing/Info sits after the side info; VBRI always 32 bytes after the header
+        bool mono = channels == 3;
+        size_t side_info = (version == 3) ? (mono ? 17 : 32) : (mono ? 9 : 17);
+        const unsigned char* xing = data + pos + 4 + side_info;
+        const unsigned char* vbri = data + pos + 4 + 32;
+        if (pos + 4 + side_info + 12 <= size &&
+            (std::memcmp(xing, "Xing", 4) == 0 || std::memcmp(xing, "Info", 4) == 0)) {
+            if (read_be32(xing + 4) & 1) {
+                info.frame_count = read_be32(xing + 8);
+            }
+        } else if (pos + 4 + 32 + 18 <= size && std::memcmp(vbri, "VBRI", 4) == 0) {
+            info.frame_count = read_be32(vbri + 14);
+        }
+        return;
+    }
+}
+
+void parse_flac(const unsigned char* data, size_t size, size_t pos, AudioMetadata& metadata) {
+    pos += 4; // "fLaC"
+    while (pos + 4 <= size) {
+        bool last = (data[pos] & 0x80) != 0;
+        int type = data[pos] & 0x7F;
+        size_t length = (size_t(data[pos + 1]) << 16) | (size_t(data[pos + 2]) << 8) | data[pos + 3];
+        pos += 4;
+        const unsigned char* block = data + pos;
+        size_t available = std::min(length, size - pos);
+        if (type == 0 && available >= 18) { // STREAMINFO
+            uint32_t sample_rate = (uint32_t(block[10]) << 12) | (uint32_t(block[11]) << 4) | (block[12] >> 4);
+            uint64_t total_samples = (uint64_t(block[13] & 0x0F) << 32) | read_be32(block + 14);
+            if (sample_rate > 0 && total_samples > 0) {
+                metadata.duration_seconds = static_cast<int>((total_samples + sample_rate / 2) / sample_rate);
+            }
+        } else if (type == 4) { // VORBIS_COMMENT
+            parse_vorbis_comments(block, available, metadata);
+        }
+        if (last || length > size - pos) {
+            break;
+        }
+        pos += length;
+    }
+}
+
+struct OggInfo {
+    bool found = false;
+    uint32_t serial = 0;
+    uint32_t sample_rate = 0; // Granule rate (48 kHz for Opus)
+    uint64_t pre_skip = 0;
+};
+
+// Reassembles the first two packets of the first logical stream: the codec
+// identification header and the comment header
+void parse_ogg_head(const unsigned char* data, size_t size, size_t pos, AudioMetadata& metadata, OggInfo& info) {
+    std::string packet;
+    int packet_index = 0;
+    while (packet_index < 2 && pos + 27 <= size && std::memcmp(data + pos, "OggS", 4) == 0) {
+        uint32_t serial = read_le32(data + pos + 14);
+        size_t segments = data[pos + 26];
+        size_t body = pos + 27 + segments;
+        if (body > size) {
+            break;
+        }
+        if (!info.found) {
+            info.serial = serial;
+        }
+        const unsigned char* lacing = data + pos + 27;
+        size_t body_size = 0;
+        for (size_t i = 0; i < segments; ++i) {
+            body_size += lacing[i];
+        }
+        if (serial == info.serial) {
+            size_t offset = body;
+            for (size_t i = 0; i < segments && packet_index < 2; ++i) {
+                size_t take = std::min<size_t>(lacing[i], size > offset ? size - offset : 0);
+                packet.append(reinterpret_cast<const char*>(data + offset), take);
+                offset += lacing[i];
+                if (lacing[i] < 255) {
+                    const unsigned char* p = reinterpret_cast<const unsigned char*>(packet.data());
+                    if (packet_index == 0) {
+                        if (packet.size() >= 16 && std::memcmp(p, "\x01vorbis", 7) == 0) {
+                            info.found = true;
+                            info.sample_rate = read_le32(p + 12);
+                        } else if (packet.size() >= 16 && std::memcmp(p, "OpusHead", 8) == 0) {
+                            info.found = true;
+                            info.sample_rate = 48000;
+                            info.pre_skip = p[10] | (uint32_t(p[11]) << 8);
+                        } else {
+                            return; // Not a codec we know
+                        }
+                    } else if (packet.size() > 7 && std::memcmp(p, "\x03vorbis", 7) == 0) {
+                        parse_vorbis_comments(p + 7, packet.size() - 7, metadata);
+                    } else if (packet.size() > 8 && std::memcmp(p, "OpusTags", 8) == 0) {
+                        parse_vorbis_comments(p + 8, packet.size() - 8, metadata);
+                    }
+                    packet.clear();
+                    packet_index++;
+                }
+            }
+        }
+        pos = body + body_size;
+    }
+    if (packet_index == 1 && !packet.empty()) {
+        // Comment header cut off by the window; read what we have
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(packet.data());
+        if (packet.size() > 7 && std::memcmp(p, "\x03vorbis", 7) == 0) {
+            parse_vorbis_comments(p + 7, packet.size() - 7, metadata);
+        } else if (packet.size() > 8 && std::memcmp(p, "OpusTags", 8) == 0) {
+            parse_vorbis_comments(p + 8, packet.size() - 8, metadata);
+        }
+    }
+}
+
+// Granule position of the last page of the stream, searching backwards
+bool find_last_granule(const unsigned char* data, size_t size, uint32_t serial, uint64_t& granule) {
+    for (size_t pos = size >= 27 ? size - 27 : 0; pos + 27 <= size; --pos) {
+        if (data[pos] == 'O' && std::memcmp(data + pos, "OggS", 4) == 0 && read_le32(data + pos + 14) == serial) {
+            uint64_t value = read_le64(data + pos + 6);
+            if (value != ~uint64_t(0)) {
+                granule = value;
+                return true;
+            }
+        }
+        if (pos == 0) {
+            break;
+        }
+    }
+    return false;
+}
+
+void parse_wav(const unsigned char* data, size_t size, AudioMetadata& metadata) {
+    uint32_t byte_rate = 0;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        uint32_t chunk_size = read_le32(data + pos + 4);
+        if (std::memcmp(data + pos, "fmt ", 4) == 0 && pos + 8 + 12 <= size) {
+            byte_rate = read_le32(data + pos + 8 + 8);
+        } else if (std::memcmp(data + pos, "data", 4) == 0) {
+            if (byte_rate > 0) {
+                metadata.duration_seconds = static_cast<int>(chunk_size / byte_rate);
+            }
+            return;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+}
+
+// Maps [0, bytes) of the file, growing the head window when a tag is bigger
+// than the default
+bool map_head(MappedFile& file, size_t bytes) {
+    bytes = std::min<size_t>(bytes, MAX_HEAD_BYTES);
+    if (file.offset() == 0 && file.size() >= std::min<uint64_t>(bytes, file.file_size())) {
+        return true;
+    }
+    return file.map(0, bytes);
+}
+
+} // namespace
+
+bool read_audio_metadata(const std::string& path, AudioMetadata& metadata) {
+    MappedFile file;
+    if (!file.open(path) || file.file_size() < 16) {
+        return false;
+    }
+    const uint64_t file_size = file.file_size();
+    if (!file.map(0, HEAD_WINDOW)) {
+        return false;
+    }
+
+    bool recognised = false;
+    int tlen_ms = 0;
+    size_t pos = 0;
+    if (std::memcmp(file.data(), "ID3", 3) == 0 && file.size() >= 10) {
+        size_t tag_size = 10 + read_syncsafe(file.data() + 6) + ((file.data()[5] & 0x10) ? 10 : 0);
+        if (!map_head(file, tag_size + HEAD_WINDOW)) {
+            return false;
+        }
+        parse_id3v2(file.data(), std::min(tag_size, file.size()), metadata, tlen_ms);
+        recognised = true;
+        pos = tag_size;
+    }
+
+    const unsigned char* head = file.data();
+    size_t head_size = file.size();
+    Mp3Info mp3;
+    OggInfo ogg;
+    if (pos + 4 <= head_size && std::memcmp(head + pos, "fLaC", 4) == 0) {
+        // Metadata blocks can hold artwork; make sure the whole chain is mapped
+        size_t end = pos + 4;
+        while (end + 4 <= file.size() && end < MAX_HEAD_BYTES) {
+            size_t length = (size_t(file.data()[end + 1]) << 16) | (size_t(file.data()[end + 2]) << 8) | file.data()[end + 3];
+            bool last = (file.data()[end] & 0x80) != 0;
+            end += 4 + length;
+            if (last) break;
+            if (end + 4 > file.size() && !map_head(file, end + HEAD_WINDOW)) break;
+        }
+        map_head(file, end);
+        parse_flac(file.data(), file.size(), pos, metadata);
+        recognised = true;
+    } else if (pos + 4 <= head_size && std::memcmp(head + pos, "OggS", 4) == 0) {
+        parse_ogg_head(head, head_size, pos, metadata, ogg);
+        recognised = recognised || ogg.found;
+    } else if (pos == 0 && head_size >= 12 && std::memcmp(head, "RIFF", 4) == 0 && std::memcmp(head + 8, "WAVE", 4) == 0) {
+        parse_wav(head, head_size, metadata);
+        recognised = true;
+    } else {
+        parse_mp3(head, head_size, pos, 0, mp3);
+        recognised = recognised || mp3.found;
+    }
+
+    // Tail: ID3v1 and the Ogg end-of-stream granule
+    bool has_id3v1 = false;
+    size_t tail_size = static_cast<size_t>(std::min<uint64_t>(file_size, ogg.found ? TAIL_WINDOW : 128));
+    if (file.map(file_size - tail_size, tail_size)) {
+        if (file.size() >= 128 && std::memcmp(file.data() + file.size() - 128, "TAG", 3) == 0) {
+            parse_id3v1(file.data() + file.size() - 128, metadata);
+            has_id3v1 = true;
+            recognised = true;
+        }
+        if (ogg.found && ogg.sample_rate > 0) {
+            uint64_t granule = 0;
+            bool found = find_last_granule(file.data(), file.size(), ogg.serial, granule);
+            if (!found && file_size > tail_size) {
+                size_t wider = static_cast<size_t>(std::min<uint64_t>(file_size, MAX_OGG_PAGE + TAIL_WINDOW));
+                found = file.map(file_size - wider, wider) &&
+                        find_last_granule(file.data(), file.size(), ogg.serial, granule);
+            }
+            if (found && granule > ogg.pre_skip) {
+                metadata.duration_seconds = static_cast<int>((granule - ogg.pre_skip + ogg.sample_rate / 2) / ogg.sample_rate);
+            }
+        }
+    }
+
+    if (mp3.found && metadata.duration_seconds == 0) {
+        if (mp3.frame_count > 0 && mp3.sample_rate > 0) {
+            uint64_t samples = uint64_t(mp3.frame_count) * mp3.samples_per_frame;
+            metadata.duration_seconds = static_cast<int>((samples + mp3.sample_rate / 2) / mp3.sample_rate);
+        } else if (tlen_ms > 0) {
+            metadata.duration_seconds = (tlen_ms + 500) / 1000;
+        } else if (mp3.bitrate_kbps > 0) {
+            uint64_t audio_bytes = file_size - mp3.audio_start - (has_id3v1 ? 128 : 0);
+            metadata.duration_seconds = static_cast<int>(audio_bytes * 8 / (uint64_t(mp3.bitrate_kbps) * 1000));
+        }
+    } else if (metadata.duration_seconds == 0 && tlen_ms > 0) {
+        metadata.duration_seconds = (tlen_ms + 500) / 1000;
+    }
+    return recognised;
+}
+
+bool read_song_metadata(const std::string& path, Song& song) {
+    AudioMetadata metadata;
+    if (!read_audio_metadata(path, metadata)) {
+        return false;
+    }
+    if (!metadata.title.empty()) song.title = metadata.title;
+    if (!metadata.artist.empty()) song.artist = metadata.artist;
+    if (!metadata.album.empty()) song.album = metadata.album;
+    if (metadata.duration_seconds > 0) song.duration_seconds = metadata.duration_seconds;
+    return true;
+}
+
+size_t read_song_metadata_parallel(std::vector<Song>& songs, const std::vector<std::string>& paths,
+                                   unsigned thread_count) {
+    std::atomic<size_t> found(0);
+    size_t count = std::min(songs.size(), paths.size());
+    parallel_for(count, [&](size_t i) {
+        if (read_song_metadata(paths[i], songs[i])) {
+            found.fetch_add(1, std::memory_order_relaxed);
+        }
+    }, thread_count);
+    return found;
+}
@@ -0,0 +1,32 @@
+#ifndef METADATA_READER_H
+#define METADATA_READER_H
+
+#include "Song.h"
+#include <string>
+#include <vector>
+
+struct AudioMetadata {
+    std::string title; // Empty when the file has no tag for it
+    std::string artist;
+    std::string album;
+    int duration_seconds = 0; // 0 when it can't be worked out from headers
+};
+
+// Reads tags and duration from file headers only - no audio is decoded.
+// Understands ID3v2.2-2.4 and ID3v1, FLAC STREAMINFO and Vorbis comments,
+// Ogg Vorbis/Opus headers plus the last page's granule position, MP3
+// Xing/Info/VBRI headers (CBR files fall back to size / bitrate) and WAV.
+// Only a window at the head and one at the tail of the file are mapped.
+// Returns false if the file can't be opened or nothing was recognised.
+bool read_audio_metadata(const std::string& path, AudioMetadata& metadata);
+
+// Overwrites the song's fields with whatever the file's tags provide.
+// Fields the file doesn't have keep their current values.
+bool read_song_metadata(const std::string& path, Song& song);
+
+// Runs read_song_metadata over songs[i] / paths[i] on a pool of threads
+// (0 = one per core). Returns the number of files that had metadata.
+size_t read_song_metadata_parallel(std::vector<Song>& songs, const std::vector<std::string>& paths,
+                                   unsigned thread_count = 0);
+
+#endif // METADATA_READER_H
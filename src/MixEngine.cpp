@@ -0,0 +1,619 @@
+#include "MixEngine.h"
+#include "Logger.h"
+#include "Resampler.h"
+#include <SFML/Audio/SoundStream.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Frames read from a source per decode step
+static const size_t DECODE_FRAMES = 4096;
+// How long a decoder sleeps when its ring is full; the ring holds far more
+static const auto DECODER_BACKOFF = std::chrono::milliseconds(10);
+
+struct MixEngine::Deck {
+    Tag tag;
+    std::unique_ptr<PcmSource> source; // Read by the decoder thread only
+    SpscRing<float> ring; // Stereo frames at OUTPUT_RATE: decoder -> callback
+    uint64_t total_frames; // At OUTPUT_RATE, 0 if unknown
+    std::atomic<float> gain;
+    std::atomic<bool> decoded{false}; // Set after the decoder's last push
+    std::atomic<bool> cancelled{false}; // The callback is done with it: stop decoding
+    std::atomic<bool> taken{false}; // The callback has started it; it releases it when done
+    std::atomic<bool> released{false}; // The callback won't touch it again: free it
+    std::atomic<LatencyHistogram*> first_buffer{nullptr};
+    std::chrono::steady_clock::time_point armed_at; // Published by the release store to first_buffer
+
+    // Control side
+    uint64_t last_command = 0; // The latest command naming it
+    bool dropped = false; // Played or discarded: no longer prepared
+
+    // Callback side
+    uint64_t played = 0;
+    float applied_gain;
+
+    std::thread decoder;
+
+    Deck(std::unique_ptr<PcmSource> pcm, Tag tag, float start_gain)
+        : tag(tag), source(std::move(pcm)), ring(RING_FRAMES * OUTPUT_CHANNELS), gain(start_gain),
+          applied_gain(start_gain) {
+        unsigned rate = source->get_sample_rate();
+        total_frames = rate > 0 ? source->get_frame_count() * OUTPUT_RATE / rate : 0;
+        decoder = std::thread(&Deck::decode, this);
+    }
+
+    ~Deck() {
+        cancelled.store(true);
+        decoder.join();
+    }
+
+    // Pushes frames, waiting while the ring is full; false if cancelled
+    bool push_all(const float* data, size_t frames) {
+        size_t count = frames * OUTPUT_CHANNELS;
+        while (count > 0) {
+            // Whole frames only, so the callback never sees half of one
+            size_t room = ring.write_available() / OUTPUT_CHANNELS * OUTPUT_CHANNELS;
+            size_t pushed = ring.push(data, std::min(room, count));
+            data += pushed;
+            count -= pushed;
+            if (count > 0) {
+                if (cancelled.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                std::this_thread::sleep_for(DECODER_BACKOFF);
+            }
+        }
+        return !cancelled.load(std::memory_order_relaxed);
+    }
+
+    // Decoder thread: source -> float stereo -> Resampler if it isn't at
+    // OUTPUT_RATE already -> ring
+    void decode() {
+        unsigned rate = source->get_sample_rate();
+        unsigned channels = source->get_channel_count();
+        if (rate == 0 || channels == 0) {
+            decoded.store(true, std::memory_order_release);
+            return;
+        }
+        std::unique_ptr<Resampler> resampler;
+        if (rate != OUTPUT_RATE) {
+            resampler = std::make_unique<Resampler>(rate, OUTPUT_RATE);
+        }
+        const float scale = 1.0f / 32768.0f;
+        std::vector<int16_t> input(DECODE_FRAMES * channels);
+        std::vector<float> frames(DECODE_FRAMES * OUTPUT_CHANNELS);
+        std::vector<float> output;
+        while (!cancelled.load(std::memory_order_relaxed)) {
+            size_t count = source->read(input.data(), DECODE_FRAMES);
+            if (count == 0) {
+                break;
+            }
+            // First two channels (front left and right), or mono to both
+            for (size_t i = 0; i < count; ++i) {
+                const int16_t* in = &input[i * channels];
+                frames[i * 2] = in[0] * scale;
+                frames[i * 2 + 1] = (channels > 1 ? in[1] : in[0]) * scale;
+            }
+            if (!resampler) {
+                if (!push_all(frames.data(), count)) {
+                    return;
+                }
+                continue;
+            }
+            output.clear();
+            resampler->process(frames.data(), count, output);
+            if (!push_all(output.data(), output.size() / OUTPUT_CHANNELS)) {
+                return;
+            }
+        }
+        if (resampler && !cancelled.load(std::memory_order_relaxed)) {
+            output.clear();
+            resampler->flush(output);
+            if (!push_all(output.data(), output.size() / OUTPUT_CHANNELS)) {
+                return;
+            }
+        }
+        decoded.store(true, std::memory_order_release);
+    }
+};
+
+// The SFML stream the engine plays through; its onGetData runs on SFML's
+// streaming thread
+class MixEngine::Output : public sf::SoundStream {
+public:
+    explicit Output(MixEngine& engine) : engine(engine), buffer(CHUNK_FRAMES * OUTPUT_CHANNELS) {
+        initialize(OUTPUT_CHANNELS, OUTPUT_RATE);
+    }
+    ~Output() override {
+        stop(); // The streaming thread calls into us, so it must end first
+    }
+
+protected:
+    bool onGetData(Chunk& data) override {
+        engine.render(buffer.data(), CHUNK_FRAMES);
+        data.samples = buffer.data();
+        data.sampleCount = buffer.size();
+        return true; // Silence between tracks rather than ending the stream
+    }
+    void onSeek(sf::Time) override {}
+
+private:
+    MixEngine& engine;
+    std::vector<sf::Int16> buffer;
+};
+
+static float fade_gain(FadeCurve curve, float t) {
+    switch (curve) {
+    case FadeCurve::Linear:
+        return t;
+    case FadeCurve::EqualPower:
+        return std::sin(t * 1.57079632679f);
+    case FadeCurve::SCurve:
+        return t * t * (3.0f - 2.0f * t);
+    }
+    return t;
+}
+
+MixEngine::MixEngine(bool open_output)
+    : commands(1024), events(256), mix_buffer(CHUNK_FRAMES * OUTPUT_CHANNELS),
+      scratch_out(CHUNK_FRAMES * OUTPUT_CHANNELS), scratch_in(CHUNK_FRAMES * OUTPUT_CHANNELS) {
+    std::unique_ptr<Equalizer> eq = std::make_unique<Equalizer>(OUTPUT_RATE);
+    std::unique_ptr<Limiter> lim = std::make_unique<Limiter>(OUTPUT_RATE);
+    equalizer = eq.get();
+    limiter = lim.get();
+    master.add(std::move(eq));
+    master.add(std::move(lim));
+    if (open_output) {
+        output = std::make_unique<Output>(*this);
+    }
+}
+
+MixEngine::~MixEngine() {
+    stop();
+    output.reset();
+}
+
+std::unique_ptr<PcmSource> MixEngine::open_file(const std::string& resolved_path) {
+    std::unique_ptr<PcmReader> reader = std::make_unique<PcmReader>();
+    if (!reader->open(resolved_path)) {
+        return nullptr;
+    }
+    return reader;
+}
+
+// --- Control side ---
+
+MixEngine::Deck* MixEngine::find_prepared(Tag tag) const {
+    for (const std::unique_ptr<Deck>& deck : decks) {
+        if (deck->tag == tag && !deck->dropped) {
+            return deck.get();
+        }
+    }
+    return nullptr;
+}
+
+void MixEngine::send(Command command) {
+    // Every command names its deck, and displaces the queued one
+    uint64_t sequence = sent_commands + 1;
+    for (Deck* deck : {command.deck, queued}) {
+        if (deck) {
+            deck->last_command = sequence;
+        }
+    }
+    while (!commands.push(command)) {
+        if (state == State::Playing) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // The callback drains it within a chunk
+        } else {
+            // Nothing is draining it; a stop makes this side the consumer
+            log_warning() << "Playback commands backed up while paused; stopping playback";
+            stop();
+        }
+    }
+    sent_commands++;
+    if (state == State::Stopped) {
+        apply_commands(); // The callback isn't running, so apply it here
+    }
+}
+
+void MixEngine::prepare(std::unique_ptr<PcmSource> source, Tag tag, float gain) {
+    // Each prepared deck holds a decoder thread and a ring: past the cap
+    // the oldest goes (decks are kept in the order they were prepared)
+    size_t prepared = 0;
+    for (const std::unique_ptr<Deck>& deck : decks) {
+        prepared += !deck->dropped && !deck->taken.load(std::memory_order_acquire);
+    }
+    for (size_t i = 0; prepared >= MAX_PREPARED && i < decks.size(); ++i) {
+        Deck* deck = decks[i].get();
+        if (!deck->dropped && !deck->taken.load(std::memory_order_acquire)) {
+            drop(deck);
+            prepared--;
+        }
+    }
+    reap();
+    decks.push_back(std::make_unique<Deck>(std::move(source), tag, gain));
+}
+
+void MixEngine::discard(Tag tag) {
+    if (Deck* deck = find_prepared(tag)) {
+        drop(deck);
+        reap(); // Straight away while stopped, as nothing else polls then
+    }
+}
+
+void MixEngine::drop(Deck* deck) {
+    if (deck == queued) {
+        send({Command::Unqueue, deck});
+        queued = nullptr;
+    }
+    deck->dropped = true;
+}
+
+bool MixEngine::is_prepared(Tag tag) const {
+    return find_prepared(tag) != nullptr;
+}
+
+bool MixEngine::play(Tag tag, LatencyHistogram* first_buffer) {
+    Deck* deck = find_prepared(tag);
+    if (!deck) {
+        return false;
+    }
+    deck->dropped = true; // The callback's from here on
+    if (deck->taken.load(std::memory_order_acquire)) {
+        // Started from the queue already; its Started event is on the way
+        queued = nullptr;
+        return true;
+    }
+    if (first_buffer) {
+        deck->armed_at = std::chrono::steady_clock::now();
+        deck->first_buffer.store(first_buffer, std::memory_order_release);
+    }
+    send({Command::Cut, deck});
+    queued = nullptr;
+    resume();
+    return true;
+}
+
+void MixEngine::play(std::unique_ptr<PcmSource> source, Tag tag, float gain, LatencyHistogram* first_buffer) {
+    prepare(std::move(source), tag, gain);
+    play(tag, first_buffer);
+}
+
+bool MixEngine::queue(Tag tag) {
+    Deck* deck = find_prepared(tag);
+    if (!deck || deck->taken.load(std::memory_order_acquire)) {
+        return false;
+    }
+    send({Command::Queue, deck, crossfade_frames, crossfade_curve});
+    queued = deck;
+    return true;
+}
+
+void MixEngine::clear_queue() {
+    if (queued) {
+        send({Command::Unqueue, queued});
+        queued = nullptr;
+    }
+}
+
+MixEngine::Tag MixEngine::get_queued() const {
+    return queued ? queued->tag : NO_TAG;
+}
+
+void MixEngine::pause() {
+    if (state == State::Playing) {
+        if (output) {
+            output->pause();
+        }
+        state = State::Paused;
+    }
+}
+
+void MixEngine::resume() {
+    if (state != State::Playing) {
+        if (output) {
+            output->play();
+        }
+        state = State::Playing;
+    }
+}
+
+void MixEngine::stop() {
+    if (output) {
+        output->stop(); // Joins SFML's streaming thread: the callback side is ours now
+    }
+    state = State::Stopped;
+    apply_commands();
+    for (Deck* deck : {playing, fading_in}) {
+        if (deck) {
+            release(deck);
+        }
+    }
+    playing = fading_in = next = nullptr; // Next was never started, so it stays prepared
+    queued = nullptr;
+    current_tag.store(NO_TAG);
+    current_frames.store(0);
+    master.reset(); // Or the limiter's look-ahead would start the next track
+    poll(); // Frees them; their events are of no interest now
+}
+
+void MixEngine::set_crossfade(double seconds, FadeCurve curve) {
+    crossfade_frames = static_cast<size_t>(std::max(0.0, seconds) * OUTPUT_RATE);
+    crossfade_curve = curve;
+}
+
+void MixEngine::insert_master_stage(std::unique_ptr<DspStage> stage) {
+    if (state != State::Stopped) {
+        log_warning() << "DSP stages can only be added while playback is stopped";
+        return;
+    }
+    master.insert(master.size() - 1, std::move(stage)); // The limiter stays last
+}
+
+void MixEngine::set_gain(Tag tag, float gain) {
+    for (const std::unique_ptr<Deck>& deck : decks) {
+        if (deck->tag == tag) {
+            deck->gain.store(gain, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<MixEngine::Event> MixEngine::poll() {
+    std::vector<Event> out;
+    Event event;
+    while (events.pop(event)) {
+        if (event.type == Event::Started && queued && event.tag == queued->tag) {
+            queued->dropped = true; // The callback has taken it
+            queued = nullptr;
+        }
+        out.push_back(event);
+    }
+    reap();
+    return out;
+}
+
+void MixEngine::reap() {
+    // A deck may still be named by a command the callback hasn't read yet,
+    // so it stays until the callback has caught up with that one. Then it
+    // is done once released if the callback started it, or once discarded
+    // if it never did (the callback can't have it as next any more).
+    uint64_t applied = applied_commands.load(std::memory_order_acquire);
+    auto done = [&](const Deck* deck) {
+        if (deck->last_command > applied) {
+            return false;
+        }
+        return deck->taken.load(std::memory_order_acquire) ? deck->released.load(std::memory_order_acquire)
+                                                           : deck->dropped;
+    };
+    if (queued && done(queued)) {
+        queued = nullptr; // Its Started event was lost
+    }
+    decks.erase(std::remove_if(decks.begin(), decks.end(),
+                               [&](const std::unique_ptr<Deck>& deck) { return done(deck.get()); }),
+                decks.end());
+}
+
+bool MixEngine::get_position(Tag& tag, double& seconds) const {
+    tag = current_tag.load(std::memory_order_relaxed);
+    seconds = double(current_frames.load(std::memory_order_relaxed)) / OUTPUT_RATE;
+    return tag != NO_TAG;
+}
+
+MixEngine::Stats MixEngine::get_stats() const {
+    Stats stats;
+    stats.callbacks = callbacks.load(std::memory_order_relaxed);
+    stats.underruns = underruns.load(std::memory_order_relaxed);
+    stats.underrun_frames = underrun_frames.load(std::memory_order_relaxed);
+    stats.transitions = transitions.load(std::memory_order_relaxed);
+    stats.lost_events = lost_events.load(std::memory_order_relaxed);
+    stats.limited_blocks = limiter->get_limited_blocks();
+    return stats;
+}
+
+// --- Callback side: no allocation, locks or waiting from here on ---
+
+size_t MixEngine::render(int16_t* samples, size_t frames) {
+    for (size_t done = 0; done < frames;) {
+        size_t count = std::min(frames - done, CHUNK_FRAMES);
+        mix_chunk(mix_buffer.data(), count);
+        master.process(mix_buffer.data(), count);
+        int16_t* out = samples + done * OUTPUT_CHANNELS;
+        for (size_t i = 0; i < count * OUTPUT_CHANNELS; ++i) {
+            float value = std::max(-1.0f, std::min(1.0f, mix_buffer[i])) * 32767.0f;
+            out[i] = static_cast<int16_t>(std::lrint(value));
+        }
+        done += count;
+    }
+    return frames;
+}
+
+void MixEngine::apply_commands() {
+    Command command;
+    uint64_t applied = applied_commands.load(std::memory_order_relaxed);
+    while (commands.pop(command)) {
+        applied++;
+        switch (command.type) {
+        case Command::Cut: {
+            Deck* deck = command.deck;
+            if (deck->taken.load(std::memory_order_relaxed)) {
+                break; // Started from the queue already, before the control side heard
+            }
+            next = nullptr; // Back to merely prepared
+            if (fading_in) {
+                finish_fade(); // Cut from wherever the fade had got to
+            }
+            if (playing) {
+                start_fade(deck, CUT_FRAMES, FadeCurve::EqualPower);
+            } else {
+                playing = deck;
+                deck->taken.store(true, std::memory_order_release);
+            }
+            current_tag.store(deck->tag, std::memory_order_relaxed);
+            break;
+        }
+        case Command::Queue:
+            if (!command.deck->taken.load(std::memory_order_relaxed)) {
+                next = command.deck; // Any deck queued before stays prepared
+                next_fade_frames = command.fade_frames;
+                next_curve = command.curve;
+            }
+            break;
+        case Command::Unqueue:
+            if (next == command.deck) {
+                next = nullptr;
+            }
+            break;
+        }
+    }
+    // Decks named by these commands may be freed from now on
+    applied_commands.store(applied, std::memory_order_release);
+}
+
+void MixEngine::mix_chunk(float* out, size_t frames) {
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    apply_commands();
+    std::fill(out, out + frames * OUTPUT_CHANNELS, 0.0f);
+    size_t done = 0;
+    while (done < frames && playing) {
+        if (fading_in) {
+            size_t mixed = mix_fade(out + done * OUTPUT_CHANNELS, frames - done);
+            if (mixed == 0 && fading_in) {
+                break; // Underrun; counted in mix_fade
+            }
+            done += mixed;
+            continue;
+        }
+        // Up to where the crossfade into the next track begins
+        size_t wanted = frames - done;
+        if (next && next_fade_frames > 0 && playing->total_frames > 0) {
+            uint64_t fade_start = playing->total_frames > next_fade_frames ? playing->total_frames - next_fade_frames : 0;
+            if (playing->played >= fade_start) {
+                size_t left = static_cast<size_t>(playing->total_frames - std::min(playing->total_frames, playing->played));
+                if (left > 0) {
+                    start_fade(next, std::min<size_t>(next_fade_frames, left), next_curve);
+                    next = nullptr;
+                    transitions.fetch_add(1, std::memory_order_relaxed);
+                    report(Event::Started, fading_in->tag);
+                    continue;
+                }
+            } else {
+                wanted = static_cast<size_t>(std::min<uint64_t>(wanted, fade_start - playing->played));
+            }
+        }
+        size_t got = take(playing, scratch_out.data(), wanted);
+        add_stereo(out + done * OUTPUT_CHANNELS, scratch_out.data(), got);
+        done += got;
+        if (got < wanted) {
+            if (is_exhausted(playing)) {
+                switch_to_next(); // On this very sample
+                continue;
+            }
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            underrun_frames.fetch_add(frames - done, std::memory_order_relaxed);
+            break;
+        }
+    }
+    const Deck* heard = fading_in ? fading_in : playing;
+    current_frames.store(heard ? heard->played : 0, std::memory_order_relaxed);
+}
+
+size_t MixEngine::mix_fade(float* out, size_t frames) {
+    size_t count = std::min(frames, fade_length - fade_pos);
+    size_t got_in = take(fading_in, scratch_in.data(), count);
+    bool in_ended = got_in < count && is_exhausted(fading_in);
+    if (got_in < count && !in_ended) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+        underrun_frames.fetch_add(frames - got_in, std::memory_order_relaxed);
+    }
+    // The outgoing track keeps pace with the incoming one; past its end
+    // (or if its decoder is behind) it is silent
+    size_t got_out = take(playing, scratch_out.data(), got_in);
+    for (size_t i = 0; i < got_in; ++i) {
+        float t = float(fade_pos + i) / float(fade_length);
+        float in_gain = fade_gain(fade_curve, t);
+        float out_gain = fade_gain(fade_curve, 1.0f - t);
+        for (size_t c = 0; c < OUTPUT_CHANNELS; ++c) {
+            float value = scratch_in[i * OUTPUT_CHANNELS + c] * in_gain;
+            if (i < got_out) {
+                value += scratch_out[i * OUTPUT_CHANNELS + c] * out_gain;
+            }
+            out[i * OUTPUT_CHANNELS + c] += value;
+        }
+    }
+    fade_pos += got_in;
+    if (fade_pos >= fade_length || in_ended) {
+        finish_fade();
+        if (in_ended) {
+            switch_to_next(); // A track shorter than the fade
+        }
+    }
+    return got_in;
+}
+
+size_t MixEngine::take(Deck* deck, float* out, size_t frames) {
+    size_t available = deck->ring.read_available() / OUTPUT_CHANNELS;
+    size_t count = deck->ring.pop(out, std::min(frames, available) * OUTPUT_CHANNELS) / OUTPUT_CHANNELS;
+    if (count == 0) {
+        return 0;
+    }
+    if (deck->played == 0 && deck->first_buffer.load(std::memory_order_relaxed)) {
+        if (LatencyHistogram* histogram = deck->first_buffer.exchange(nullptr, std::memory_order_acquire)) {
+            auto elapsed = std::chrono::steady_clock::now() - deck->armed_at;
+            histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+    deck->played += count;
+    // Ramp from the gain last applied to the current one over this block,
+    // so a volume change doesn't click
+    float from = deck->applied_gain;
+    float to = deck->gain.load(std::memory_order_relaxed);
+    if (from != 1.0f || to != 1.0f) {
+        scale_stereo(out, count, from, to);
+        deck->applied_gain = to;
+    }
+    return count;
+}
+
+bool MixEngine::is_exhausted(const Deck* deck) const {
+    // decoded is set after the last push, so once it reads true an empty ring means the end
+    return deck->decoded.load(std::memory_order_acquire) && deck->ring.read_available() == 0;
+}
+
+void MixEngine::start_fade(Deck* incoming, size_t length, FadeCurve curve) {
+    incoming->taken.store(true, std::memory_order_release);
+    fading_in = incoming;
+    fade_pos = 0;
+    fade_length = std::max<size_t>(length, 1);
+    fade_curve = curve;
+}
+
+void MixEngine::finish_fade() {
+    release(playing);
+    playing = fading_in;
+    fading_in = nullptr;
+}
+
+void MixEngine::switch_to_next() {
+    Tag ended = playing->tag;
+    release(playing);
+    playing = next;
+    next = nullptr;
+    if (playing) {
+        playing->taken.store(true, std::memory_order_release);
+        transitions.fetch_add(1, std::memory_order_relaxed);
+        current_tag.store(playing->tag, std::memory_order_relaxed);
+        report(Event::Started, playing->tag);
+    } else {
+        current_tag.store(NO_TAG, std::memory_order_relaxed);
+        report(Event::Finished, ended);
+    }
+}
+
+void MixEngine::release(Deck* deck) {
+    deck->cancelled.store(true, std::memory_order_relaxed);
+    deck->released.store(true, std::memory_order_release);
+}
+
+void MixEngine::report(Event::Type type, Tag tag) {
+    if (!events.push(Event{type, tag})) {
+        lost_events.fetch_add(1, std::memory_order_relaxed);
+    }
+}
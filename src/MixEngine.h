@@ -0,0 +1,192 @@
+#ifndef MIX_ENGINE_H
+#define MIX_ENGINE_H
+
+#include "DspChain.h"
+#include "Equalizer.h"
+#include "LatencyHistogram.h"
+#include "Limiter.h"
+#include "PcmReader.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Gain of the incoming track at fraction t of a crossfade; the outgoing
+// track gets the gain at 1 - t
+enum class FadeCurve {
+    Linear,     // Gains sum to 1: a dip in loudness mid-fade between unrelated tracks
+    EqualPower, // Powers sum to 1: even loudness between unrelated tracks
+    SCurve      // Smoothstep: each track held longer, then a quicker change
+};
+
+// Plays tracks through one output stream that runs from track to track, so
+// the next one can start on the sample after the current one ends
+// (gapless) or fade in over its end (crossfade). Each track is a deck
+// whose decoder thread converts it to float stereo at OUTPUT_RATE and
+// pushes it into the deck's SpscRing. The output callback (SFML's
+// streaming thread) pops from up to two decks and mixes them. It never
+// allocates, locks or waits: playback commands reach it through another
+// ring, and it reports back through a third. If a deck's ring runs dry
+// before the decoder has finished, the callback plays silence in its
+// place and counts an underrun. Decoders convert other sample rates with
+// a polyphase Resampler; the mix then runs through the master DspChain (an
+// Equalizer, any added stages, then a Limiter) before it is output.
+//
+// A track can be prepared well before it is wanted: its deck decodes a
+// ring's worth ahead and waits, so playing it later only hands the deck to
+// the callback. Queuing a prepared track also lets the callback start it
+// by itself at the end of the current one.
+//
+// Control methods are called from one thread at a time (the playlist's,
+// under its lock). Decks stay owned by that side and are freed (in poll(),
+// prepare() or discard()) once the callback has let go of them (or the
+// caller discarded them unplayed) and the callback has applied every
+// command that names them.
+class MixEngine {
+public:
+    using Tag = uint64_t; // The caller's name for a track, reported back in events
+    static constexpr Tag NO_TAG = ~Tag(0);
+    static constexpr unsigned OUTPUT_RATE = 44100;
+    static constexpr unsigned OUTPUT_CHANNELS = 2;
+    static constexpr size_t CHUNK_FRAMES = 2048; // Mixed per callback, ~46 ms
+    static constexpr size_t RING_FRAMES = 65536; // Decoded ahead per deck, ~1.5 s
+    static constexpr size_t CUT_FRAMES = OUTPUT_RATE / 100; // play() fades the old track out over 10 ms
+    static constexpr size_t MAX_PREPARED = 4; // prepare() discards the oldest prepared track past this
+
+    struct Event {
+        enum Type {
+            Started, // A queued track took over (on its first sample, or as its crossfade began)
+            Finished // The last track ended with nothing queued
+        } type;
+        Tag tag;
+    };
+
+    struct Stats {
+        uint64_t callbacks = 0; // Chunks mixed
+        uint64_t underruns = 0; // Chunks in which a deck's decoder hadn't kept up
+        uint64_t underrun_frames = 0; // Frames of silence played in their place
+        uint64_t transitions = 0; // Queued tracks started, gapless or crossfaded
+        uint64_t lost_events = 0; // Events dropped because poll() wasn't keeping up
+        uint64_t limited_blocks = 0; // Limiter blocks that had to be turned down
+    };
+
+    // Without an output, nothing plays until render() is called (benchmarks)
+    explicit MixEngine(bool open_output = true);
+    ~MixEngine();
+    MixEngine(const MixEngine&) = delete;
+    MixEngine& operator=(const MixEngine&) = delete;
+
+    static std::unique_ptr<PcmSource> open_file(const std::string& resolved_path); // nullptr if it can't be decoded
+
+    // Starts decoding source into a deck of its own, to be played or
+    // queued by tag later; it is kept until then, until discard(), or until
+    // MAX_PREPARED newer tracks have been prepared
+    void prepare(std::unique_ptr<PcmSource> source, Tag tag, float gain);
+    void discard(Tag tag); // Drops a prepared track, unqueuing it first; freed now if the callback allows
+    bool is_prepared(Tag tag) const;
+
+    // Plays the prepared track now: what was playing fades out over
+    // CUT_FRAMES, and the queue is cleared. first_buffer, if given, records
+    // how long it took the callback to get the first decoded audio. False
+    // if no such track is prepared.
+    bool play(Tag tag, LatencyHistogram* first_buffer = nullptr);
+    void play(std::unique_ptr<PcmSource> source, Tag tag, float gain, LatencyHistogram* first_buffer = nullptr);
+    // The prepared track to follow the current one, replacing any queued
+    // before: it starts when the current one ends, or crossfades in over
+    // its end with the crossfade set now. False if no such track is prepared.
+    bool queue(Tag tag);
+    void clear_queue(); // The queued track stays prepared
+    Tag get_queued() const;
+
+    void pause();
+    void resume();
+    void stop(); // Drops the tracks playing; prepared ones are kept
+    bool is_playing() const { return state == State::Playing; }
+    bool is_paused() const { return state == State::Paused; }
+
+    void set_crossfade(double seconds, FadeCurve curve); // 0 for gapless
+    double get_crossfade() const { return double(crossfade_frames) / OUTPUT_RATE; }
+    FadeCurve get_fade_curve() const { return crossfade_curve; }
+    void set_gain(Tag tag, float gain); // Linear; ramped in over one chunk
+    // The master chain's stages; their settings can change during playback
+    Equalizer& get_equalizer() { return *equalizer; }
+    Limiter& get_limiter() { return *limiter; }
+    void insert_master_stage(std::unique_ptr<DspStage> stage); // Before the limiter; only while stopped
+
+    std::vector<Event> poll(); // Events since the last call; frees decks the callback is done with
+    // The track being heard (the incoming one during a crossfade) and how
+    // far into it the mixer is; false if none
+    bool get_position(Tag& tag, double& seconds) const;
+    Stats get_stats() const;
+
+    // Mixes the next frames into samples (interleaved stereo): what the
+    // output callback calls. Returns frames.
+    size_t render(int16_t* samples, size_t frames);
+
+private:
+    struct Deck;
+    class Output;
+
+    struct Command {
+        enum Type { Cut, Queue, Unqueue } type;
+        Deck* deck; // For Unqueue, the deck unqueued
+        size_t fade_frames = 0; // Queue: crossfade into it; 0 for gapless
+        FadeCurve curve = FadeCurve::EqualPower;
+    };
+
+    enum class State { Stopped, Playing, Paused };
+
+    // Control side
+    std::vector<std::unique_ptr<Deck>> decks; // Every deck not yet freed
+    Deck* queued = nullptr; // As last sent to the callback
+    uint64_t sent_commands = 0;
+    size_t crossfade_frames = 0;
+    FadeCurve crossfade_curve = FadeCurve::EqualPower;
+    State state = State::Stopped;
+    std::unique_ptr<Output> output;
+
+    SpscRing<Command> commands; // Control -> callback
+    SpscRing<Event> events; // Callback -> control
+
+    // Callback side (or the control side while stopped)
+    Deck* playing = nullptr;
+    Deck* fading_in = nullptr; // Set during a crossfade; playing is fading out
+    Deck* next = nullptr;
+    size_t next_fade_frames = 0; // From its Queue command
+    FadeCurve next_curve = FadeCurve::EqualPower;
+    size_t fade_pos = 0;
+    size_t fade_length = 0;
+    FadeCurve fade_curve = FadeCurve::EqualPower;
+    std::vector<float> mix_buffer, scratch_out, scratch_in; // CHUNK_FRAMES stereo each
+    DspChain master;
+    Equalizer* equalizer; // Owned by master
+    Limiter* limiter;
+
+    // Written by the callback, read by the control side
+    std::atomic<uint64_t> applied_commands{0}; // Commands the callback is done with
+    std::atomic<Tag> current_tag{NO_TAG};
+    std::atomic<uint64_t> current_frames{0};
+    std::atomic<uint64_t> callbacks{0}, underruns{0}, underrun_frames{0}, transitions{0}, lost_events{0};
+
+    Deck* find_prepared(Tag tag) const; // nullptr if none
+    void send(Command command);
+    void drop(Deck* deck); // Unqueues it and marks it discarded
+    void reap(); // Frees decks the callback is done with
+
+    void apply_commands();
+    void mix_chunk(float* out, size_t frames);
+    size_t mix_fade(float* out, size_t frames);
+    size_t take(Deck* deck, float* out, size_t frames); // Pops and applies the deck's gain
+    bool is_exhausted(const Deck* deck) const;
+    void start_fade(Deck* incoming, size_t length, FadeCurve curve);
+    void finish_fade();
+    void switch_to_next(); // Gapless, at the end of playing
+    void release(Deck* deck);
+    void report(Event::Type type, Tag tag);
+};
+
+#endif // MIX_ENGINE_H
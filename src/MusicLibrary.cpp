@@ -1,84 +1,426 @@
 #include "MusicLibrary.h"
+#include "AssetResolver.h"
+#include "DirectoryScanner.h"
+#include "DuplicateFinder.h"
+#include "LibraryIndex.h"
+#include "Logger.h"
+#include "MetadataReader.h"
+#include "ParallelFor.h"
+#include "PcmReader.h"
 #include <iostream>
 #include <algorithm>
 #include <cctype>
 #include <vector>
 #include <fstream>
+#include <mutex>
+#include <unordered_set>
 #ifdef _WIN32
     #include <windows.h>
     #include <fileapi.h>
-#else
-    #include <dirent.h>
-    #include <sys/stat.h>
 #endif
 
-MusicLibrary::MusicLibrary() {}
+MusicLibrary::MusicLibrary()
+    : title_index(songs), search_index(songs), by_title(songs, SortField::Title), by_artist(songs, SortField::Artist),
+      by_album(songs, SortField::Album), by_path(songs, SortField::Path), published_version(0) {}
+
+SongId MusicLibrary::insert_song(const Song& song, const FileStamp& stamp) {
+    SongId id = songs.push_back(song);
+    songs_changed = true;
+    title_index.insert(id);
+    search_index.insert(id);
+    unsorted.push_back(id); // Sorted in with the rest of its batch
+    stamps.push_back(stamp);
+    if (!song.file_path.empty()) {
+        path_index.emplace(song.file_path, id);
+    }
+    return id;
+}
+
+void MusicLibrary::replace_song(SongId id, const Song& song, const FileStamp& stamp) {
+    // The title may have changed, so re-key the index around the update
+    title_index.erase(id);
+    search_index.erase(id);
+    for (SortedIndex* index : {&by_title, &by_artist, &by_album, &by_path}) {
+        index->erase(id);
+    }
+    songs.edit(id) = song;
+    songs_changed = order_changed = true;
+    title_index.insert(id);
+    search_index.insert(id);
+    unsorted.push_back(id);
+    stamps[id] = stamp;
+}
+
+void MusicLibrary::remove_song_by_id(SongId id) {
+    title_index.erase(id);
+    search_index.erase(id);
+    path_index.erase(songs[id].file_path);
+    for (SortedIndex* index : {&by_title, &by_artist, &by_album, &by_path}) {
+        index->erase(id);
+    }
+    // The record stays in place, so IDs don't shift
+    songs.mark_removed(id);
+    songs_changed = order_changed = true;
+}
 
-size_t MusicLibrary::hash_function(const std::string& title) {
-    size_t hash = 0;
-    for (char c : title) {
-        hash += c;
+void MusicLibrary::sort_new_songs() {
+    if (unsorted.empty()) {
+        return;
     }
-    return hash % TABLE_SIZE;
+    // A song may be listed twice (added, then changed) or removed since
+    std::sort(unsorted.begin(), unsorted.end());
+    unsorted.erase(std::unique(unsorted.begin(), unsorted.end()), unsorted.end());
+    unsorted.erase(std::remove_if(unsorted.begin(), unsorted.end(), [this](SongId id) { return !songs.is_live(id); }),
+                   unsorted.end());
+    SortedIndex* indexes[] = {&by_title, &by_artist, &by_album, &by_path};
+    // Big batches sort the four indexes on their own threads
+    const size_t parallel_batch = 4096;
+    parallel_for(4, [&](size_t i) { indexes[i]->insert_batch(unsorted); }, unsorted.size() >= parallel_batch ? 4 : 1);
+    unsorted.clear();
+    order_changed = true;
+}
+
+const SortedIndex& MusicLibrary::sorted_index(SortField field) const {
+    switch (field) {
+    case SortField::Artist:
+        return by_artist;
+    case SortField::Album:
+        return by_album;
+    case SortField::Path:
+        return by_path;
+    default:
+        return by_title;
+    }
+}
+
+std::vector<SongId> MusicLibrary::list_sorted(SortField field, std::string_view prefix, size_t offset, size_t count,
+                                              size_t& total) const {
+    const SortedIndex& index = sorted_index(field);
+    size_t begin = 0, end = index.size();
+    if (!prefix.empty()) {
+        index.prefix_range(prefix, begin, end);
+    }
+    total = end - begin;
+    if (offset >= total) {
+        return {};
+    }
+    return index.range(begin + offset, begin + offset + std::min(count, total - offset));
 }
 
 void MusicLibrary::add_song(const Song& song) {
-    size_t index = hash_function(song.title);
-    table[index].push_back(song);
-    std::cout << "Added '" << song.title << "' to the music library." << std::endl;
+    insert_song(song, FileStamp());
+    sort_new_songs();
+    log_info() << "Added '" << song.title << "' to the music library.";
 }
 
-Song* MusicLibrary::find_song(const std::string& title) {
-    size_t index = hash_function(title);
-    for (Song& song : table[index]) {
-        if (song.title == title) {
-            return &song;
+std::vector<PooledPath> MusicLibrary::all_files() const {
+    std::vector<PooledPath> files;
+    for (SongId id = 0; id < songs.id_limit(); ++id) {
+        if (songs.is_live(id) && !songs[id].file_path.empty()) {
+            files.push_back(songs[id].file_path);
         }
     }
-    return nullptr;
+    return files;
 }
 
-int MusicLibrary::get_song_count() const {
-    int count = 0;
-    for (int i = 0; i < TABLE_SIZE; ++i) {
-        count += table[i].size();
+std::vector<PooledPath> MusicLibrary::unanalysed_files() const {
+    std::vector<PooledPath> files;
+    for (SongId id = 0; id < songs.id_limit(); ++id) {
+        if (songs.is_live(id) && !songs[id].has_loudness() && !songs[id].file_path.empty()) {
+            files.push_back(songs[id].file_path);
+        }
     }
-    return count;
+    return files;
 }
 
-Song* MusicLibrary::get_song_by_index(int index) {
-    // Convert 1-based index to 0-based
-    int zero_based_index = index - 1;
-    if (zero_based_index < 0) {
-        return nullptr;
+void MusicLibrary::apply_loudness(const std::vector<LoudnessResult>& results) {
+    for (const LoudnessResult& result : results) {
+        auto it = path_index.find(result.file_path);
+        if (it != path_index.end()) {
+            Song& song = songs.edit(it->second);
+            song.loudness_lufs = result.loudness_lufs;
+            song.true_peak_dbtp = result.true_peak_dbtp;
+            songs_changed = true;
+        }
     }
-    
-    int current_index = 0;
-    for (int i = 0; i < TABLE_SIZE; ++i) {
-        for (Song& song : table[i]) {
-            if (current_index == zero_based_index) {
-                return &song;
+}
+
+// Fingerprints one file; false if it can't be decoded
+static bool fingerprint_file(const std::string& resolved_path, std::vector<Landmark>& landmarks) {
+    static const size_t CHUNK_FRAMES = 8192;
+    PcmReader reader;
+    if (!reader.open(resolved_path, PcmReader::Use::Background)) {
+        return false;
+    }
+    unsigned channels = reader.get_channel_count();
+    Fingerprinter fingerprinter(reader.get_sample_rate(), channels);
+    std::vector<int16_t> samples(CHUNK_FRAMES * channels);
+    while (size_t frames = reader.read(samples.data(), CHUNK_FRAMES)) {
+        fingerprinter.add_frames(samples.data(), frames);
+    }
+    landmarks = fingerprinter.finish();
+    return true;
+}
+
+std::vector<std::vector<SongId>> MusicLibrary::find_duplicate_recordings() {
+    // One track per distinct file; songs sharing a file are duplicates anyway
+    std::vector<PooledPath> files;
+    std::unordered_map<PooledPath, std::vector<SongId>, PooledPath::Hash> songs_by_file;
+    for (SongId id = 0; id < songs.id_limit(); ++id) {
+        if (songs.is_live(id) && !songs[id].file_path.empty()) {
+            std::vector<SongId>& ids = songs_by_file[songs[id].file_path];
+            if (ids.empty()) {
+                files.push_back(songs[id].file_path);
+            }
+            ids.push_back(id);
+        }
+    }
+
+    std::vector<const std::vector<Landmark>*> landmarks(files.size(), nullptr);
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < files.size(); ++i) {
+        auto it = fingerprints.find(files[i]);
+        if (it != fingerprints.end() && it->second.stamp == stamps[songs_by_file[files[i]].front()]) {
+            landmarks[i] = &it->second.landmarks;
+        } else {
+            missing.push_back(i);
+        }
+    }
+    if (!missing.empty()) {
+        log_info() << "Fingerprinting " << missing.size() << " file(s)...";
+        std::vector<std::vector<Landmark>> computed(missing.size());
+        std::vector<char> decoded(missing.size(), 0);
+        parallel_for(missing.size(), [&](size_t m) {
+            std::string resolved = AssetResolver::instance().resolve(files[missing[m]]);
+            decoded[m] = fingerprint_file(resolved, computed[m]);
+        });
+        size_t failed = 0;
+        for (size_t m = 0; m < missing.size(); ++m) {
+            const PooledPath& file_path = files[missing[m]];
+            if (!decoded[m]) {
+                failed++;
+                continue;
             }
-            current_index++;
+            StoredFingerprint& stored = fingerprints[file_path];
+            stored.stamp = stamps[songs_by_file[file_path].front()];
+            stored.landmarks = std::move(computed[m]);
+            landmarks[missing[m]] = &stored.landmarks; // Map elements don't move on rehash
         }
+        if (failed > 0) {
+            log_warning() << "Could not decode " << failed << " file(s) for fingerprinting";
+        }
+    }
+
+    DuplicateFinder finder;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (landmarks[i]) {
+            finder.add(static_cast<uint32_t>(i), *landmarks[i]);
+        }
+    }
+    std::vector<DuplicateFinder::Match> matches = finder.find();
+
+    // Recording groups, widened to every song of each file
+    std::vector<std::vector<SongId>> groups;
+    std::vector<char> grouped(files.size(), 0);
+    for (const std::vector<uint32_t>& tracks : DuplicateFinder::group(matches)) {
+        std::vector<SongId> ids;
+        for (uint32_t track : tracks) {
+            const std::vector<SongId>& file_songs = songs_by_file[files[track]];
+            ids.insert(ids.end(), file_songs.begin(), file_songs.end());
+            grouped[track] = 1;
+        }
+        std::sort(ids.begin(), ids.end());
+        groups.push_back(std::move(ids));
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        const std::vector<SongId>& file_songs = songs_by_file[files[i]];
+        if (!grouped[i] && file_songs.size() > 1) {
+            groups.push_back(file_songs);
+        }
+    }
+    std::sort(groups.begin(), groups.end());
+    return groups;
+}
+
+void MusicLibrary::add_songs(const std::vector<Song>& batch) {
+    title_index.reserve(title_index.size() + batch.size());
+    for (const Song& song : batch) {
+        insert_song(song, FileStamp());
+    }
+    sort_new_songs();
+}
+
+const Song* MusicLibrary::get_song(SongId id) const {
+    return songs.is_live(id) ? &songs[id] : nullptr;
+}
+
+const Song* MusicLibrary::find_song(std::string_view title) const {
+    SongId id = title_index.find(title);
+    return id != INVALID_SONG_ID ? &songs[id] : nullptr;
+}
+
+const Song* MusicLibrary::find_song_normalized(std::string_view title) const {
+    SongId id = search_index.find_normalized_title(title);
+    return id != INVALID_SONG_ID ? &songs[id] : nullptr;
+}
+
+const Song* MusicLibrary::find_song_fuzzy(std::string_view title) const {
+    SongId id = search_index.find_closest_title(title);
+    return id != INVALID_SONG_ID ? &songs[id] : nullptr;
+}
+
+std::vector<SongId> MusicLibrary::search(std::string_view query, size_t limit) const {
+    std::vector<SongId> ids;
+    for (const SearchIndex::Result& result : search_index.search(query, limit)) {
+        ids.push_back(result.id);
     }
-    return nullptr;
+    return ids;
+}
+
+bool MusicLibrary::remove_song(const std::string& title) {
+    SongId id = title_index.find(title);
+    if (id == INVALID_SONG_ID) {
+        return false;
+    }
+    remove_song_by_id(id);
+    return true;
+}
+
+int MusicLibrary::get_song_count() const {
+    return static_cast<int>(songs.size());
+}
+
+const Song* MusicLibrary::get_song_by_index(int index) const {
+    // Song numbers are IDs + 1, so they don't shift as the library grows
+    if (index < 1) {
+        return nullptr;
+    }
+    return get_song(static_cast<SongId>(index - 1));
 }
 
 void MusicLibrary::list_all_songs() {
+    Logger::instance().flush(); // Queued messages go first
     std::cout << "--- Music Library ---" << std::endl;
-    int song_number = 1;
-    for (int i = 0; i < TABLE_SIZE; ++i) {
-        for (const Song& song : table[i]) {
-            std::cout << song_number << ". " << song.title << " by " << song.artist << std::endl;
-            song_number++;
+    // Format a whole chunk at a time and hand it to the stream in one write
+    std::string block;
+    SongId id = 0;
+    for (size_t chunk = 0; chunk < songs.chunk_count(); ++chunk) {
+        const Song* data = songs.chunk_data(chunk);
+        size_t length = songs.chunk_length(chunk);
+        block.clear();
+        for (size_t i = 0; i < length; ++i, ++id) {
+            if (!songs.is_live(id)) {
+                continue;
+            }
+            block += std::to_string(id + 1);
+            block += ". ";
+            block += data[i].title;
+            block += " by ";
+            block += data[i].artist;
+            block += '\n';
         }
+        std::cout.write(block.data(), block.size());
     }
     std::cout << "---------------------" << std::endl;
 }
 
+bool MusicLibrary::load_index(const std::string& index_path) {
+    LibraryIndex index;
+    if (!index.open(index_path)) {
+        return false;
+    }
+
+    size_t count = index.size();
+    if (songs.id_limit() == 0) {
+        // Fresh library: record N becomes ID N, so the saved indexes can be
+        // taken over instead of rebuilt. Only the songs' strings are
+        // interned (hashed into the pool); each index is checked as it is
+        // adopted and rebuilt from the songs if it doesn't fit them.
+        stamps.reserve(count);
+        path_index.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            Song song = index.song(i);
+            songs.push_back(song);
+            stamps.push_back(index.stamp(i));
+            if (!song.file_path.empty()) {
+                path_index.emplace(song.file_path, static_cast<SongId>(i));
+            }
+        }
+        std::vector<SongId> ids(count);
+        for (size_t i = 0; i < count; ++i) {
+            ids[i] = static_cast<SongId>(i);
+        }
+        SortedIndex* indexes[] = {&by_title, &by_artist, &by_album, &by_path};
+        // The indexes are independent, so each is checked (or rebuilt) on a thread of its own
+        parallel_for(LibraryIndex::ORDER_COUNT + 2, [&](size_t i) {
+            if (i < LibraryIndex::ORDER_COUNT) {
+                SortField field = static_cast<SortField>(i);
+                if (!indexes[i]->adopt(index.order(field), count)) {
+                    indexes[i]->insert_batch(ids);
+                }
+            } else if (i == LibraryIndex::ORDER_COUNT) {
+                if (!title_index.adopt(index.title_table(), index.title_table_capacity(), count)) {
+                    title_index.reserve(count);
+                    for (SongId id : ids) {
+                        title_index.insert(id);
+                    }
+                }
+            } else if (!search_index.adopt(index.search_index())) {
+                for (SongId id : ids) {
+                    search_index.insert(id);
+                }
+            }
+        }, count >= 4096 ? 0 : 1);
+        songs_changed = order_changed = true;
+    } else {
+        title_index.reserve(title_index.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            Song song = index.song(i);
+            if (song.file_path.empty() || path_index.find(song.file_path) == path_index.end()) {
+                insert_song(song, index.stamp(i));
+            }
+        }
+        sort_new_songs();
+    }
+
+    log_info() << "Loaded " << count << " song(s) from library index " << index_path;
+    return true;
+}
+
+bool MusicLibrary::save_index(const std::string& index_path) {
+    sort_new_songs(); // The saved orders must hold every song
+    // Records are the live songs in ID order, so renumbering keeps every
+    // index's order
+    std::vector<const Song*> live_songs;
+    std::vector<FileStamp> live_stamps;
+    std::vector<SongId> record_of(songs.id_limit(), INVALID_SONG_ID);
+    live_songs.reserve(songs.size());
+    live_stamps.reserve(songs.size());
+    for (SongId id = 0; id < songs.id_limit(); ++id) {
+        if (songs.is_live(id)) {
+            record_of[id] = static_cast<SongId>(live_songs.size());
+            live_songs.push_back(&songs[id]);
+            live_stamps.push_back(stamps[id]);
+        }
+    }
+    LibraryIndex::Orders orders;
+    for (size_t i = 0; i < LibraryIndex::ORDER_COUNT; ++i) {
+        const SortedIndex& sorted = sorted_index(static_cast<SortField>(i));
+        std::vector<SongId> ids = sorted.range(0, sorted.size());
+        for (SongId& id : ids) {
+            id = record_of[id];
+        }
+        orders[i] = std::move(ids);
+    }
+    if (!LibraryIndex::write(index_path, live_songs, live_stamps, orders, search_index.flatten(record_of))) {
+        log_error() << "Error: Could not write library index: " << index_path;
+        return false;
+    }
+    return true;
+}
+
 // Helper function to check if a file has an audio extension
-static bool is_audio_file(const std::string& filename) {
+bool MusicLibrary::is_audio_file(const std::string& filename) {
     std::string lower_filename = filename;
     std::transform(lower_filename.begin(), lower_filename.end(), lower_filename.begin(),
                    [](unsigned char c) { return std::tolower(c); });
@@ -107,35 +449,97 @@ static std::string extract_title_from_filename(const std::string& filename) {
     return stem;
 }
 
+// Song::file_path prefix of the files under a directory passed to
+// load_songs_from_directory: '/' separated, with a trailing '/'
+static std::string library_prefix(const std::string& directory_path) {
+    std::string prefix = directory_path;
+    std::replace(prefix.begin(), prefix.end(), '\\', '/');
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += "/";
+    }
+    return prefix;
+}
+
+struct MusicLibrary::ScanSession {
+    std::string path_prefix; // Turns a scanned relative path into Song::file_path
+    std::string open_prefix; // Turns a scanned relative path into something we can open
+    std::mutex mutex; // Guards the library while workers merge batches
+    std::vector<uint8_t> seen; // Songs that existed before the scan and were found again
+    size_t added = 0;
+    size_t updated = 0;
+    size_t unchanged = 0;
+};
+
+void MusicLibrary::merge_scan_batch(ScanSession& session, std::vector<ScannedFile>& batch) {
+    // Decide under the lock which files are new or changed, read their tags
+    // without it, then apply the results under the lock again
+    std::vector<size_t> changed;
+    std::vector<SongId> targets; // INVALID_SONG_ID for files not in the library yet
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // A path the pool has never seen can't be in the library
+            PooledPath path;
+            bool known = PooledPath::find(session.path_prefix + batch[i].relative_path, path);
+            auto it = known ? path_index.find(path) : path_index.end();
+            if (it == path_index.end()) {
+                changed.push_back(i);
+                targets.push_back(INVALID_SONG_ID);
+                continue;
+            }
+            SongId id = it->second;
+            if (id < session.seen.size()) {
+                session.seen[id] = 1;
+            }
+            if (stamps[id] == batch[i].stamp) {
+                session.unchanged++;
+            } else {
+                changed.push_back(i);
+                targets.push_back(id);
+            }
+        }
+    }
+    if (changed.empty()) {
+        return;
+    }
+
+    std::vector<Song> new_songs(changed.size());
+    for (size_t k = 0; k < changed.size(); ++k) {
+        const ScannedFile& file = batch[changed[k]];
+        Song& new_song = new_songs[k];
+        new_song.title = extract_title_from_filename(file.filename);
+        new_song.artist = "Unknown Artist";
+        new_song.album = "Unknown Album";
+        new_song.duration_seconds = 0;
+        new_song.file_path = session.path_prefix + file.relative_path;
+        read_song_metadata(session.open_prefix + file.relative_path, new_song);
+    }
+
+    std::lock_guard<std::mutex> lock(session.mutex);
+    title_index.reserve(title_index.size() + new_songs.size());
+    for (size_t k = 0; k < changed.size(); ++k) {
+        const FileStamp& stamp = batch[changed[k]].stamp;
+        if (targets[k] == INVALID_SONG_ID) {
+            insert_song(new_songs[k], stamp);
+            session.added++;
+        } else {
+            replace_song(targets[k], new_songs[k], stamp);
+            session.updated++;
+        }
+    }
+}
+
 int MusicLibrary::load_songs_from_directory(const std::string& directory_path) {
     int loaded_count = 0;
+    ScanSession session;
+    session.path_prefix = library_prefix(directory_path);
+    session.seen.assign(songs.id_limit(), 0);
     
 #ifdef _WIN32
     // Use Windows API to avoid filesystem DLL issues
-    std::string search_path = directory_path;
-    
-    // Try multiple path locations
-    std::vector<std::string> paths_to_try = {
-        directory_path,
-        ".\\" + directory_path,
-        "..\\" + directory_path,
-        "..\\..\\" + directory_path
-    };
-    
-    std::string resolved_path;
-    bool found = false;
-    
-    for (const auto& path : paths_to_try) {
-        DWORD attrs = GetFileAttributesA(path.c_str());
-        if (attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_DIRECTORY)) {
-            resolved_path = path;
-            found = true;
-            break;
-        }
-    }
-    
-    if (!found) {
-        std::cerr << "Error: Could not find directory: " << directory_path << std::endl;
+    std::string resolved_path = AssetResolver::instance().find_directory(directory_path);
+    if (resolved_path.empty()) {
+        log_error() << "Error: Could not find directory: " << directory_path;
         return 0;
     }
     
@@ -144,15 +548,18 @@ int MusicLibrary::load_songs_from_directory(const std::string& directory_path) {
     if (search_pattern.back() != '\\' && search_pattern.back() != '/') {
         search_pattern += "\\";
     }
+    session.open_prefix = search_pattern;
     search_pattern += "*.*";
     
-    std::cout << "Scanning directory: " << resolved_path << std::endl;
+    log_info() << "Scanning directory: " << resolved_path;
+    
+    std::vector<ScannedFile> files;
     
     WIN32_FIND_DATAA find_data;
     HANDLE find_handle = FindFirstFileA(search_pattern.c_str(), &find_data);
     
     if (find_handle == INVALID_HANDLE_VALUE) {
-        std::cerr << "Error: Could not open directory: " << resolved_path << std::endl;
+        log_error() << "Error: Could not open directory: " << resolved_path;
         return 0;
     }
     
@@ -168,23 +575,15 @@ int MusicLibrary::load_songs_from_directory(const std::string& directory_path) {
             
             // Check if it's an audio file
             if (is_audio_file(filename)) {
-                // Extract title from filename
-                std::string title = extract_title_from_filename(filename);
-                
-                // Create a Song object
-                Song new_song;
-                new_song.title = title;
-                new_song.artist = "Unknown Artist";
-                new_song.album = "Unknown Album";
-                new_song.duration_seconds = 0;
-                
-                // Use relative path
-                std::string relative_path = directory_path + "/" + filename;
-                std::replace(relative_path.begin(), relative_path.end(), '\\', '/');
-                new_song.file_path = relative_path;
-                
-                // Add to library
-                add_song(new_song);
+                ScannedFile file;
+                file.relative_path = filename;
+                file.filename = filename;
+                // Only compared for equality, so the FILETIME epoch doesn't matter
+                uint64_t ticks = (uint64_t(find_data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                 find_data.ftLastWriteTime.dwLowDateTime;
+                file.stamp.mtime_ns = static_cast<int64_t>(ticks * 100);
+                file.stamp.size = (uint64_t(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
+                files.push_back(file);
                 loaded_count++;
             }
         }
@@ -192,17 +591,257 @@ int MusicLibrary::load_songs_from_directory(const std::string& directory_path) {
     
     FindClose(find_handle);
     
+    // Read tags for new and changed files on all cores, in small batches
+    const size_t batch_size = 64;
+    size_t batch_count = (files.size() + batch_size - 1) / batch_size;
+    parallel_for(batch_count, [&](size_t b) {
+        size_t begin = b * batch_size;
+        size_t end = std::min(files.size(), begin + batch_size);
+        std::vector<ScannedFile> batch(files.begin() + begin, files.begin() + end);
+        merge_scan_batch(session, batch);
+    });
+#else
+    std::string resolved_path = AssetResolver::instance().find_directory(directory_path);
+    if (resolved_path.empty()) {
+        log_error() << "Error: Could not find directory: " << directory_path;
+        return 0;
+    }
+
+    log_info() << "Scanning directory: " << resolved_path;
+    session.open_prefix = resolved_path + "/";
+
+    // Workers check stamps, read tags for new/changed files and merge their
+    // batches themselves; only the library updates are serialized
+    DirectoryScanner scanner(0, 512, true);
+    ScanStats stats;
+    bool scanned = scanner.scan(resolved_path, is_audio_file,
+        [&](std::vector<ScannedFile>& batch) { merge_scan_batch(session, batch); }, stats);
+
+    if (!scanned) {
+        log_error() << "Error: Could not open directory: " << resolved_path;
+        return 0;
+    }
+
+    loaded_count = static_cast<int>(stats.matched);
+    log_info() << "Scanned " << stats.entries << " entries in " << stats.directories << " directories in "
+               << stats.seconds << " s (" << static_cast<size_t>(stats.entries_per_second()) << " files/sec, "
+               << scanner.get_thread_count() << " threads)";
+    // Directories that couldn't be read completely may still hold songs
+    // the scan didn't see; those are kept
+    std::vector<std::string> unread_prefixes;
+    for (const std::string& directory : stats.incomplete) {
+        unread_prefixes.push_back(directory.empty() ? session.path_prefix : session.path_prefix + directory + "/");
+    }
+    if (stats.errors > 0) {
+        log_warning() << "Warning: " << stats.errors << " director" << (stats.errors == 1 ? "y" : "ies")
+                      << " could not be read; keeping the songs already listed under them";
+    }
+#endif
+
+    // Songs that came from this directory before but weren't found again
+    size_t removed = 0;
+    size_t kept = 0;
+    for (SongId id = 0; id < session.seen.size(); ++id) {
+        if (songs.is_live(id) && !session.seen[id] && stamps[id] != FileStamp() &&
+            songs[id].file_path.starts_with(session.path_prefix)) {
+#ifndef _WIN32
+            const PooledPath& path = songs[id].file_path;
+            if (std::any_of(unread_prefixes.begin(), unread_prefixes.end(),
+                            [&](const std::string& prefix) { return path.starts_with(prefix); })) {
+                kept++;
+                continue;
+            }
+#endif
+            remove_song_by_id(id);
+            removed++;
+        }
+    }
+    if (kept > 0) {
+        log_info() << "Kept " << kept << " song(s) not found in directories that could not be read";
+    }
+    sort_new_songs();
+    // Files may have moved since their locations were remembered
+    AssetResolver::instance().clear();
+
     if (loaded_count > 0) {
-        std::cout << "Successfully loaded " << loaded_count << " song(s) from " << resolved_path << std::endl;
+        log_info() << "Successfully loaded " << loaded_count << " song(s) from " << resolved_path
+                   << " (" << session.added << " new, " << session.updated << " changed, "
+                   << session.unchanged << " unchanged, " << removed << " removed)";
     } else {
-        std::cout << "No audio files found in " << resolved_path << std::endl;
-        std::cout << "Supported formats: .mp3, .ogg, .wav, .flac, .m4a, .aac" << std::endl;
+        log_info() << "No audio files found in " << resolved_path;
+        log_info() << "Supported formats: .mp3, .ogg, .wav, .flac, .m4a, .aac";
     }
-#else
-    // POSIX implementation would go here
-    std::cerr << "Non-Windows platform not yet supported" << std::endl;
-    return 0;
-#endif
     
     return loaded_count;
 }
+
+void MusicLibrary::move_song_file(SongId id, const PooledPath& file_path) {
+    auto taken = path_index.find(file_path);
+    if (taken != path_index.end() && taken->second != id) {
+        remove_song_by_id(taken->second); // Renamed over another file
+    }
+    path_index.erase(songs[id].file_path);
+    for (SortedIndex* index : {&by_title, &by_artist, &by_album, &by_path}) {
+        index->erase(id);
+    }
+    songs.edit(id).file_path = file_path;
+    songs_changed = order_changed = true;
+    path_index[file_path] = id;
+    unsorted.push_back(id);
+}
+
+std::vector<SongId> MusicLibrary::songs_under(const std::string& path_prefix) {
+    sort_new_songs(); // So by_path has every song
+    size_t begin, end;
+    by_path.prefix_range(path_prefix, begin, end);
+    return by_path.range(begin, end);
+}
+
+std::vector<PooledPath> MusicLibrary::apply_changes(const std::string& directory_path, const LibraryChanges& changes) {
+    std::string prefix = library_prefix(directory_path);
+    size_t renamed = 0, removed = 0;
+    // A path the pool has never seen can't be in the library
+    auto find_song_at = [&](const std::string& relative) {
+        PooledPath path;
+        if (!PooledPath::find(prefix + relative, path)) {
+            return INVALID_SONG_ID;
+        }
+        auto it = path_index.find(path);
+        return it == path_index.end() ? INVALID_SONG_ID : it->second;
+    };
+
+    for (const auto& [from, to] : changes.renamed_directories) {
+        std::string old_prefix = prefix + from + "/";
+        std::string new_prefix = prefix + to + "/";
+        // A directory can only be renamed over an empty one, so anything the
+        // library still has there was deleted
+        for (SongId id : songs_under(new_prefix)) {
+            remove_song_by_id(id);
+            removed++;
+        }
+        for (SongId id : songs_under(old_prefix)) {
+            move_song_file(id, PooledPath(new_prefix + songs[id].file_path.str().substr(old_prefix.size())));
+            renamed++;
+        }
+    }
+    std::vector<std::string> changed_files = changes.changed_files;
+    for (const auto& [from, to] : changes.renamed_files) {
+        SongId id = find_song_at(from);
+        if (id == INVALID_SONG_ID) {
+            changed_files.push_back(to); // Wasn't in the library: read it as a new file
+            continue;
+        }
+        move_song_file(id, PooledPath(prefix + to));
+        renamed++;
+    }
+    for (const std::string& directory : changes.removed_directories) {
+        for (SongId id : songs_under(prefix + directory + "/")) {
+            remove_song_by_id(id);
+            removed++;
+        }
+    }
+    for (const std::string& file : changes.removed_files) {
+        SongId id = find_song_at(file);
+        if (id != INVALID_SONG_ID) {
+            remove_song_by_id(id);
+            removed++;
+        }
+    }
+
+    // New and rewritten files go through the scanner's merge, which skips
+    // ones whose stamp hasn't changed and reads tags for the rest
+    ScanSession session;
+    session.path_prefix = prefix;
+    session.open_prefix = changes.root + "/";
+    std::vector<ScannedFile> files;
+    for (const std::string& file : changed_files) {
+        ScannedFile scanned;
+        scanned.relative_path = file;
+        scanned.filename = file.substr(file.find_last_of('/') + 1);
+        if (!read_file_stamp(session.open_prefix + file, scanned.stamp)) {
+            // Gone again before we got to it
+            SongId id = find_song_at(file);
+            if (id != INVALID_SONG_ID) {
+                remove_song_by_id(id);
+                removed++;
+            }
+            continue;
+        }
+        files.push_back(std::move(scanned));
+    }
+    const size_t batch_size = 64;
+    size_t batch_count = (files.size() + batch_size - 1) / batch_size;
+    parallel_for(batch_count, [&](size_t b) {
+        size_t begin = b * batch_size;
+        size_t end = std::min(files.size(), begin + batch_size);
+        std::vector<ScannedFile> batch(files.begin() + begin, files.begin() + end);
+        merge_scan_batch(session, batch);
+    });
+    sort_new_songs();
+
+    std::vector<PooledPath> updated;
+    for (const ScannedFile& file : files) {
+        SongId id = find_song_at(file.relative_path);
+        if (id != INVALID_SONG_ID && !songs[id].has_loudness()) {
+            updated.push_back(songs[id].file_path);
+        }
+    }
+    if (!changes.rescan_directories.empty()) {
+        // Contents unknown: a rescan finds them, and only reads changed files.
+        // Songs already waiting for analysis were queued before.
+        std::vector<PooledPath> waiting = unanalysed_files();
+        std::unordered_set<PooledPath, PooledPath::Hash> queued(waiting.begin(), waiting.end());
+        queued.insert(updated.begin(), updated.end());
+        for (const std::string& directory : changes.rescan_directories) {
+            load_songs_from_directory(directory.empty() ? directory_path : prefix + directory);
+        }
+        for (const PooledPath& path : unanalysed_files()) {
+            if (!queued.count(path)) {
+                updated.push_back(path);
+            }
+        }
+    }
+    if (renamed + removed > 0) {
+        AssetResolver::instance().clear(); // Remembered locations may be stale
+    }
+    if (renamed + removed + session.added + session.updated > 0) {
+        log_info() << "Library updated from " << changes.root << ": " << session.added << " new, " << session.updated
+                   << " changed, " << renamed << " renamed, " << removed << " removed";
+    }
+    return updated;
+}
+
+void MusicLibrary::publish() {
+    if (!songs_changed && !order_changed) {
+        return;
+    }
+    sort_new_songs();
+    std::shared_ptr<const LibrarySnapshot> previous = std::atomic_load(&published);
+    std::shared_ptr<const LibrarySnapshot::Order> order;
+    if (previous && !order_changed) {
+        order = previous->order;
+    } else {
+        order = std::make_shared<const LibrarySnapshot::Order>(songs, by_title, by_artist, by_album, by_path);
+    }
+    uint64_t version = published_version.load(std::memory_order_relaxed) + 1;
+    std::shared_ptr<const LibrarySnapshot> next(new LibrarySnapshot(songs, std::move(order), version));
+    std::atomic_store(&published, std::move(next));
+    published_version.store(version, std::memory_order_release);
+    songs_changed = order_changed = false;
+}
+
+std::shared_ptr<const LibrarySnapshot> MusicLibrary::snapshot() const {
+    return std::atomic_load(&published);
+}
+
+bool MusicLibrary::refresh(std::shared_ptr<const LibrarySnapshot>& held) const {
+    if (held && held->get_version() == published_version.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::shared_ptr<const LibrarySnapshot> latest = std::atomic_load(&published);
+    if (latest == held) {
+        return false;
+    }
+    held = std::move(latest);
+    return true;
+}
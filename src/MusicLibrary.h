@@ -2,26 +2,122 @@
 #define MUSIC_LIBRARY_H
 
 #include "Song.h"
+#include "SongStore.h"
+#include "TitleIndex.h"
+#include "SearchIndex.h"
+#include "SortedIndex.h"
+#include "DirectoryScanner.h"
+#include "LibrarySnapshot.h"
+#include "LibraryWatcher.h"
+#include "LoudnessAnalyzer.h"
+#include "Fingerprint.h"
+#include <atomic>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <list>
 #include <functional>
+#include <unordered_map>
 
+// The song catalogue and its indexes. It is changed from one thread at a
+// time (the UI thread here; background work hands its results over, as
+// LoudnessAnalyzer and LibraryWatcher do). Pointers it returns stay valid
+// across inserts and removals; changing a song's fields may move it and its
+// chunk neighbours. Other threads read it through snapshots: the writer
+// calls publish() after a batch of changes, and snapshot() hands out the
+// latest one without locking.
 class MusicLibrary {
 public:
     MusicLibrary();
     void add_song(const Song& song);
-    Song* find_song(const std::string& title);
-    Song* get_song_by_index(int index); // Get song by number (1-based)
+    void add_songs(const std::vector<Song>& batch); // Bulk insert without per-song output
+    const Song* get_song(SongId id) const; // nullptr if the ID is unknown or removed
+    const Song* find_song(std::string_view title) const;
+    const Song* find_song_normalized(std::string_view title) const; // Ignores case, punctuation and spacing
+    // Closest title by edit distance (see SearchIndex::find_closest_title).
+    // Read-only, so several threads may call it while nothing modifies the library.
+    const Song* find_song_fuzzy(std::string_view title) const;
+    // Case-insensitive prefix/substring search over title, artist and album,
+    // best matches first
+    std::vector<SongId> search(std::string_view query, size_t limit = 20) const;
+    bool remove_song(const std::string& title); // Removes the first song with this title
+    const Song* get_song_by_index(int index) const; // Get song by number (1-based, number = ID + 1)
     int get_song_count() const; // Get total number of songs
     void list_all_songs(); // Lists songs with numbers
-    int load_songs_from_directory(const std::string& directory_path); // Returns number of songs loaded
+    // One page of the library in field order (see SortedIndex): up to count
+    // songs from position offset, and in total the number of songs there
+    // are to page through. With a prefix, only songs whose field starts with
+    // it. Costs O(log n + count) however large the library is.
+    std::vector<SongId> list_sorted(SortField field, std::string_view prefix, size_t offset, size_t count,
+                                    size_t& total) const;
+    // Returns number of songs loaded. Files already in the library with the
+    // same mtime and size are kept as-is; songs from this directory whose
+    // files are gone are removed.
+    int load_songs_from_directory(const std::string& directory_path);
+    // Applies a LibraryWatcher batch for directory_path (as passed to
+    // load_songs_from_directory) in place: renamed files keep their songs,
+    // new and rewritten files have their tags read. Returns the files of
+    // songs added or changed, which have no loudness or waveform yet.
+    std::vector<PooledPath> apply_changes(const std::string& directory_path, const LibraryChanges& changes);
+    static bool is_audio_file(const std::string& filename); // By extension
+    // Loads a library saved by save_index. Into an empty library, the
+    // saved indexes are used as they are rather than rebuilt.
+    bool load_index(const std::string& index_path);
+    bool save_index(const std::string& index_path); // Sorts in songs added since the last publish() first
+    std::vector<PooledPath> all_files() const; // File paths of every song that has one
+    std::vector<PooledPath> unanalysed_files() const; // Files of songs with no loudness measurement yet
+    void apply_loudness(const std::vector<LoudnessResult>& results); // Stores LoudnessAnalyzer measurements
+    // Groups of songs whose files are the same recording (by acoustic
+    // fingerprint, whatever the format or tags), each sorted by ID. Files
+    // are fingerprinted on all cores; fingerprints are kept for later calls
+    // until the file changes.
+    std::vector<std::vector<SongId>> find_duplicate_recordings();
+
+    // Makes the changes since the last call visible to snapshot() readers.
+    // Costs two pointers per 4096 songs, plus a pointer and an offset per
+    // sorted index block if songs were added, removed or re-keyed; does
+    // nothing if nothing changed. The first later change to a chunk or block
+    // the snapshot shares copies it.
+    void publish();
+    // The latest published state; safe from any thread, and never blocks
+    // on the writer. Empty until the first publish().
+    std::shared_ptr<const LibrarySnapshot> snapshot() const;
+    // Replaces held with the latest snapshot if a newer one was published
+    // and returns true. When it is current (the usual case) this is one
+    // atomic load, so readers can call it before every read without
+    // contending on the shared snapshot's reference count.
+    bool refresh(std::shared_ptr<const LibrarySnapshot>& held) const;
 
 private:
-    static const int TABLE_SIZE = 128;
-    std::list<Song> table[TABLE_SIZE];
+    struct ScanSession; // State shared by the scan workers of one load_songs_from_directory call
+
+    SongStore songs; // Dense by ID, Song* stays valid across inserts
+    TitleIndex title_index; // Title -> ID in songs
+    SearchIndex search_index; // Words of title/artist/album -> IDs
+    SortedIndex by_title, by_artist, by_album, by_path;
+    std::vector<SongId> unsorted; // Added or changed songs not yet in the sorted indexes
+    std::vector<FileStamp> stamps; // By ID; zero for songs that didn't come from a scan
+    std::unordered_map<PooledPath, SongId, PooledPath::Hash> path_index; // file_path -> ID, for rescans
+
+    std::shared_ptr<const LibrarySnapshot> published; // Read and replaced with std::atomic_load/store
+    std::atomic<uint64_t> published_version;
+    bool songs_changed = true; // Since the last publish()
+    bool order_changed = true; // The sorted indexes, since the last publish()
+
+    struct StoredFingerprint {
+        FileStamp stamp;
+        std::vector<Landmark> landmarks;
+    };
+    std::unordered_map<PooledPath, StoredFingerprint, PooledPath::Hash> fingerprints; // By file_path
 
-    size_t hash_function(const std::string& title);
+    SongId insert_song(const Song& song, const FileStamp& stamp);
+    void replace_song(SongId id, const Song& song, const FileStamp& stamp);
+    void remove_song_by_id(SongId id);
+    void move_song_file(SongId id, const PooledPath& file_path); // Same file under a new path
+    std::vector<SongId> songs_under(const std::string& path_prefix); // By file path prefix
+    void sort_new_songs(); // Moves unsorted into the sorted indexes
+    const SortedIndex& sorted_index(SortField field) const;
+    void merge_scan_batch(ScanSession& session, std::vector<ScannedFile>& batch);
 };
 
 #endif // MUSIC_LIBRARY_H
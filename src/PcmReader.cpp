@@ -0,0 +1,40 @@
+#include "PcmReader.h"
+#include "MappedInputStream.h"
+#include <SFML/Audio/InputSoundFile.hpp>
+
+PcmReader::PcmReader() : sample_rate(0), channel_count(0), frame_count(0) {}
+
+PcmReader::~PcmReader() {
+    file.reset();
+    stream.reset();
+}
+
+bool PcmReader::open(const std::string& resolved_path, Use use) {
+    file.reset();
+    sample_rate = 0;
+    channel_count = 0;
+    frame_count = 0;
+    stream = std::make_unique<MappedInputStream>(resolved_path, use == Use::Playback);
+    if (!stream->is_open()) {
+        stream.reset();
+        return false;
+    }
+    file = std::make_unique<sf::InputSoundFile>();
+    if (!file->openFromStream(*stream) || file->getChannelCount() == 0) {
+        file.reset();
+        stream.reset();
+        return false;
+    }
+    sample_rate = file->getSampleRate();
+    channel_count = file->getChannelCount();
+    frame_count = file->getSampleCount() / channel_count;
+    return true;
+}
+
+size_t PcmReader::read(int16_t* samples, size_t frame_capacity) {
+    if (!file) {
+        return 0;
+    }
+    sf::Uint64 read = file->read(samples, frame_capacity * channel_count);
+    return static_cast<size_t>(read / channel_count);
+}
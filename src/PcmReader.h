@@ -0,0 +1,53 @@
+#ifndef PCM_READER_H
+#define PCM_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+// Forward declarations to avoid including SFML in header (prevents static init issues)
+namespace sf { class InputSoundFile; }
+class MappedInputStream;
+
+// Interleaved 16-bit PCM, read a chunk at a time
+class PcmSource {
+public:
+    virtual ~PcmSource() = default;
+    virtual unsigned get_sample_rate() const = 0;
+    virtual unsigned get_channel_count() const = 0;
+    virtual uint64_t get_frame_count() const = 0; // 0 if unknown
+    // Fills up to frame_capacity frames; returns how many, 0 at the end
+    virtual size_t read(int16_t* samples, size_t frame_capacity) = 0;
+};
+
+// A file's audio as interleaved 16-bit PCM. Decodes with SFML from a
+// mapping of the file, for playback (MixEngine) and for the background
+// passes (loudness, waveforms, fingerprints) that need samples.
+class PcmReader : public PcmSource {
+public:
+    // Playback maps through MappingCache, so replaying a song reuses its
+    // mapping, and reads the whole file ahead. A background pass reads each
+    // file of the library once, so it maps it on its own and leaves the
+    // cache and the page cache's read-ahead to playback.
+    enum class Use { Playback, Background };
+
+    PcmReader();
+    ~PcmReader() override;
+    PcmReader(const PcmReader&) = delete;
+    PcmReader& operator=(const PcmReader&) = delete;
+
+    bool open(const std::string& resolved_path, Use use = Use::Playback); // False if it can't be mapped or decoded
+    unsigned get_sample_rate() const override { return sample_rate; }
+    unsigned get_channel_count() const override { return channel_count; }
+    uint64_t get_frame_count() const override { return frame_count; }
+    size_t read(int16_t* samples, size_t frame_capacity) override;
+
+private:
+    std::unique_ptr<MappedInputStream> stream; // Declared before file: must outlive it
+    std::unique_ptr<sf::InputSoundFile> file;
+    unsigned sample_rate;
+    unsigned channel_count;
+    uint64_t frame_count;
+};
+
+#endif // PCM_READER_H
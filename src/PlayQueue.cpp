@@ -0,0 +1,346 @@
+#include "PlayQueue.h"
+#include <algorithm>
+
+PlayQueue::PlayQueue(uint64_t seed) : rng(static_cast<std::mt19937::result_type>(seed ^ (seed >> 32))) {}
+
+void PlayQueue::update(Entry node) {
+    Node& n = nodes[node];
+    n.size = 1 + subtree_size(n.left) + subtree_size(n.right);
+    if (n.left != NONE) {
+        nodes[n.left].parent = node;
+    }
+    if (n.right != NONE) {
+        nodes[n.right].parent = node;
+    }
+}
+
+void PlayQueue::split(Entry node, size_t count, Entry& left, Entry& right) {
+    if (node == NONE) {
+        left = right = NONE;
+        return;
+    }
+    size_t left_size = subtree_size(nodes[node].left);
+    if (left_size < count) {
+        split(nodes[node].right, count - left_size - 1, nodes[node].right, right);
+        left = node;
+    } else {
+        split(nodes[node].left, count, left, nodes[node].left);
+        right = node;
+    }
+    update(node);
+    // The caller links these in; as returned they are roots
+    if (left != NONE) {
+        nodes[left].parent = NONE;
+    }
+    if (right != NONE) {
+        nodes[right].parent = NONE;
+    }
+}
+
+PlayQueue::Entry PlayQueue::merge(Entry left, Entry right) {
+    if (left == NONE || right == NONE) {
+        Entry node = left == NONE ? right : left;
+        if (node != NONE) {
+            nodes[node].parent = NONE;
+        }
+        return node;
+    }
+    Entry top;
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        top = left;
+    } else {
+        nodes[right].left = merge(left, nodes[right].left);
+        top = right;
+    }
+    update(top);
+    nodes[top].parent = NONE;
+    return top;
+}
+
+PlayQueue::Entry PlayQueue::insert(size_t position) {
+    position = std::min(position, size());
+    Entry entry;
+    if (!free_entries.empty()) {
+        entry = free_entries.back();
+        free_entries.pop_back();
+    } else {
+        entry = static_cast<Entry>(nodes.size());
+        nodes.emplace_back();
+        generations.push_back(0);
+        unplayed_slot.push_back(NONE);
+    }
+    Node& node = nodes[entry];
+    node = Node();
+    node.priority = static_cast<uint32_t>(rng());
+    node.size = 1;
+
+    Entry left, right;
+    split(root, position, left, right);
+    root = merge(merge(left, entry), right);
+    if (shuffled) {
+        add_unplayed(entry);
+    }
+    return entry;
+}
+
+PlayQueue::Entry PlayQueue::insert_next() {
+    size_t position = current_entry == NONE ? size() : position_of(current_entry) + 1;
+    bool was_shuffled = shuffled;
+    shuffled = false; // Not into this round's draw: it goes straight into the history
+    Entry entry = insert(position);
+    shuffled = was_shuffled;
+    if (shuffled) {
+        size_t next = current_entry == NONE ? 0 : history_pos + 1;
+        history.insert(history.begin() + std::min(next, history.size()), Played{entry, generations[entry]});
+    }
+    return entry;
+}
+
+PlayQueue::Entry PlayQueue::erase(size_t position) {
+    if (position >= size()) {
+        return NONE;
+    }
+    Entry left, middle, right;
+    split(root, position, left, middle);
+    Entry entry;
+    split(middle, 1, entry, right);
+    root = merge(left, right);
+
+    remove_unplayed(entry);
+    generations[entry]++;
+    nodes[entry] = Node();
+    free_entries.push_back(entry);
+    if (entry == current_entry) {
+        // The track that took its place becomes current
+        set_current(empty() ? NONE : at(position < size() ? position : 0));
+    }
+    return entry;
+}
+
+bool PlayQueue::move(size_t from, size_t to) {
+    size_t count = size();
+    if (from >= count || to >= count) {
+        return false;
+    }
+    if (from == to) {
+        return true;
+    }
+    Entry left, middle, right;
+    split(root, from, left, middle);
+    Entry entry;
+    split(middle, 1, entry, right);
+    root = merge(left, right);
+    split(root, to, left, right);
+    root = merge(merge(left, entry), right);
+    return true;
+}
+
+void PlayQueue::clear() {
+    nodes.clear();
+    free_entries.clear();
+    generations.clear();
+    unplayed.clear();
+    unplayed_slot.clear();
+    history.clear();
+    history_pos = 0;
+    root = NONE;
+    current_entry = NONE;
+}
+
+PlayQueue::Entry PlayQueue::at(size_t position) const {
+    Entry node = root;
+    while (node != NONE) {
+        size_t left_size = subtree_size(nodes[node].left);
+        if (position < left_size) {
+            node = nodes[node].left;
+        } else if (position == left_size) {
+            return node;
+        } else {
+            position -= left_size + 1;
+            node = nodes[node].right;
+        }
+    }
+    return NONE;
+}
+
+size_t PlayQueue::position_of(Entry entry) const {
+    if (entry >= nodes.size() || nodes[entry].size == 0) {
+        return size();
+    }
+    size_t position = subtree_size(nodes[entry].left);
+    for (Entry node = entry; nodes[node].parent != NONE; node = nodes[node].parent) {
+        Entry parent = nodes[node].parent;
+        if (nodes[parent].right == node) {
+            position += subtree_size(nodes[parent].left) + 1;
+        }
+    }
+    return position;
+}
+
+void PlayQueue::set_current(Entry entry) {
+    if (entry == current_entry) {
+        return;
+    }
+    if (shuffled) {
+        // Picking a track drops the tracks queued after the old one; they
+        // go back into the round
+        size_t next = current_entry == NONE ? 0 : history_pos + 1;
+        for (size_t i = next; i < history.size(); ++i) {
+            if (!is_stale(history[i])) {
+                add_unplayed(history[i].entry);
+            }
+        }
+        history.erase(history.begin() + std::min(next, history.size()), history.end());
+        if (entry == NONE) {
+            history.clear();
+        } else {
+            remove_unplayed(entry);
+            history.push_back({entry, generations[entry]});
+            while (history.size() > MAX_HISTORY) {
+                history.pop_front();
+            }
+        }
+        history_pos = history.empty() ? 0 : history.size() - 1;
+    }
+    current_entry = entry;
+}
+
+PlayQueue::Entry PlayQueue::order_next() const {
+    if (empty()) {
+        return NONE;
+    }
+    if (current_entry == NONE) {
+        return at(0);
+    }
+    return at((position_of(current_entry) + 1) % size());
+}
+
+PlayQueue::Entry PlayQueue::order_previous() const {
+    if (empty()) {
+        return NONE;
+    }
+    if (current_entry == NONE) {
+        return at(size() - 1);
+    }
+    return at((position_of(current_entry) + size() - 1) % size());
+}
+
+PlayQueue::Entry PlayQueue::peek_next() {
+    if (empty()) {
+        return NONE;
+    }
+    if (!shuffled) {
+        return order_next();
+    }
+    size_t next = current_entry == NONE ? 0 : history_pos + 1;
+    while (next < history.size() && is_stale(history[next])) {
+        history.erase(history.begin() + next);
+    }
+    if (next < history.size()) {
+        return history[next].entry;
+    }
+    Entry entry = draw();
+    history.push_back({entry, generations[entry]});
+    return entry;
+}
+
+PlayQueue::Entry PlayQueue::next() {
+    Entry entry = peek_next();
+    if (entry == NONE || !shuffled) {
+        current_entry = entry;
+        return entry;
+    }
+    history_pos = current_entry == NONE ? 0 : history_pos + 1;
+    current_entry = entry;
+    while (history.size() > MAX_HISTORY && history_pos > 0) {
+        history.pop_front();
+        history_pos--;
+    }
+    return entry;
+}
+
+PlayQueue::Entry PlayQueue::peek_previous() const {
+    if (!shuffled) {
+        return order_previous();
+    }
+    for (size_t i = current_entry == NONE ? 0 : history_pos; i-- > 0;) {
+        if (!is_stale(history[i])) {
+            return history[i].entry;
+        }
+    }
+    return NONE;
+}
+
+PlayQueue::Entry PlayQueue::previous() {
+    if (!shuffled) {
+        current_entry = order_previous();
+        return current_entry;
+    }
+    for (size_t i = current_entry == NONE ? 0 : history_pos; i-- > 0;) {
+        if (!is_stale(history[i])) {
+            history_pos = i;
+            current_entry = history[i].entry;
+            return current_entry;
+        }
+    }
+    return NONE;
+}
+
+void PlayQueue::set_shuffle(bool enabled) {
+    if (enabled == shuffled) {
+        return;
+    }
+    shuffled = enabled;
+    for (Entry entry : unplayed) {
+        unplayed_slot[entry] = NONE;
+    }
+    unplayed.clear();
+    history.clear();
+    history_pos = 0;
+    if (shuffled) {
+        start_round();
+        if (current_entry != NONE) {
+            history.push_back({current_entry, generations[current_entry]});
+        }
+    }
+}
+
+void PlayQueue::add_unplayed(Entry entry) {
+    if (unplayed_slot[entry] == NONE) {
+        unplayed_slot[entry] = static_cast<uint32_t>(unplayed.size());
+        unplayed.push_back(entry);
+    }
+}
+
+void PlayQueue::remove_unplayed(Entry entry) {
+    uint32_t slot = unplayed_slot[entry];
+    if (slot == NONE) {
+        return;
+    }
+    Entry last = unplayed.back();
+    unplayed[slot] = last;
+    unplayed_slot[last] = slot;
+    unplayed.pop_back();
+    unplayed_slot[entry] = NONE;
+}
+
+void PlayQueue::start_round() {
+    for_each([this](Entry entry) {
+        if (entry != current_entry) {
+            add_unplayed(entry);
+        }
+    });
+}
+
+PlayQueue::Entry PlayQueue::draw() {
+    if (unplayed.empty()) {
+        start_round();
+    }
+    if (unplayed.empty()) {
+        return current_entry; // The only track
+    }
+    Entry entry = unplayed[std::uniform_int_distribution<size_t>(0, unplayed.size() - 1)(rng)];
+    remove_unplayed(entry);
+    return entry;
+}
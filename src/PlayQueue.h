@@ -0,0 +1,121 @@
+#ifndef PLAY_QUEUE_H
+#define PLAY_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+// Play order of a playlist, for queues of millions of tracks. Each track is
+// an Entry handle that stays the same while the track is moved around, so
+// callers keep their per-track data in a vector indexed by it. Positions
+// are kept by an implicit treap (a randomly balanced tree ordered by
+// position, each node knowing its subtree size), so inserting, removing,
+// moving and indexing are all O(log n); the current track is a handle, so
+// reading it is O(1).
+//
+// In shuffle mode next() draws a random track not yet played this round
+// and records it in a history, which previous() and next() walk back and
+// forth, so going back replays the same tracks in the same order.
+class PlayQueue {
+public:
+    using Entry = uint32_t;
+    static constexpr Entry NONE = 0xFFFFFFFFu;
+    static const size_t MAX_HISTORY = 10000; // Shuffle history kept for previous()
+
+    explicit PlayQueue(uint64_t seed = std::random_device()());
+
+    size_t size() const { return root == NONE ? 0 : nodes[root].size; }
+    bool empty() const { return root == NONE; }
+    // One past the highest handle in use, for sizing per-entry vectors.
+    // Handles of erased entries are reused by later inserts.
+    size_t entry_limit() const { return nodes.size(); }
+
+    Entry insert(size_t position); // New entry at position (clamped to size())
+    Entry push_back() { return insert(size()); }
+    // Right after the current track, and in shuffle mode drawn next too
+    Entry insert_next();
+    Entry erase(size_t position); // The erased entry; NONE if position is past the end
+    bool move(size_t from, size_t to); // to is the entry's position afterwards
+    void clear();
+
+    Entry at(size_t position) const; // NONE if position is past the end
+    size_t position_of(Entry entry) const; // size() if entry isn't in the queue
+    template <typename Fn>
+    void for_each(Fn fn) const; // fn(entry) in play order, O(n)
+
+    Entry current() const { return current_entry; }
+    void set_current(Entry entry); // NONE for no current track
+    // Moves on to the next/previous track and returns it; NONE if the queue
+    // is empty, or for previous() in shuffle mode at the start of the history.
+    // In order the queue wraps around.
+    Entry next();
+    Entry previous();
+    // What next()/previous() would return, for prefetching. In shuffle mode
+    // peek_next() makes the draw, and next() then returns the same track.
+    Entry peek_next();
+    Entry peek_previous() const;
+
+    void set_shuffle(bool enabled); // Starts a new round from the current track
+    bool is_shuffled() const { return shuffled; }
+
+private:
+    struct Node {
+        Entry left = NONE;
+        Entry right = NONE;
+        Entry parent = NONE;
+        uint32_t priority = 0;
+        uint32_t size = 0; // Of the subtree; 0 while the entry is free
+    };
+
+    struct Played {
+        Entry entry;
+        uint32_t generation; // Stale once the entry is erased (and perhaps reused)
+    };
+
+    std::vector<Node> nodes; // By entry
+    std::vector<Entry> free_entries;
+    std::vector<uint32_t> generations; // By entry; bumped on erase
+    Entry root = NONE;
+    Entry current_entry = NONE;
+    std::mt19937 rng;
+
+    bool shuffled = false;
+    std::vector<Entry> unplayed; // This shuffle round's remaining tracks, in any order
+    std::vector<uint32_t> unplayed_slot; // By entry: index in unplayed, or NONE
+    std::deque<Played> history; // Shuffle play order
+    size_t history_pos = 0; // Of the current track in history
+
+    uint32_t subtree_size(Entry node) const { return node == NONE ? 0 : nodes[node].size; }
+    void update(Entry node);
+    void split(Entry node, size_t count, Entry& left, Entry& right); // First count entries to left
+    Entry merge(Entry left, Entry right);
+
+    bool is_stale(const Played& played) const { return generations[played.entry] != played.generation; }
+    void add_unplayed(Entry entry);
+    void remove_unplayed(Entry entry);
+    void start_round(); // Every entry but the current one is unplayed again
+    Entry draw(); // Removes a random entry from unplayed
+    Entry order_next() const;
+    Entry order_previous() const;
+};
+
+template <typename Fn>
+void PlayQueue::for_each(Fn fn) const {
+    // In-order walk with an explicit stack; the tree's depth is O(log n)
+    std::vector<Entry> stack;
+    Entry node = root;
+    while (node != NONE || !stack.empty()) {
+        while (node != NONE) {
+            stack.push_back(node);
+            node = nodes[node].left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        fn(node);
+        node = nodes[node].right;
+    }
+}
+
+#endif // PLAY_QUEUE_H
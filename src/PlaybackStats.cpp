@@ -0,0 +1,47 @@
+#include "PlaybackStats.h"
+#include <cstdio>
+
+static const char* const STAGE_NAMES[] = {"take", "resolve", "open", "start", "first buffer", "total"};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<size_t>(PlaybackStage::Count),
+              "one name per stage");
+
+void PlaybackStats::record(PlaybackStage s, Clock::time_point from, Clock::time_point to) {
+    stage(s).record(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+PlaybackStats::Clock::time_point PlaybackStats::lap(PlaybackStage s, Clock::time_point from) {
+    Clock::time_point now = Clock::now();
+    record(s, from, now);
+    return now;
+}
+
+void PlaybackStats::count_prefetch(bool hit) {
+    (hit ? prefetch_hits : prefetch_misses).fetch_add(1, std::memory_order_relaxed);
+}
+
+static void print_ms(std::ostream& out, uint64_t ns) {
+    char text[32];
+    std::snprintf(text, sizeof(text), " %10.3f ms", ns / 1e6);
+    out << text;
+}
+
+void PlaybackStats::print(std::ostream& out) const {
+    uint64_t hits = prefetch_hits.load(std::memory_order_relaxed);
+    uint64_t misses = prefetch_misses.load(std::memory_order_relaxed);
+    out << "--- Playback latency (" << plays() << " track start(s), " << hits << " prefetched, " << misses
+        << " opened on demand) ---\n";
+    char header[96];
+    std::snprintf(header, sizeof(header), "%-13s %7s %13s %13s %13s\n", "stage", "count", "p50", "p99", "max");
+    out << header;
+    for (int s = 0; s < static_cast<int>(PlaybackStage::Count); ++s) {
+        const LatencyHistogram& h = histograms[s];
+        char name[32];
+        std::snprintf(name, sizeof(name), "%-13s %7llu", STAGE_NAMES[s], static_cast<unsigned long long>(h.count()));
+        out << name;
+        print_ms(out, h.percentile(0.5));
+        print_ms(out, h.percentile(0.99));
+        print_ms(out, h.max());
+        out << '\n';
+    }
+    out << "-----------------------------------" << std::endl;
+}
@@ -0,0 +1,45 @@
+#ifndef PLAYBACK_STATS_H
+#define PLAYBACK_STATS_H
+
+#include "LatencyHistogram.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Where the time goes between asking for a track and hearing it
+enum class PlaybackStage {
+    Take,        // Checking whether the track is the one queued in the mixer
+    Resolve,     // resolve_asset_path probes, prefetch misses only
+    Open,        // Mapping the file and reading its header, prefetch misses only
+    Start,       // MixEngine::play(): starting the decoder and handing it to the mixer
+    FirstBuffer, // play() until the mixer takes the first decoded audio, on the output thread
+    Total,       // play/next/prev called until play() returned
+    Count
+};
+
+// One latency histogram per playback stage, plus prefetch hit counts.
+// Recording is thread-safe.
+class PlaybackStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PlaybackStats() : prefetch_hits(0), prefetch_misses(0) {}
+
+    LatencyHistogram& stage(PlaybackStage s) { return histograms[static_cast<int>(s)]; }
+    const LatencyHistogram& stage(PlaybackStage s) const { return histograms[static_cast<int>(s)]; }
+    void record(PlaybackStage s, Clock::time_point from, Clock::time_point to);
+    // Records the time since from and returns now, to chain stages
+    Clock::time_point lap(PlaybackStage s, Clock::time_point from);
+    void count_prefetch(bool hit);
+    uint64_t plays() const { return stage(PlaybackStage::Total).count(); }
+
+    void print(std::ostream& out) const; // Count, p50, p99 and max per stage
+
+private:
+    LatencyHistogram histograms[static_cast<int>(PlaybackStage::Count)];
+    std::atomic<uint64_t> prefetch_hits;
+    std::atomic<uint64_t> prefetch_misses;
+};
+
+#endif // PLAYBACK_STATS_H
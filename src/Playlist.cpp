@@ -1,319 +1,685 @@
 #include "Playlist.h"
+#include "AssetResolver.h"
+#include "Logger.h"
+#include "LoudnessMeter.h"
 #include "MusicLibrary.h" // Needed for loading from file
-#include <SFML/Audio.hpp> // Include SFML here in implementation file
+#include "ParallelFor.h"
+#include "PlaylistFile.h"
+#include <chrono>
+#include <cmath>
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <algorithm>
-#include <exception>
-#ifdef _WIN32
-    #include <windows.h>
-    #include <fileapi.h>
-#endif
-
-// Helper function to resolve asset file paths using Windows API (avoids filesystem DLL issues)
-// Tries multiple possible locations for the file
-static std::string resolve_asset_path(const std::string& file_path) {
-    // If path is empty, return as-is
-    if (file_path.empty()) {
-        return file_path;
+
+// How often the watcher collects the engine's events while a track plays.
+// Transitions happen in the engine on time; this only bounds how long the
+// playlist takes to notice and queue the track after.
+static const auto EVENT_POLL_INTERVAL = std::chrono::milliseconds(50);
+
+Playlist::Playlist(const std::string& name, bool prefetch)
+    : name(name), engine(std::make_unique<MixEngine>()), playing_tag(MixEngine::NO_TAG), next_tag(0),
+      gapless(false), normalized(true), auto_advance(false), shutting_down(false) {
+    end_watcher = std::thread(&Playlist::watch_for_track_end, this);
+    if (prefetch) {
+        prefetcher = std::thread(&Playlist::prefetch_neighbours, this);
     }
-    
-#ifdef _WIN32
-    // Try the path as-is first
-    DWORD attrs = GetFileAttributesA(file_path.c_str());
-    if (attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
-        return file_path;
+    log_info() << "Created playlist: " << name;
+}
+
+Playlist::~Playlist() {
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        shutting_down = true;
     }
-    
-    // Try relative to current working directory
-    char cwd[MAX_PATH];
-    if (GetCurrentDirectoryA(MAX_PATH, cwd)) {
-        std::string cwd_path = std::string(cwd) + "\\" + file_path;
-        std::replace(cwd_path.begin(), cwd_path.end(), '/', '\\');
-        attrs = GetFileAttributesA(cwd_path.c_str());
-        if (attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
-            return cwd_path;
-        }
+    playback_changed.notify_all();
+    prefetch_wanted.notify_all();
+    end_watcher.join();
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
+}
+
+void Playlist::add_song(const Song& song) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    // Check if song is already in the playlist (by title and artist to be safe)
+    if (contains_song(song.title, song.artist)) {
+        log_info() << "Song '" << song.title << "' by " << song.artist << " is already in the playlist.";
+        return;
     }
     
-    // Try parent directory
-    if (GetCurrentDirectoryA(MAX_PATH, cwd)) {
-        std::string parent_path = std::string(cwd) + "\\..\\" + file_path;
-        std::replace(parent_path.begin(), parent_path.end(), '/', '\\');
-        attrs = GetFileAttributesA(parent_path.c_str());
-        if (attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
-            return parent_path;
+    // Song is not a duplicate, add it
+    PlayQueue::Entry entry = queue.push_back();
+    store_song(entry, song);
+    if (queue.current() == PlayQueue::NONE) { // If playlist was empty, set this as the first song
+        queue.set_current(entry);
+    }
+    arm_neighbours(); // The new song may be the next one
+    log_info() << "Added '" << song.title << "' to playlist '" << name << "'";
+}
+
+void Playlist::add_song_next(const Song& song) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (contains_song(song.title, song.artist)) {
+        log_info() << "Song '" << song.title << "' by " << song.artist << " is already in the playlist.";
+        return;
+    }
+    PlayQueue::Entry entry = queue.insert_next();
+    store_song(entry, song);
+    if (queue.current() == PlayQueue::NONE) {
+        queue.set_current(entry);
+    }
+    arm_neighbours();
+    log_info() << "Queued '" << song.title << "' to play next in playlist '" << name << "'";
+}
+
+bool Playlist::remove_song(size_t position) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (position == 0 || position > queue.size()) {
+        log_info() << "No song at position " << position << " in playlist '" << name << "'.";
+        return false;
+    }
+    PlayQueue::Entry entry = queue.at(position - 1);
+    bool was_current = entry == queue.current();
+    Song removed = std::move(songs[entry]);
+    songs[entry] = Song();
+    auto range = song_keys.equal_range(song_key_hash(removed.title, removed.artist));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == entry) {
+            song_keys.erase(it);
+            break;
         }
     }
-    
-    // Try grandparent directory
-    if (GetCurrentDirectoryA(MAX_PATH, cwd)) {
-        std::string grandparent_path = std::string(cwd) + "\\..\\..\\" + file_path;
-        std::replace(grandparent_path.begin(), grandparent_path.end(), '/', '\\');
-        attrs = GetFileAttributesA(grandparent_path.c_str());
-        if (attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
-            return grandparent_path;
+    queue.erase(position - 1);
+    if (was_current) {
+        // The next song is current now, but isn't started here
+        engine->stop();
+        playing_tag = MixEngine::NO_TAG;
+        auto_advance = false;
+        playback_changed.notify_all();
+    }
+    arm_neighbours();
+    log_info() << "Removed '" << removed.title << "' from playlist '" << name << "'";
+    return true;
+}
+
+bool Playlist::move_song(size_t from, size_t to) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (from == 0 || to == 0 || !queue.move(from - 1, to - 1)) {
+        log_info() << "Positions must be between 1 and " << queue.size() << ".";
+        return false;
+    }
+    arm_neighbours(); // The songs either side of the current one may have changed
+    log_info() << "Moved '" << songs[queue.at(to - 1)].title << "' to position " << to;
+    return true;
+}
+
+uint64_t Playlist::song_key_hash(PooledString title, PooledString artist) {
+    // Pooled strings are equal exactly when their pointers are, so hash those
+    uint64_t h = reinterpret_cast<uintptr_t>(title.data()) * 0x9e3779b97f4a7c15ULL;
+    // Combine asymmetrically so (a, b) and (b, a) hash differently
+    return h ^ (reinterpret_cast<uintptr_t>(artist.data()) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+bool Playlist::contains_song(PooledString title, PooledString artist) const {
+    auto range = song_keys.equal_range(song_key_hash(title, artist));
+    for (auto it = range.first; it != range.second; ++it) {
+        const Song& existing_song = songs[it->second];
+        if (existing_song.title == title && existing_song.artist == artist) {
+            return true;
         }
     }
-#else
-    // POSIX implementation would go here
-    // For now, just return the original path
-#endif
-    
-    // If none found, return original path (will fail gracefully with better error message)
-    return file_path;
+    return false;
 }
 
-Playlist::Playlist(const std::string& name) : name(name), current_song_index(-1), current_music(std::make_unique<sf::Music>()) {
-    std::cout << "Created playlist: " << name << std::endl;
+void Playlist::store_song(PlayQueue::Entry entry, Song song) {
+    if (songs.size() <= entry) {
+        songs.resize(entry + 1);
+    }
+    song_keys.emplace(song_key_hash(song.title, song.artist), entry);
+    songs[entry] = std::move(song);
 }
 
-Playlist::~Playlist() = default; // Default destructor is fine with unique_ptr
+const Song* Playlist::current_song() const {
+    PlayQueue::Entry entry = queue.current();
+    return entry == PlayQueue::NONE ? nullptr : &songs[entry];
+}
 
-void Playlist::add_song(const Song& song) {
-    // Check if song is already in the playlist (by title and artist to be safe)
-    for (const Song& existing_song : songs) {
-        if (existing_song.title == song.title && existing_song.artist == song.artist) {
-            std::cout << "Song '" << song.title << "' by " << song.artist << " is already in the playlist." << std::endl;
-            return;
+// Resolves and opens a song's file; a remembered location that has gone
+// stale is looked up again once. nullptr if it can't be opened.
+static std::unique_ptr<PcmSource> open_song(const PooledPath& file_path, std::string& resolved_path) {
+    AssetResolver& resolver = AssetResolver::instance();
+    resolved_path = resolver.resolve(file_path);
+    std::unique_ptr<PcmSource> source = MixEngine::open_file(resolved_path);
+    if (!source && resolver.invalidate(file_path)) {
+        resolved_path = resolver.resolve(file_path);
+        source = MixEngine::open_file(resolved_path);
+    }
+    return source;
+}
+
+void Playlist::arm_neighbours() {
+    // In shuffle mode peek_next() draws the next song now, so it can decode early
+    PlayQueue::Entry current = queue.current();
+    PlayQueue::Entry next = queue.peek_next();
+    PlayQueue::Entry previous = queue.peek_previous();
+    if (next == current) {
+        next = PlayQueue::NONE; // A single song doesn't follow itself
+    }
+    if (previous == current || previous == next) {
+        previous = PlayQueue::NONE;
+    }
+    aim(ahead, next);
+    aim(behind, previous);
+    // Decoded ahead either way; only started on its own when gapless or crossfading
+    if (auto_advance && (gapless || engine->get_crossfade() > 0) && ahead.tag != MixEngine::NO_TAG) {
+        if (engine->get_queued() != ahead.tag) {
+            engine->queue(ahead.tag);
         }
+    } else {
+        engine->clear_queue();
     }
-    
-    // Song is not a duplicate, add it
-    songs.push_back(song);
-    if (current_song_index == -1) { // If playlist was empty, set this as the first song
-        current_song_index = 0;
+}
+
+void Playlist::aim(Neighbour& neighbour, PlayQueue::Entry entry) {
+    PooledPath path = entry == PlayQueue::NONE ? PooledPath() : songs[entry].file_path;
+    if (neighbour.entry == entry && neighbour.path == path) {
+        return;
+    }
+    if (neighbour.tag != MixEngine::NO_TAG) {
+        engine->discard(neighbour.tag);
+    }
+    neighbour = Neighbour();
+    if (!path.empty()) {
+        neighbour.entry = entry;
+        neighbour.path = path;
+        prefetch_wanted.notify_one();
+    }
+}
+
+void Playlist::prefetch_neighbours() {
+    std::unique_lock<std::mutex> lock(playback_mutex);
+    while (!shutting_down) {
+        Neighbour* wanted = nullptr;
+        for (Neighbour* neighbour : {&ahead, &behind}) {
+            if (neighbour->entry != PlayQueue::NONE && neighbour->tag == MixEngine::NO_TAG && !neighbour->failed) {
+                wanted = neighbour;
+                break;
+            }
+        }
+        if (!wanted) {
+            prefetch_wanted.wait(lock);
+            continue;
+        }
+        PlayQueue::Entry entry = wanted->entry;
+        PooledPath path = wanted->path;
+        // Resolving and opening can take a while (a network share, a moved
+        // file), so the lock is let go meanwhile
+        lock.unlock();
+        std::string resolved_path;
+        std::unique_ptr<PcmSource> source = open_song(path, resolved_path);
+        lock.lock();
+        if (wanted->entry != entry || wanted->path != path || wanted->tag != MixEngine::NO_TAG) {
+            continue; // Moved on while it was opening
+        }
+        if (!source) {
+            wanted->failed = true;
+            log_warning() << "Warning: Could not open a song ahead of time: " << path;
+            continue; // Playing it reports the error
+        }
+        wanted->tag = next_tag++;
+        engine->prepare(std::move(source), wanted->tag, gain_for(songs[entry]));
+        arm_neighbours(); // Queues it if it should start on its own
     }
-    std::cout << "Added '" << song.title << "' to playlist '" << name << "'" << std::endl;
 }
 
 void Playlist::play() {
-    if (songs.empty()) {
-        std::cout << "Playlist '" << name << "' is empty. No song to play." << std::endl;
+    auto requested = PlaybackStats::Clock::now(); // Waiting for the lock counts too
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    play_current(requested);
+}
+
+void Playlist::play_current(PlaybackStats::Clock::time_point requested) {
+    if (queue.empty()) {
+        log_info() << "Playlist '" << name << "' is empty. No song to play.";
         return;
     }
 
-    if (current_song_index < 0 || current_song_index >= songs.size()) {
-        std::cout << "Invalid current song index. Resetting to first song." << std::endl;
-        current_song_index = 0;
+    if (queue.current() == PlayQueue::NONE) {
+        log_info() << "No current song. Starting from the first song.";
+        queue.set_current(queue.at(0));
     }
 
-    const Song& song_to_play = songs[current_song_index];
+    const Song& song_to_play = songs[queue.current()];
     if (!song_to_play.file_path.empty()) {
-        // Stop any currently playing music
-        current_music->stop();
-
-        // Resolve the asset path (try multiple locations)
-        std::string resolved_path = resolve_asset_path(song_to_play.file_path);
-        
-        // Load and play the new song
-        if (current_music->openFromFile(resolved_path)) {
-            current_music->play();
-            std::cout << "Playing: " << song_to_play.title << " by " << song_to_play.artist << " from " << resolved_path << std::endl;
+        // Hand over the neighbour's deck when it is this song (opened and
+        // decoding already), otherwise resolve and open it here. Either way
+        // it is decoded from a shared memory mapping of the file rather than
+        // its own file reads.
+        auto mark = PlaybackStats::Clock::now();
+        LatencyHistogram& first_buffer = stats.stage(PlaybackStage::FirstBuffer);
+        MixEngine::Tag prepared = MixEngine::NO_TAG;
+        for (Neighbour* neighbour : {&ahead, &behind}) {
+            if (neighbour->entry == queue.current() && neighbour->path == song_to_play.file_path &&
+                neighbour->tag != MixEngine::NO_TAG) {
+                prepared = neighbour->tag;
+                *neighbour = Neighbour(); // The engine plays it from here on
+            }
+        }
+        bool prefetched = prepared != MixEngine::NO_TAG && engine->is_prepared(prepared);
+        std::string resolved_path;
+        std::unique_ptr<PcmSource> source;
+        mark = stats.lap(PlaybackStage::Take, mark);
+        if (!prefetched) {
+            AssetResolver& resolver = AssetResolver::instance();
+            resolved_path = resolver.resolve(song_to_play.file_path);
+            mark = stats.lap(PlaybackStage::Resolve, mark);
+            source = MixEngine::open_file(resolved_path);
+            if (!source && resolver.invalidate(song_to_play.file_path)) {
+                // The remembered location is stale (file moved or deleted): look again
+                resolved_path = resolver.resolve(song_to_play.file_path);
+                source = MixEngine::open_file(resolved_path);
+            }
+            mark = stats.lap(PlaybackStage::Open, mark);
+        }
+        stats.count_prefetch(prefetched);
+
+        // Play the new song; the old one fades out over a few milliseconds
+        if (prefetched || source) {
+            if (prefetched) {
+                playing_tag = prepared;
+                engine->play(prepared, &first_buffer);
+            } else {
+                playing_tag = next_tag++;
+                engine->play(std::move(source), playing_tag, gain_for(song_to_play), &first_buffer);
+            }
+            mark = stats.lap(PlaybackStage::Start, mark);
+            stats.record(PlaybackStage::Total, requested, mark);
+            auto_advance = true;
+            log_info() << "Playing: " << song_to_play.title << " by " << song_to_play.artist
+                       << (prefetched ? " (prefetched)" : " from " + resolved_path);
         } else {
-            std::cerr << "Error: Could not open audio file: " << resolved_path << std::endl;
-            std::cerr << "  (Tried original path: " << song_to_play.file_path << ")" << std::endl;
+            engine->stop(); // Not the old song under the new one's name
+            playing_tag = MixEngine::NO_TAG;
+            auto_advance = false;
+            log_error() << "Error: Could not open audio file: " << resolved_path;
+            log_error() << "  (Tried original path: " << song_to_play.file_path << ")";
         }
+        arm_neighbours();
+        playback_changed.notify_all();
     } else {
-        std::cout << "Song '" << song_to_play.title << "' has no file path specified. Cannot play." << std::endl;
+        log_info() << "Song '" << song_to_play.title << "' has no file path specified. Cannot play.";
     }
 }
 
 void Playlist::pause() {
-    // Check if we have a valid current song index
-    if (current_song_index < 0 || current_song_index >= static_cast<int>(songs.size())) {
-        std::cout << "No music playing to pause/resume." << std::endl;
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    const Song* song = current_song();
+    if (!song) {
+        log_info() << "No music playing to pause/resume.";
         return;
     }
 
-    if (current_music->getStatus() == sf::Music::Playing) {
-        current_music->pause();
-        std::cout << "Paused: " << songs[current_song_index].title << std::endl;
-    } else if (current_music->getStatus() == sf::Music::Paused) {
-        current_music->play();
-        std::cout << "Resumed: " << songs[current_song_index].title << std::endl;
+    if (engine->is_playing()) {
+        engine->pause();
+        auto_advance = false;
+        log_info() << "Paused: " << song->title;
+    } else if (engine->is_paused()) {
+        engine->resume();
+        auto_advance = true;
+        log_info() << "Resumed: " << song->title;
     } else {
-        std::cout << "No music playing to pause/resume." << std::endl;
+        log_info() << "No music playing to pause/resume.";
     }
+    playback_changed.notify_all();
 }
 
 void Playlist::stop() {
-    current_music->stop();
-    std::cout << "Stopped playback." << std::endl;
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    engine->stop(); // The neighbours stay prepared
+    playing_tag = MixEngine::NO_TAG;
+    auto_advance = false;
+    log_info() << "Stopped playback.";
 }
 
 void Playlist::next_song() {
-    if (songs.empty()) {
-        std::cout << "Playlist is empty. Cannot go to next song." << std::endl;
+    auto requested = PlaybackStats::Clock::now();
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (queue.empty()) {
+        log_info() << "Playlist is empty. Cannot go to next song.";
         return;
     }
-    current_music->stop(); // Stop current song before changing
-    // If no current song is set, start from the beginning
-    if (current_song_index < 0 || current_song_index >= static_cast<int>(songs.size())) {
-        current_song_index = 0;
-    } else {
-        current_song_index = (current_song_index + 1) % songs.size();
-    }
-    play();
+    queue.next(); // From the first song if none is current
+    play_current(requested);
 }
 
 void Playlist::prev_song() {
-    if (songs.empty()) {
-        std::cout << "Playlist is empty. Cannot go to previous song." << std::endl;
+    auto requested = PlaybackStats::Clock::now();
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (queue.empty()) {
+        log_info() << "Playlist is empty. Cannot go to previous song.";
+        return;
+    }
+    // From the last song if none is current
+    if (queue.previous() == PlayQueue::NONE) {
+        log_info() << "No earlier song in the shuffle history.";
         return;
     }
-    current_music->stop(); // Stop current song before changing
-    // If no current song is set, start from the last song
-    if (current_song_index < 0 || current_song_index >= static_cast<int>(songs.size())) {
-        current_song_index = songs.size() - 1;
+    play_current(requested);
+}
+
+void Playlist::set_gapless(bool enabled) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    gapless = enabled;
+    arm_neighbours();
+    playback_changed.notify_all();
+}
+
+bool Playlist::is_gapless() const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return gapless;
+}
+
+void Playlist::set_crossfade(double seconds, FadeCurve curve) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    engine->set_crossfade(seconds, curve);
+    // The engine fades with the setting the next track was queued with
+    engine->clear_queue();
+    arm_neighbours();
+    playback_changed.notify_all();
+}
+
+double Playlist::get_crossfade() const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return engine->get_crossfade();
+}
+
+void Playlist::set_equalizer(const std::vector<double>& gains_db) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    engine->get_equalizer().set_bands(Equalizer::graphic(gains_db)); // Heard from the next chunk on
+}
+
+void Playlist::set_shuffle(bool enabled) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    queue.set_shuffle(enabled);
+    arm_neighbours();
+}
+
+bool Playlist::is_shuffled() const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return queue.is_shuffled();
+}
+
+void Playlist::set_normalized(bool enabled) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    normalized = enabled;
+    if (const Song* song = current_song()) {
+        engine->set_gain(playing_tag, gain_for(*song));
+    }
+    for (const Neighbour* neighbour : {&ahead, &behind}) {
+        if (neighbour->tag != MixEngine::NO_TAG) {
+            engine->set_gain(neighbour->tag, gain_for(songs[neighbour->entry]));
+        }
+    }
+}
+
+bool Playlist::is_normalized() const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return normalized;
+}
+
+void Playlist::apply_loudness(const std::vector<LoudnessResult>& results) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (queue.empty()) {
+        return;
+    }
+    std::unordered_map<PooledPath, const LoudnessResult*, PooledPath::Hash> by_path;
+    for (const LoudnessResult& result : results) {
+        by_path[result.file_path] = &result;
+    }
+    queue.for_each([&](PlayQueue::Entry entry) {
+        Song& song = songs[entry];
+        auto it = by_path.find(song.file_path);
+        if (it == by_path.end()) {
+            return;
+        }
+        song.loudness_lufs = it->second->loudness_lufs;
+        song.true_peak_dbtp = it->second->true_peak_dbtp;
+        if (entry == queue.current()) {
+            engine->set_gain(playing_tag, gain_for(song));
+        }
+        for (const Neighbour* neighbour : {&ahead, &behind}) {
+            if (entry == neighbour->entry && neighbour->tag != MixEngine::NO_TAG) {
+                engine->set_gain(neighbour->tag, gain_for(song));
+            }
+        }
+    });
+}
+
+// ReplayGain as a linear gain. Quiet tracks are left as they are rather
+// than boosted, which could clip their peaks.
+float Playlist::gain_for(const Song& song) const {
+    if (!normalized || !song.has_loudness()) {
+        return 1.0f;
+    }
+    double gain_db = LoudnessMeter::replay_gain_db(song.loudness_lufs, song.true_peak_dbtp);
+    return static_cast<float>(std::min(1.0, std::pow(10.0, gain_db / 20.0)));
+}
+
+size_t Playlist::get_song_count() const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return queue.size();
+}
+
+bool Playlist::get_current_position(Song& song, float& seconds) const {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    const Song* current = current_song();
+    if (!current) {
+        return false;
+    }
+    song = *current;
+    MixEngine::Tag tag;
+    double position;
+    // Until the watcher sees a track change, the engine is ahead of the queue
+    seconds = engine->get_position(tag, position) && tag == playing_tag ? static_cast<float>(position) : 0.0f;
+    return true;
+}
+
+bool Playlist::has_playback_stats() const {
+    return stats.plays() > 0;
+}
+
+void Playlist::show_playback_stats() const {
+    Logger::instance().flush(); // Queued messages go first
+    stats.print(std::cout);
+    MixEngine::Stats mixer = engine->get_stats();
+    std::cout << "Mixer: " << mixer.transitions << " gapless/crossfade transition(s), " << mixer.underruns
+              << " underrun(s) (" << mixer.underrun_frames << " frames of silence), " << mixer.limited_blocks
+              << " limited block(s)" << std::endl;
+}
+
+void Playlist::on_track_started(MixEngine::Tag tag) {
+    if (tag != ahead.tag || tag == MixEngine::NO_TAG) {
+        return;
+    }
+    PlayQueue::Entry entry = ahead.entry;
+    PooledPath path = ahead.path;
+    ahead = Neighbour(); // The engine plays it from here on
+    playing_tag = tag;
+    if (queue.peek_next() == entry) {
+        queue.next(); // Keeps the shuffle history
+    } else if (songs[entry].file_path == path && queue.position_of(entry) < queue.size()) {
+        queue.set_current(entry); // The order changed after it was queued
     } else {
-        current_song_index = (current_song_index - 1 + songs.size()) % songs.size();
+        return; // Removed while queued; it plays out, but isn't in the playlist
+    }
+    const Song& song = songs[entry];
+    log_info() << "Playing: " << song.title << " by " << song.artist;
+    arm_neighbours();
+}
+
+void Playlist::watch_for_track_end() {
+    std::unique_lock<std::mutex> lock(playback_mutex);
+    while (!shutting_down) {
+        if (!auto_advance) {
+            playback_changed.wait(lock);
+            continue;
+        }
+        playback_changed.wait_for(lock, EVENT_POLL_INTERVAL);
+        if (shutting_down || !auto_advance) {
+            continue;
+        }
+        for (const MixEngine::Event& event : engine->poll()) {
+            if (event.type == MixEngine::Event::Started) {
+                on_track_started(event.tag);
+            } else if (event.tag == playing_tag) {
+                // The last track ended with nothing queued
+                engine->stop();
+                playing_tag = MixEngine::NO_TAG;
+                auto_advance = false;
+            }
+        }
     }
-    play();
 }
 
 void Playlist::show_playlist() const {
-    std::cout << "--- Playlist: " << name << " ---" << std::endl;
-    if (songs.empty()) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    Logger::instance().flush(); // Queued messages go first
+    std::cout << "--- Playlist: " << name << (queue.is_shuffled() ? " (shuffle)" : "") << " ---" << std::endl;
+    if (queue.empty()) {
         std::cout << "(empty)" << std::endl;
         return;
     }
-    for (size_t i = 0; i < songs.size(); ++i) {
-        std::cout << "- " << songs[i].title << " by " << songs[i].artist;
-        if (static_cast<int>(i) == current_song_index) {
+    size_t position = 0;
+    queue.for_each([&](PlayQueue::Entry entry) {
+        std::cout << ++position << ". " << songs[entry].title << " by " << songs[entry].artist;
+        if (entry == queue.current()) {
             std::cout << " <-- (current)";
         }
         std::cout << std::endl;
-    }
+    });
     std::cout << "--------------------" << std::endl;
 }
 
 bool Playlist::save_to_file(const std::string& filename) const {
-    if (songs.empty()) {
-        std::cout << "Playlist is empty. Nothing to save." << std::endl;
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (queue.empty()) {
+        log_info() << "Playlist is empty. Nothing to save.";
         return false;
     }
     
-    std::ofstream outfile(filename);
-    if (!outfile.is_open()) {
-        std::cerr << "Error: Could not open file for writing: " << filename << std::endl;
-        std::cerr << "Make sure you have write permissions in the current directory." << std::endl;
+    PlaylistWriter writer;
+    if (!writer.open(filename)) {
+        log_error() << "Error: Could not open file for writing: " << filename;
+        log_error() << "Make sure you have write permissions in the current directory.";
         return false;
     }
 
     int saved_count = 0;
-    for (const Song& song : songs) {
-        // Escape any pipe characters in the data (though unlikely)
-        outfile << song.title << "|" << song.artist << "|" << song.album << "|" 
-                << song.duration_seconds << "|" << song.file_path << std::endl;
+    queue.for_each([&](PlayQueue::Entry entry) {
+        // Pipes and backslashes in the data are escaped by the writer
+        writer.write(songs[entry]);
         saved_count++;
-    }
+    });
     
-    outfile.close();
+    if (!writer.close()) {
+        log_error() << "Error: Failed while writing playlist file: " << filename;
+        return false;
+    }
 
-    std::cout << "Playlist '" << name << "' saved to " << filename << " (" << saved_count << " song(s))" << std::endl;
+    log_info() << "Playlist '" << name << "' saved to " << filename << " (" << saved_count << " song(s))";
     return true;
 }
 
 bool Playlist::load_from_file(const std::string& filename, MusicLibrary& library) {
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Error: Could not open file for reading: " << filename << std::endl;
+    PlaylistReader reader;
+    if (!reader.open(filename)) {
+        log_error() << "Error: Could not open file for reading: " << filename;
         return false;
     }
 
-    songs.clear(); // Clear the current playlist before loading
-    current_song_index = -1; // Reset index
-
-    std::string line;
-    int line_number = 0;
-    int songs_loaded = 0;
+    std::vector<Song> loaded_songs; // Parsed first, then inserted in one pass
+    std::vector<size_t> unresolved; // Positions in loaded_songs with no exact title match
+    PlaylistEntry entry;
     
-    while (std::getline(infile, line)) {
-        line_number++;
-        
-        // Skip empty lines
-        if (line.empty() || line.find_first_not_of(" \t\n\r") == std::string::npos) {
-            continue;
-        }
-        
+    while (true) {
         // Parse the line (title|artist|album|duration|filepath)
-        size_t first_delim = line.find('|');
-        size_t second_delim = line.find('|', first_delim + 1);
-        size_t third_delim = line.find('|', second_delim + 1);
-        size_t fourth_delim = line.find('|', third_delim + 1);
-
-        if (first_delim == std::string::npos || second_delim == std::string::npos || 
-            third_delim == std::string::npos || fourth_delim == std::string::npos) {
-            std::cerr << "Warning: Skipping malformed line " << line_number << " in playlist file: " << line << std::endl;
+        PlaylistReader::Status status = reader.next(entry);
+        if (status == PlaylistReader::Status::End) {
+            break;
+        }
+        if (status == PlaylistReader::Status::Malformed) {
+            log_warning() << "Warning: Skipping malformed line " << reader.line_number() << " in playlist file: " << reader.line();
             continue;
         }
+        if (!entry.duration_valid) {
+            log_warning() << "Warning: Invalid duration on line " << reader.line_number() << ", using 0";
+        }
 
-        try {
-            std::string title = line.substr(0, first_delim);
-            std::string artist = line.substr(first_delim + 1, second_delim - (first_delim + 1));
-            std::string album = line.substr(second_delim + 1, third_delim - (second_delim + 1));
-            
-            // Safely parse duration
-            int duration = 0;
-            try {
-                std::string duration_str = line.substr(third_delim + 1, fourth_delim - (third_delim + 1));
-                if (!duration_str.empty()) {
-                    duration = std::stoi(duration_str);
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "Warning: Invalid duration on line " << line_number << ", using 0" << std::endl;
-            }
-            
-            std::string file_path = line.substr(fourth_delim + 1);
-
-            // Try to find the song in the library first (by title)
-            Song* library_song = library.find_song(title);
-            if (library_song) {
-                // Use the song from library (has correct file path)
-                // Check if already in playlist before adding
-                bool is_duplicate = false;
-                for (const Song& existing_song : songs) {
-                    if (existing_song.title == library_song->title && existing_song.artist == library_song->artist) {
-                        is_duplicate = true;
-                        break;
-                    }
-                }
-                if (!is_duplicate) {
-                    add_song(*library_song);
-                    songs_loaded++;
-                } else {
-                    std::cout << "Skipping duplicate: '" << title << "' by " << artist << std::endl;
-                }
-            } else {
-                // Song not in library, create new one from file
-                // Check if already in playlist before adding
-                bool is_duplicate = false;
-                for (const Song& existing_song : songs) {
-                    if (existing_song.title == title && existing_song.artist == artist) {
-                        is_duplicate = true;
-                        break;
-                    }
-                }
-                if (!is_duplicate) {
-                    Song loaded_song = {title, artist, album, duration, file_path};
-                    add_song(loaded_song);
-                    songs_loaded++;
-                } else {
-                    std::cout << "Skipping duplicate: '" << title << "' by " << artist << std::endl;
-                }
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing line " << line_number << ": " << e.what() << std::endl;
-            continue;
+        // Try to find the song in the library first (by title);
+        // it has the correct file path
+        const Song* library_song = library.find_song(entry.title);
+        if (!library_song) {
+            // Same title up to case, punctuation or spacing
+            library_song = library.find_song_normalized(entry.title);
+        }
+        if (library_song) {
+            loaded_songs.push_back(*library_song);
+        } else {
+            // Song not in library, create new one from file
+            unresolved.push_back(loaded_songs.size());
+            loaded_songs.push_back({entry.title, entry.artist, entry.album, entry.duration_seconds, entry.file_path});
+        }
+    }
+
+    // Titles that were renamed since the playlist was saved: relink them to
+    // the closest library title, on all cores (lookups only read the library)
+    std::vector<const Song*> relinked(unresolved.size(), nullptr);
+    parallel_for(unresolved.size(), [&](size_t i) {
+        relinked[i] = library.find_song_fuzzy(loaded_songs[unresolved[i]].title);
+    });
+    int relinked_count = 0;
+    for (size_t i = 0; i < unresolved.size(); ++i) {
+        if (relinked[i]) {
+            loaded_songs[unresolved[i]] = *relinked[i];
+            relinked_count++;
         }
     }
 
-    if (!songs.empty()) {
-        current_song_index = 0; // Set first song as current after loading
+    int songs_loaded = 0;
+    int duplicates = 0;
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        // Their entries are about to go; the current track plays on
+        aim(ahead, PlayQueue::NONE);
+        aim(behind, PlayQueue::NONE);
+        queue.clear(); // Clear the current playlist before loading
+        songs.clear();
+        song_keys.clear();
+        auto_advance = false;
+
+        songs.reserve(loaded_songs.size());
+        song_keys.reserve(loaded_songs.size());
+        for (Song& song : loaded_songs) {
+            if (contains_song(song.title, song.artist)) {
+                duplicates++;
+                continue;
+            }
+            store_song(queue.push_back(), std::move(song));
+            songs_loaded++;
+        }
+
+        if (!queue.empty()) {
+            queue.set_current(queue.at(0)); // Set first song as current after loading
+        }
+        arm_neighbours();
     }
 
-    std::cout << "Playlist loaded from " << filename << " (" << songs_loaded << " song(s) loaded)" << std::endl;
+    if (relinked_count > 0) {
+        log_info() << "Relinked " << relinked_count << " renamed song(s) to the closest library title";
+    }
+    if (duplicates > 0) {
+        log_info() << "Skipped " << duplicates << " duplicate(s) while loading " << filename;
+    }
+    log_info() << "Playlist loaded from " << filename << " (" << songs_loaded << " song(s) loaded)";
     return true;
-}
\ No newline at end of file
+}
@@ -6,17 +6,30 @@
 #include <vector>
 #include <list>
 #include <memory>
-// Forward declaration to avoid including SFML in header (prevents static init issues)
-namespace sf { class Music; }
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <unordered_map>
+#include "MixEngine.h"
 #include "MusicLibrary.h" // Include MusicLibrary
+#include "PlaybackStats.h"
+#include "PlayQueue.h"
 
 class Playlist {
 public:
-    Playlist(const std::string& name);
+    // With prefetch off, songs are only opened when played: no prefetch
+    // thread, and nothing happens in the background as the queue is edited
+    // (benchmarks)
+    Playlist(const std::string& name, bool prefetch = true);
     ~Playlist(); // Need destructor for unique_ptr
     Playlist(const Playlist&) = delete; // Disable copy
     Playlist& operator=(const Playlist&) = delete; // Disable assignment
     void add_song(const Song& song);
+    void add_song_next(const Song& song); // Right after the current song (and next in shuffle mode)
+    // Positions are 1-based, as numbered by show_playlist()
+    bool remove_song(size_t position);
+    bool move_song(size_t from, size_t to);
     void show_playlist() const;
     void play(); // Modified to handle playback
     void pause();
@@ -25,12 +38,78 @@ public:
     void prev_song();
     bool save_to_file(const std::string& filename) const;
     bool load_from_file(const std::string& filename, MusicLibrary& library);
+    void set_gapless(bool enabled); // Start the next track on the sample after the current one ends
+    bool is_gapless() const;
+    // Fade each track into the next over its last seconds (auto-advance
+    // even when gapless is off); 0 to turn it off
+    void set_crossfade(double seconds, FadeCurve curve);
+    double get_crossfade() const;
+    // Graphic EQ gains in dB at Equalizer::GRAPHIC_FREQUENCIES, applied to
+    // everything played; empty for flat
+    void set_equalizer(const std::vector<double>& gains_db);
+    // Random order without repeats until every song has played; prev_song()
+    // goes back through the songs in the order they were played
+    void set_shuffle(bool enabled);
+    bool is_shuffled() const;
+    // Play every track at the same loudness, from its LoudnessAnalyzer measurement
+    void set_normalized(bool enabled);
+    bool is_normalized() const;
+    void apply_loudness(const std::vector<LoudnessResult>& results); // Updates this playlist's copies
+    size_t get_song_count() const;
+    // The current song and how far into it playback is; false if there is none
+    bool get_current_position(Song& song, float& seconds) const;
+    bool has_playback_stats() const; // True once a track has been started
+    void show_playback_stats() const; // Per-stage latency of every track start so far
 
 private:
     std::string name;
-    std::vector<Song> songs;
-    int current_song_index; // To keep track of the current song
-    std::unique_ptr<sf::Music> current_music; // SFML music object for playback (pointer to delay init)
+    PlayQueue queue; // Play order and the current song, as entries
+    std::vector<Song> songs; // By queue entry; slots of removed entries are reused
+    std::unordered_multimap<uint64_t, PlayQueue::Entry> song_keys; // Hash of (title, artist) -> entry
+    PlaybackStats stats; // Declared before the engine, whose callback records into it until destroyed
+    std::unique_ptr<MixEngine> engine;
+    MixEngine::Tag playing_tag; // The engine's name for the current song's track
+    MixEngine::Tag next_tag;
+
+    // A song next to the current one, opened on the prefetch thread and
+    // decoding in the engine already, so moving to it is a deck hand-over.
+    // Entries are reused, so the path tells whether the entry still holds
+    // that song.
+    struct Neighbour {
+        PlayQueue::Entry entry = PlayQueue::NONE;
+        PooledPath path;
+        MixEngine::Tag tag = MixEngine::NO_TAG; // Prepared in the engine; NO_TAG until opened
+        bool failed = false; // Couldn't be opened; not retried until the neighbour changes
+    };
+    Neighbour ahead; // What next_song() plays; also queued to start on its own when gapless or crossfading
+    Neighbour behind; // What prev_song() plays
+
+    // The end-of-track watcher and the prefetcher run on their own threads,
+    // so everything they touch (queue, songs, engine) is guarded
+    mutable std::mutex playback_mutex;
+    std::condition_variable playback_changed;
+    std::condition_variable prefetch_wanted; // A neighbour needs opening, or shutting down
+    std::thread end_watcher;
+    std::thread prefetcher; // Not started with prefetch off
+    bool gapless;
+    bool normalized;
+    bool auto_advance; // Set while a track plays; pause/stop clear it so only natural ends advance
+    bool shutting_down;
+
+    static uint64_t song_key_hash(PooledString title, PooledString artist);
+    bool contains_song(PooledString title, PooledString artist) const; // O(1) duplicate check
+    void store_song(PlayQueue::Entry entry, Song song); // Indexes a new entry's song; no duplicate check
+    const Song* current_song() const; // nullptr if there is none; playback_mutex must be held
+    void play_current(PlaybackStats::Clock::time_point requested); // playback_mutex must be held
+    float gain_for(const Song& song) const; // Linear playback gain; playback_mutex must be held
+    // Points the neighbours at the songs either side of the current one,
+    // and queues the next one in the engine if it should start on its own;
+    // playback_mutex must be held
+    void arm_neighbours();
+    void aim(Neighbour& neighbour, PlayQueue::Entry entry); // playback_mutex must be held
+    void on_track_started(MixEngine::Tag tag); // playback_mutex must be held
+    void watch_for_track_end();
+    void prefetch_neighbours(); // The prefetch thread: opens neighbours without holding the lock
 };
 
 #endif // PLAYLIST_H
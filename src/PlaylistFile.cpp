@@ -0,0 +1,168 @@
+#include "PlaylistFile.h"
+#include <charconv>
+#include <cstring>
+
+bool PlaylistReader::open(const std::string& filename) {
+    if (!file.open(filename) || !file.map()) {
+        return false;
+    }
+    file.advise(MappedFile::Access::Sequential, true);
+    cursor = reinterpret_cast<const char*>(file.data());
+    end = cursor + file.size();
+    current_line_number = 0;
+    return true;
+}
+
+std::string_view PlaylistReader::field(std::string_view raw, size_t index, bool has_escapes) {
+    if (!has_escapes || raw.find('\\') == std::string_view::npos) {
+        return raw;
+    }
+    std::string& out = scratch[index];
+    out.clear();
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c == '\\' && i + 1 < raw.size()) {
+            char n = raw[i + 1];
+            if (n == '|' || n == '\\') {
+                out += n;
+                i++;
+                continue;
+            }
+            if (n == 'n') {
+                out += '\n';
+                i++;
+                continue;
+            }
+        }
+        out += c;
+    }
+    return out;
+}
+
+PlaylistReader::Status PlaylistReader::next(PlaylistEntry& entry) {
+    while (cursor && cursor < end) {
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        const char* line_end = newline ? newline : end;
+        std::string_view line(cursor, line_end - cursor);
+        cursor = newline ? newline + 1 : end;
+        current_line_number++;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+            continue; // Skip empty lines
+        }
+        current_line = line;
+
+        // Find the four separators, stepping over escaped characters
+        bool has_escapes = std::memchr(line.data(), '\\', line.size()) != nullptr;
+        size_t delims[4];
+        size_t found = 0;
+        for (size_t i = 0; i < line.size() && found < 4; ++i) {
+            if (line[i] == '\\' && has_escapes) {
+                i++;
+            } else if (line[i] == '|') {
+                delims[found++] = i;
+            }
+        }
+        if (found < 4) {
+            return Status::Malformed;
+        }
+
+        entry.title = field(line.substr(0, delims[0]), 0, has_escapes);
+        entry.artist = field(line.substr(delims[0] + 1, delims[1] - delims[0] - 1), 1, has_escapes);
+        entry.album = field(line.substr(delims[1] + 1, delims[2] - delims[1] - 1), 2, has_escapes);
+        std::string_view duration = line.substr(delims[2] + 1, delims[3] - delims[2] - 1);
+        entry.file_path = field(line.substr(delims[3] + 1), 4, has_escapes);
+
+        entry.duration_seconds = 0;
+        entry.duration_valid = true;
+        if (!duration.empty()) {
+            int value = 0;
+            auto result = std::from_chars(duration.data(), duration.data() + duration.size(), value);
+            if (result.ec == std::errc() && result.ptr == duration.data() + duration.size()) {
+                entry.duration_seconds = value;
+            } else {
+                entry.duration_valid = false;
+            }
+        }
+        return Status::Entry;
+    }
+    return Status::End;
+}
+
+PlaylistWriter::PlaylistWriter(size_t buffer_size) : out(nullptr), capacity(buffer_size), failed(false) {
+    buffer.reserve(capacity + 4096);
+}
+
+PlaylistWriter::~PlaylistWriter() {
+    close();
+}
+
+bool PlaylistWriter::open(const std::string& filename) {
+    close();
+    out = std::fopen(filename.c_str(), "wb");
+    failed = (out == nullptr);
+    if (out) {
+        std::setvbuf(out, nullptr, _IONBF, 0); // We do the buffering
+    }
+    return out != nullptr;
+}
+
+void PlaylistWriter::append_escaped(std::string_view text) {
+    if (text.find_first_of("|\\\n") == std::string::npos) {
+        buffer += text;
+        return;
+    }
+    for (char c : text) {
+        if (c == '|' || c == '\\') {
+            buffer += '\\';
+            buffer += c;
+        } else if (c == '\n') {
+            buffer += "\\n";
+        } else {
+            buffer += c;
+        }
+    }
+}
+
+void PlaylistWriter::write(const Song& song) {
+    append_escaped(song.title);
+    buffer += '|';
+    append_escaped(song.artist);
+    buffer += '|';
+    append_escaped(song.album);
+    buffer += '|';
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), song.duration_seconds);
+    buffer.append(digits, result.ptr);
+    buffer += '|';
+    append_escaped(song.file_path.get_directory());
+    append_escaped(song.file_path.get_name());
+    buffer += '\n';
+    if (buffer.size() >= capacity) {
+        flush();
+    }
+}
+
+void PlaylistWriter::flush() {
+    if (out && !buffer.empty()) {
+        if (std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) {
+            failed = true;
+        }
+    }
+    buffer.clear();
+}
+
+bool PlaylistWriter::close() {
+    if (!out) {
+        return !failed;
+    }
+    flush();
+    if (std::fclose(out) != 0) {
+        failed = true;
+    }
+    out = nullptr;
+    return !failed;
+}
@@ -0,0 +1,71 @@
+#ifndef PLAYLIST_FILE_H
+#define PLAYLIST_FILE_H
+
+#include "MappedFile.h"
+#include "Song.h"
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// One line of a playlist file: title|artist|album|duration|path
+// The views point into the mapped file, or into the reader's scratch space
+// for fields that contained escapes; they are valid until the next call to next().
+struct PlaylistEntry {
+    std::string_view title;
+    std::string_view artist;
+    std::string_view album;
+    int duration_seconds = 0;
+    bool duration_valid = true; // false if the duration field wasn't a number (0 is used)
+    std::string_view file_path;
+};
+
+// Streams entries out of a memory-mapped playlist file without copying
+// fields. Inside a field, "\|" is a literal pipe, "\\" a backslash and "\n" a
+// newline; any other backslash is kept as-is, so files written before escaping
+// existed still load the same. The path is everything after the fourth
+// separator. Blank lines are skipped and "\r\n" line endings are accepted.
+class PlaylistReader {
+public:
+    enum class Status { Entry, Malformed, End };
+
+    bool open(const std::string& filename);
+    Status next(PlaylistEntry& entry);
+    size_t line_number() const { return current_line_number; }
+    std::string_view line() const { return current_line; } // Raw text of the last line read
+
+private:
+    MappedFile file;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    size_t current_line_number = 0;
+    std::string_view current_line;
+    std::string scratch[5]; // Unescaped copies, reused from line to line
+
+    std::string_view field(std::string_view raw, size_t index, bool has_escapes);
+};
+
+// Writes playlist lines through one large buffer, escaping separators, and
+// only calls into the C library when the buffer fills up.
+class PlaylistWriter {
+public:
+    explicit PlaylistWriter(size_t buffer_size = 1 << 20);
+    ~PlaylistWriter();
+    PlaylistWriter(const PlaylistWriter&) = delete;
+    PlaylistWriter& operator=(const PlaylistWriter&) = delete;
+
+    bool open(const std::string& filename);
+    void write(const Song& song);
+    bool close(); // Flushes; false if any write failed
+
+private:
+    FILE* out;
+    std::string buffer;
+    size_t capacity;
+    bool failed;
+
+    void append_escaped(std::string_view text);
+    void flush();
+};
+
+#endif // PLAYLIST_FILE_H
@@ -0,0 +1,112 @@
+#include "Resampler.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define RESAMPLER_SSE2 1
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const double KAISER_BETA = 8.0; // About 80 dB of stopband
+// Cutoff as a fraction of the lower Nyquist frequency; the transition band
+// of TAPS taps is centred on it
+static const double CUTOFF = 0.91;
+
+// Zeroth-order modified Bessel function of the first kind, for the window
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+Resampler::Resampler(unsigned input_rate, unsigned output_rate)
+    : input_rate(std::max(1u, input_rate)), output_rate(std::max(1u, output_rate)) {
+    // Cycles per input frame
+    double cutoff = 0.5 * CUTOFF * std::min(1.0, double(this->output_rate) / this->input_rate);
+    table.resize((PHASES + 1) * TAPS * 2);
+    for (size_t phase = 0; phase <= PHASES; ++phase) {
+        double offset = double(phase) / PHASES;
+        double taps[TAPS];
+        double sum = 0;
+        for (size_t j = 0; j < TAPS; ++j) {
+            // Tap j weights the input frame this far before the output's position
+            double distance = offset + double(HALF - 1) - double(j);
+            double x = 2 * cutoff * distance;
+            double sinc = x == 0 ? 1.0 : std::sin(PI * x) / (PI * x);
+            double u = distance / HALF;
+            double window = u * u < 1 ? bessel_i0(KAISER_BETA * std::sqrt(1 - u * u)) / bessel_i0(KAISER_BETA) : 0.0;
+            taps[j] = sinc * window;
+            sum += taps[j];
+        }
+        // Unity gain at DC for every phase
+        float* row = &table[phase * TAPS * 2];
+        for (size_t j = 0; j < TAPS; ++j) {
+            row[2 * j] = row[2 * j + 1] = static_cast<float>(taps[j] / sum);
+        }
+    }
+    reset();
+}
+
+void Resampler::reset() {
+    // History of silence, so the first output is centred on the first input
+    pending.assign((HALF - 1) * 2, 0.0f);
+    position = HALF - 1;
+    fraction = 0;
+}
+
+void Resampler::process(const float* frames, size_t frame_count, std::vector<float>& out) {
+    pending.insert(pending.end(), frames, frames + frame_count * 2);
+    produce(out);
+}
+
+void Resampler::flush(std::vector<float>& out) {
+    pending.insert(pending.end(), HALF * 2, 0.0f);
+    produce(out);
+    reset();
+}
+
+void Resampler::produce(std::vector<float>& out) {
+    size_t available = pending.size() / 2;
+    while (position + HALF < available) {
+        const float* window = &pending[(position - (HALF - 1)) * 2];
+        uint64_t scaled = fraction * PHASES;
+        size_t phase = static_cast<size_t>(scaled / output_rate);
+        float t = float(scaled % output_rate) / float(output_rate);
+        const float* row0 = &table[phase * TAPS * 2];
+        const float* row1 = row0 + TAPS * 2;
+        float left, right;
+#ifdef RESAMPLER_SSE2
+        // Two frames (L R L R) per step against the two rows
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        for (size_t i = 0; i < TAPS * 2; i += 4) {
+            __m128 x = _mm_loadu_ps(window + i);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(x, _mm_loadu_ps(row0 + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(x, _mm_loadu_ps(row1 + i)));
+        }
+        __m128 acc = _mm_add_ps(acc0, _mm_mul_ps(_mm_sub_ps(acc1, acc0), _mm_set1_ps(t)));
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc)); // Lanes 0, 1: left, right
+        left = _mm_cvtss_f32(acc);
+        right = _mm_cvtss_f32(_mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+        float sums0[2] = {}, sums1[2] = {};
+        for (size_t i = 0; i < TAPS * 2; ++i) {
+            sums0[i & 1] += window[i] * row0[i];
+            sums1[i & 1] += window[i] * row1[i];
+        }
+        left = sums0[0] + (sums1[0] - sums0[0]) * t;
+        right = sums0[1] + (sums1[1] - sums0[1]) * t;
+#endif
+        out.push_back(left);
+        out.push_back(right);
+        fraction += input_rate;
+        position += static_cast<size_t>(fraction / output_rate);
+        fraction %= output_rate;
+    }
+    // Keep only the history the next output needs
+    size_t used = std::min(position - (HALF - 1), available);
+    pending.erase(pending.begin(), pending.begin() + used * 2);
+    position -= used;
+}
@@ -0,0 +1,44 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sample-rate conversion of stereo frames by a Kaiser-windowed sinc,
+// stored as a polyphase table: each output frame is the dot product of
+// TAPS input frames with the table rows either side of its fractional
+// position, interpolated between. The cutoff sits below the lower of the
+// two Nyquist frequencies, so downsampling doesn't alias and upsampling
+// leaves no images: about 80 dB of stopband, flat to roughly 18 kHz at
+// 44.1 kHz. The position advances by exact integer steps, so long tracks
+// don't drift. Both channels run in one SSE register, two frames at a time.
+class Resampler {
+public:
+    static constexpr size_t TAPS = 64; // Input frames per output frame
+    static constexpr size_t PHASES = 128; // Table rows per input frame
+
+    Resampler(unsigned input_rate, unsigned output_rate);
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    // Appends to out what frame_count more input frames make; the output
+    // trails the input by TAPS / 2 frames until flush()
+    void process(const float* frames, size_t frame_count, std::vector<float>& out);
+    void flush(std::vector<float>& out); // The rest, at the end of the input
+    void reset();
+
+private:
+    static constexpr size_t HALF = TAPS / 2;
+
+    unsigned input_rate;
+    unsigned output_rate;
+    std::vector<float> table; // PHASES + 1 rows of TAPS taps, each tap twice (left, right)
+    std::vector<float> pending; // Input frames still needed, oldest first
+    size_t position; // Frame in pending the next output falls just after...
+    uint64_t fraction; // ...by fraction / output_rate of a frame
+
+    void produce(std::vector<float>& out);
+};
+
+#endif // RESAMPLER_H
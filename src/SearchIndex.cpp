@@ -0,0 +1,611 @@
+#include "SearchIndex.h"
+#include "FuzzyMatcher.h"
+#include <algorithm>
+
+static const unsigned char WORD_START = 0x01; // Never produced by normalize()
+
+static uint32_t make_key(unsigned char a, unsigned char b, unsigned char c = 0) {
+    return uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16);
+}
+
+// Whole words get a 31-bit FNV-1a hash with the top bit set, which no
+// trigram key has; a collision only makes a list a little longer
+static uint32_t word_key(std::string_view word) {
+    uint32_t hash = 2166136261u;
+    for (char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash | 0x80000000u;
+}
+
+static void split_words(std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t space = text.find(' ', start);
+        if (space == std::string_view::npos) {
+            space = text.size();
+        }
+        words.push_back(text.substr(start, space - start));
+        start = space + 1;
+    }
+}
+
+// True if word occurs in field; at_word_start is set if one occurrence begins a word
+static bool find_word(std::string_view field, std::string_view word, bool& at_word_start) {
+    at_word_start = false;
+    bool found = false;
+    for (size_t pos = field.find(word); pos != std::string_view::npos; pos = field.find(word, pos + 1)) {
+        found = true;
+        if (pos == 0 || field[pos - 1] == ' ') {
+            at_word_start = true;
+            break;
+        }
+    }
+    return found;
+}
+
+// Numbers in titles tell songs apart ("Track 1"/"Track 2", "Op. 27"/"Op. 28"),
+// so a fuzzy match must keep every digit, in order
+static bool same_digits(std::string_view a, std::string_view b) {
+    size_t i = 0;
+    size_t j = 0;
+    while (true) {
+        while (i < a.size() && (a[i] < '0' || a[i] > '9')) {
+            i++;
+        }
+        while (j < b.size() && (b[j] < '0' || b[j] > '9')) {
+            j++;
+        }
+        if (i == a.size() || j == b.size()) {
+            return i == a.size() && j == b.size();
+        }
+        if (a[i++] != b[j++]) {
+            return false;
+        }
+    }
+}
+
+SearchIndex::SearchIndex(const SongStore& store) : store(store), garbage_bytes(0) {}
+
+void SearchIndex::normalize(std::string_view text, std::string& out) {
+    out.clear();
+    bool pending_break = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '\'') {
+            continue; // "Don't" matches "dont"
+        }
+        bool word_char = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+        if (!word_char) {
+            pending_break = true;
+            continue;
+        }
+        if (pending_break && !out.empty()) {
+            out += ' ';
+        }
+        pending_break = false;
+        if (c == 0xC3 && i + 1 < text.size()) {
+            // UTF-8 Latin-1 capitals (U+00C0..U+00DE except the multiplication sign)
+            unsigned char next = static_cast<unsigned char>(text[++i]);
+            if (next >= 0x80 && next <= 0x9E && next != 0x97) {
+                next += 0x20;
+            }
+            out += static_cast<char>(c);
+            out += static_cast<char>(next);
+            continue;
+        }
+        out += static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+    }
+}
+
+void SearchIndex::collect_keys(std::string_view field, std::vector<Key>& keys) {
+    std::vector<std::string_view> words;
+    split_words(field, words);
+    for (std::string_view word : words) {
+        // Trigrams of "\x01word", "\x01w" for one-letter queries and the
+        // whole word for fuzzy matching
+        keys.push_back(word_key(word));
+        unsigned char a = WORD_START;
+        unsigned char b = static_cast<unsigned char>(word[0]);
+        keys.push_back(make_key(a, b));
+        for (size_t i = 1; i < word.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(word[i]);
+            keys.push_back(make_key(a, b, c));
+            a = b;
+            b = c;
+        }
+    }
+}
+
+std::string_view SearchIndex::field(SongId id, int f) const {
+    const TextRef& ref = texts[id];
+    size_t offset = ref.offset;
+    for (int i = 0; i < f; ++i) {
+        offset += ref.length[i];
+    }
+    return std::string_view(text_pool.data() + offset, ref.length[f]);
+}
+
+void SearchIndex::insert(SongId id) {
+    if (texts.size() <= id) {
+        texts.resize(id + 1);
+    }
+    TextRef& ref = texts[id];
+    garbage_bytes += ref.length[0] + ref.length[1] + ref.length[2];
+    ref.offset = static_cast<uint32_t>(text_pool.size());
+
+    const Song& song = store[id];
+    std::string normalized;
+    std::vector<Key> keys;
+    int f = 0;
+    for (PooledString text : {song.title, song.artist, song.album}) {
+        normalize(text, normalized);
+        text_pool += normalized;
+        ref.length[f++] = static_cast<uint32_t>(normalized.size());
+        collect_keys(normalized, keys);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (Key key : keys) {
+        std::vector<SongId>& list = postings[key];
+        if (list.empty() || list.back() < id) {
+            list.push_back(id); // Usual case: IDs only grow
+        } else {
+            auto it = std::lower_bound(list.begin(), list.end(), id);
+            if (it == list.end() || *it != id) {
+                list.insert(it, id);
+            }
+        }
+    }
+}
+
+void SearchIndex::erase(SongId id) {
+    if (texts.size() <= id) {
+        return;
+    }
+    std::vector<Key> keys;
+    for (int f = 0; f < 3; ++f) {
+        collect_keys(field(id, f), keys);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (Key key : keys) {
+        auto entry = postings.find(key);
+        if (entry == postings.end()) {
+            continue;
+        }
+        std::vector<SongId>& list = entry->second;
+        auto it = std::lower_bound(list.begin(), list.end(), id);
+        if (it != list.end() && *it == id) {
+            list.erase(it);
+        }
+        if (list.empty()) {
+            postings.erase(entry);
+        }
+    }
+
+    TextRef& ref = texts[id];
+    garbage_bytes += ref.length[0] + ref.length[1] + ref.length[2];
+    ref = TextRef();
+    if (garbage_bytes > (1u << 20) && garbage_bytes > text_pool.size() / 2) {
+        compact();
+    }
+}
+
+void SearchIndex::compact() {
+    std::string pool;
+    pool.reserve(text_pool.size() - garbage_bytes);
+    for (TextRef& ref : texts) {
+        size_t length = ref.length[0] + ref.length[1] + ref.length[2];
+        size_t offset = pool.size();
+        pool.append(text_pool, ref.offset, length);
+        ref.offset = static_cast<uint32_t>(offset);
+    }
+    text_pool.swap(pool);
+    garbage_bytes = 0;
+}
+
+void SearchIndex::clear() {
+    postings.clear();
+    text_pool.clear();
+    texts.clear();
+    garbage_bytes = 0;
+}
+
+SearchIndex::FlatView SearchIndex::Flat::view() const {
+    FlatView view;
+    view.keys = keys.data();
+    view.list_ends = list_ends.data();
+    view.key_count = keys.size();
+    view.ids = ids.data();
+    view.id_count = ids.size();
+    view.text_lengths = text_lengths.data();
+    view.text = text.data();
+    view.text_size = text.size();
+    view.song_count = song_count;
+    return view;
+}
+
+SearchIndex::Flat SearchIndex::flatten(const std::vector<SongId>& new_ids) const {
+    Flat flat;
+    for (SongId id = 0; id < texts.size() && id < new_ids.size(); ++id) {
+        if (new_ids[id] == INVALID_SONG_ID) {
+            continue;
+        }
+        // Kept songs keep their order, so their text goes in ID order too
+        for (int f = 0; f < 3; ++f) {
+            std::string_view text = field(id, f);
+            flat.text += text;
+            flat.text_lengths.push_back(static_cast<uint32_t>(text.size()));
+        }
+        flat.song_count++;
+    }
+
+    std::vector<Key> keys;
+    keys.reserve(postings.size());
+    for (const auto& entry : postings) {
+        keys.push_back(entry.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (Key key : keys) {
+        for (SongId id : postings.find(key)->second) {
+            if (id < new_ids.size() && new_ids[id] != INVALID_SONG_ID) {
+                flat.ids.push_back(new_ids[id]);
+            }
+        }
+        if (flat.ids.size() > (flat.list_ends.empty() ? 0 : flat.list_ends.back())) {
+            flat.keys.push_back(key);
+            flat.list_ends.push_back(static_cast<uint32_t>(flat.ids.size()));
+        }
+    }
+    return flat;
+}
+
+bool SearchIndex::adopt(const FlatView& flat) {
+    clear();
+    // Everything is checked before use: the file may be corrupt
+    size_t text_size = 0;
+    for (size_t i = 0; i < flat.song_count * 3; ++i) {
+        text_size += flat.text_lengths[i];
+    }
+    bool valid = text_size == flat.text_size && flat.song_count <= store.id_limit() &&
+                 (flat.key_count == 0 || flat.list_ends[flat.key_count - 1] == flat.id_count);
+    for (size_t k = 0, begin = 0; valid && k < flat.key_count; begin = flat.list_ends[k++]) {
+        size_t end = flat.list_ends[k];
+        valid = end > begin && end <= flat.id_count && (k == 0 || flat.keys[k - 1] < flat.keys[k]);
+        for (size_t i = begin; valid && i < end; ++i) {
+            valid = flat.ids[i] < flat.song_count && (i == begin || flat.ids[i - 1] < flat.ids[i]);
+        }
+    }
+    if (!valid) {
+        return false;
+    }
+
+    text_pool.assign(flat.text, flat.text_size);
+    texts.resize(flat.song_count);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < flat.song_count; ++i) {
+        TextRef& ref = texts[i];
+        ref.offset = offset;
+        for (int f = 0; f < 3; ++f) {
+            ref.length[f] = flat.text_lengths[3 * i + f];
+            offset += ref.length[f];
+        }
+    }
+    postings.reserve(flat.key_count);
+    for (size_t k = 0, begin = 0; k < flat.key_count; begin = flat.list_ends[k++]) {
+        postings.emplace(flat.keys[k], std::vector<SongId>(flat.ids + begin, flat.ids + flat.list_ends[k]));
+    }
+    return true;
+}
+
+size_t SearchIndex::memory_bytes() const {
+    size_t bytes = text_pool.capacity() + texts.capacity() * sizeof(TextRef);
+    for (const auto& entry : postings) {
+        // Node, key and vector header, plus the IDs themselves
+        bytes += sizeof(void*) * 2 + sizeof(entry) + entry.second.capacity() * sizeof(SongId);
+    }
+    return bytes + postings.bucket_count() * sizeof(void*);
+}
+
+std::vector<SongId> SearchIndex::candidates(const std::vector<std::string_view>& words) const {
+    std::vector<Key> keys;
+    for (std::string_view word : words) {
+        if (word.size() == 1) {
+            keys.push_back(make_key(WORD_START, word[0]));
+        } else if (word.size() == 2) {
+            keys.push_back(make_key(WORD_START, word[0], word[1]));
+        } else {
+            for (size_t i = 0; i + 2 < word.size(); ++i) {
+                keys.push_back(make_key(word[i], word[i + 1], word[i + 2]));
+            }
+        }
+    }
+    return intersect(keys);
+}
+
+std::vector<SongId> SearchIndex::intersect(std::vector<Key>& keys) const {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<const std::vector<SongId>*> lists;
+    for (Key key : keys) {
+        auto entry = postings.find(key);
+        if (entry == postings.end()) {
+            return {}; // Some key never occurs, nothing can match
+        }
+        lists.push_back(&entry->second);
+    }
+    if (lists.empty()) {
+        return {};
+    }
+
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<SongId>* a, const std::vector<SongId>* b) { return a->size() < b->size(); });
+
+    // Start from the rarest key; every further list can only shrink the set.
+    // Lists far longer than the set barely filter it, and every caller checks
+    // its candidates anyway, so stop there.
+    std::vector<SongId> result(*lists[0]);
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        const std::vector<SongId>& list = *lists[l];
+        if (list.size() / INTERSECT_SKIP_RATIO > result.size()) {
+            break;
+        }
+        auto it = list.begin();
+        size_t kept = 0;
+        for (SongId id : result) {
+            // Gallop: the next match is usually close to the previous one
+            size_t step = 1;
+            while (step < size_t(list.end() - it) && it[step] < id) {
+                step *= 2;
+            }
+            it = std::lower_bound(it + step / 2, it + std::min(step + 1, size_t(list.end() - it)), id);
+            if (it == list.end()) {
+                break;
+            }
+            if (*it == id) {
+                result[kept++] = id;
+            }
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+std::vector<SearchIndex::Result> SearchIndex::search(std::string_view query, size_t limit) const {
+    std::string normalized_query;
+    normalize(query, normalized_query);
+    std::vector<std::string_view> words;
+    split_words(normalized_query, words);
+    if (words.empty() || limit == 0) {
+        return {};
+    }
+
+    struct Ranked {
+        int score;
+        size_t title_length;
+        SongId id;
+    };
+    std::vector<Ranked> ranked;
+    std::string_view fields[3];
+    const int weights[3] = {3, 2, 1}; // Title matches beat artist matches beat album matches
+
+    for (SongId id : candidates(words)) {
+        if (!store.is_live(id)) {
+            continue;
+        }
+        for (int f = 0; f < 3; ++f) {
+            fields[f] = field(id, f);
+        }
+
+        // Trigrams only narrow things down; check each word really occurs
+        int score = 0;
+        bool matched = true;
+        for (std::string_view word : words) {
+            int best = 0;
+            for (int f = 0; f < 3; ++f) {
+                bool at_word_start;
+                if (!find_word(fields[f], word, at_word_start)) {
+                    continue;
+                }
+                if (at_word_start) {
+                    best = std::max(best, weights[f] * 2);
+                } else if (word.size() >= 3) {
+                    best = std::max(best, weights[f]);
+                }
+            }
+            if (best == 0) {
+                matched = false;
+                break;
+            }
+            score += best;
+        }
+        if (!matched) {
+            continue;
+        }
+        if (fields[0] == normalized_query) {
+            score += 1000;
+        } else if (fields[0].compare(0, normalized_query.size(), normalized_query) == 0) {
+            score += 100;
+        }
+        ranked.push_back({score, fields[0].size(), id});
+    }
+
+    // Best score first, then shorter titles (closer matches), then older songs
+    auto better = [](const Ranked& a, const Ranked& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.title_length != b.title_length) return a.title_length < b.title_length;
+        return a.id < b.id;
+    };
+    size_t count = std::min(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+
+    std::vector<Result> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        results.push_back({ranked[i].id, ranked[i].score});
+    }
+    return results;
+}
+
+SongId SearchIndex::find_normalized_title(std::string_view title) const {
+    std::string normalized_title;
+    normalize(title, normalized_title);
+    std::vector<std::string_view> words;
+    split_words(normalized_title, words);
+    if (words.empty()) {
+        return INVALID_SONG_ID;
+    }
+
+    // Only songs having every one of these words can have the same title
+    std::vector<Key> keys;
+    for (std::string_view word : words) {
+        keys.push_back(word_key(word));
+    }
+    for (SongId id : intersect(keys)) {
+        if (store.is_live(id) && field(id, 0) == normalized_title) {
+            return id; // Candidates are in ID order, so this is the oldest
+        }
+    }
+    return INVALID_SONG_ID;
+}
+
+void SearchIndex::segment_keys(std::string_view text, size_t begin, size_t end, std::vector<Key>& keys) {
+    // Keys of the words of text, restricted to trigrams lying inside [begin, end)
+    keys.clear();
+    size_t word_start = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && text[i] != ' ') {
+            continue;
+        }
+        // Word is text[word_start, i)
+        if (word_start >= begin && word_start + 2 <= std::min(i, end)) {
+            keys.push_back(make_key(WORD_START, text[word_start], text[word_start + 1]));
+        }
+        for (size_t p = std::max(word_start, begin); p + 3 <= std::min(i, end); ++p) {
+            keys.push_back(make_key(text[p], text[p + 1], text[p + 2]));
+        }
+        word_start = i + 1;
+    }
+}
+
+size_t SearchIndex::rarest_list_size(const std::vector<Key>& keys) const {
+    if (keys.empty()) {
+        return store.id_limit(); // No keys: every song would be a candidate
+    }
+    size_t rarest = store.id_limit();
+    for (Key key : keys) {
+        auto entry = postings.find(key);
+        if (entry == postings.end()) {
+            return 0;
+        }
+        rarest = std::min(rarest, entry->second.size());
+    }
+    return rarest;
+}
+
+SongId SearchIndex::find_closest_title(std::string_view title) const {
+    std::string normalized_title;
+    normalize(title, normalized_title);
+    const size_t length = normalized_title.size();
+    if (length == 0) {
+        return INVALID_SONG_ID;
+    }
+    const size_t max_distance = std::max<size_t>(1, length / 4);
+
+    // Whole-word lists of the title's distinct words, rarest first; words
+    // the library doesn't have count as empty lists
+    std::vector<std::string_view> words;
+    split_words(normalized_title, words);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    std::vector<const std::vector<SongId>*> word_lists;
+    std::vector<Key> number_keys;
+    for (std::string_view word : words) {
+        auto entry = postings.find(word_key(word));
+        word_lists.push_back(entry != postings.end() ? &entry->second : nullptr);
+        if (word.find_first_not_of("0123456789") == std::string_view::npos) {
+            number_keys.push_back(word_key(word));
+        }
+    }
+    auto list_size = [](const std::vector<SongId>* list) { return list ? list->size() : 0; };
+    std::sort(word_lists.begin(), word_lists.end(),
+              [&](const std::vector<SongId>* a, const std::vector<SongId>* b) { return list_size(a) < list_size(b); });
+
+    FuzzyMatcher matcher(normalized_title);
+    SongId best_id = INVALID_SONG_ID;
+    size_t best_distance = max_distance + 1;
+    auto compare = [&](std::vector<SongId>& found) {
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        for (SongId id : found) {
+            std::string_view candidate = field(id, 0);
+            if (!store.is_live(id) || !same_digits(candidate, normalized_title)) {
+                continue;
+            }
+            // Only a strictly better title can change the answer
+            size_t distance = matcher.distance(candidate, best_distance - 1);
+            if (distance < best_distance) {
+                best_distance = distance;
+                best_id = id;
+                if (distance == 0) {
+                    break;
+                }
+            }
+        }
+    };
+
+    if (!number_keys.empty() && rarest_list_size(number_keys) <= FUZZY_CANDIDATE_BUDGET) {
+        // Numbers have to match, so songs holding all of them are the only candidates
+        std::vector<SongId> found = intersect(number_keys);
+        compare(found);
+        return best_id;
+    }
+
+    for (size_t k = 1; k <= max_distance; ++k) {
+        // Two ways to find every title within k edits, use the cheaper one:
+        // - an edit changes at most two words (a space removed joins two),
+        //   so such a title has one of any 2k + 1 of our words
+        // - cut the title into k + 1 pieces: such a title contains at least
+        //   one of them unchanged, so it has every key of that piece
+        size_t word_cost = FUZZY_CANDIDATE_BUDGET + 1;
+        if (word_lists.size() >= 2 * k + 1) {
+            word_cost = 0;
+            for (size_t w = 0; w < 2 * k + 1; ++w) {
+                word_cost += list_size(word_lists[w]);
+            }
+        }
+        size_t pieces = k + 1;
+        std::vector<std::vector<Key>> piece_keys(pieces);
+        size_t piece_cost = 0; // Songs the rarest key of each piece could bring in
+        for (size_t p = 0; p < pieces; ++p) {
+            segment_keys(normalized_title, length * p / pieces, length * (p + 1) / pieces, piece_keys[p]);
+            piece_cost += rarest_list_size(piece_keys[p]);
+        }
+        if (std::min(word_cost, piece_cost) > FUZZY_CANDIDATE_BUDGET) {
+            break; // Words and pieces too short or too common to narrow things down
+        }
+
+        std::vector<SongId> found;
+        if (word_cost <= piece_cost) {
+            for (size_t w = 0; w < 2 * k + 1; ++w) {
+                if (word_lists[w]) {
+                    found.insert(found.end(), word_lists[w]->begin(), word_lists[w]->end());
+                }
+            }
+        } else {
+            for (std::vector<Key>& keys : piece_keys) {
+                std::vector<SongId> ids = intersect(keys);
+                found.insert(found.end(), ids.begin(), ids.end());
+            }
+        }
+        compare(found);
+        if (best_distance <= k) {
+            return best_id; // Everything within k edits has been compared
+        }
+    }
+    return best_id;
+}
@@ -0,0 +1,112 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "SongStore.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Case-insensitive word-prefix and substring search over title, artist and
+// album. Each field is normalized (ASCII and Latin-1 letters lowercased,
+// punctuation turned into word breaks, apostrophes dropped) and every word is indexed by its trigrams
+// plus a word-start marker, so "\x01" "ka" and "\x01" "k" keys answer short
+// prefix queries; whole words are keys too. A query intersects the posting lists of its keys, smallest
+// first, then checks and scores the songs that are left against a pooled copy
+// of their normalized fields, so nothing is re-normalized per query.
+class SearchIndex {
+public:
+    struct Result {
+        SongId id;
+        int score; // Higher is better
+    };
+
+    // The index laid out flat, as LibraryIndex saves it: key k's songs are
+    // ids[list_ends[k - 1], list_ends[k]) (from 0 for the first key), and
+    // song i's normalized title, artist and album are the next
+    // text_lengths[3i..3i+2] bytes of text
+    struct FlatView {
+        const uint32_t* keys = nullptr; // Ascending
+        const uint32_t* list_ends = nullptr;
+        size_t key_count = 0;
+        const SongId* ids = nullptr; // Ascending within each list
+        size_t id_count = 0;
+        const uint32_t* text_lengths = nullptr;
+        const char* text = nullptr;
+        size_t text_size = 0;
+        size_t song_count = 0;
+    };
+    struct Flat {
+        std::vector<uint32_t> keys, list_ends;
+        std::vector<SongId> ids;
+        std::vector<uint32_t> text_lengths;
+        std::string text;
+        size_t song_count = 0;
+
+        FlatView view() const;
+    };
+
+    explicit SearchIndex(const SongStore& store);
+    void insert(SongId id); // Indexes the song's current fields
+    void erase(SongId id);
+    void clear();
+    // The index with every song renumbered to new_ids[id] (ascending for
+    // the songs kept, INVALID_SONG_ID for songs left out)
+    Flat flatten(const std::vector<SongId>& new_ids) const;
+    // Takes over a flattened index of songs 0..song_count-1 of the store
+    // instead of normalizing and splitting every field again. Returns false
+    // (leaving the index empty) if it is inconsistent.
+    bool adopt(const FlatView& flat);
+    // Every query word must occur in some field; words of three or more
+    // characters match anywhere inside a word, shorter ones only at a word
+    // start. Results are best first.
+    std::vector<Result> search(std::string_view query, size_t limit) const;
+    // The oldest song whose normalized title equals the normalized title
+    // given, e.g. "Way Down We Go" for "way-down we go". INVALID_SONG_ID if none.
+    SongId find_normalized_title(std::string_view title) const;
+    // The song whose normalized title is closest to this one by edit
+    // distance, if it is within max(1, length / 4) edits and has the same
+    // digits (numbers tell songs apart). Titles with numbers are compared
+    // with the songs holding those numbers as words. Otherwise tries one
+    // edit, then two, and so on, each round comparing in full only the songs
+    // that share enough whole words or trigram pieces with the title to be
+    // that close, and stops when the candidates stop being selective.
+    // Safe to call from several threads at once.
+    SongId find_closest_title(std::string_view title) const;
+    size_t key_count() const { return postings.size(); }
+    size_t memory_bytes() const; // Approximate heap use of postings and pooled text
+
+    static void normalize(std::string_view text, std::string& out);
+
+private:
+    using Key = uint32_t; // Up to three bytes, first one in the low byte, or a word hash
+
+    // Where a song's normalized title, artist and album sit in text_pool
+    struct TextRef {
+        uint32_t offset = 0;
+        uint32_t length[3] = {0, 0, 0};
+    };
+
+    const SongStore& store;
+    std::unordered_map<Key, std::vector<SongId>> postings; // Sorted by ID
+    std::string text_pool; // Appended to; erased songs leave garbage until compact()
+    std::vector<TextRef> texts; // By ID
+    size_t garbage_bytes;
+
+    std::string_view field(SongId id, int f) const;
+    static void collect_keys(std::string_view field, std::vector<Key>& keys);
+    static void segment_keys(std::string_view text, size_t begin, size_t end, std::vector<Key>& keys);
+    std::vector<SongId> candidates(const std::vector<std::string_view>& words) const;
+    std::vector<SongId> intersect(std::vector<Key>& keys) const; // Songs that may have every key
+    size_t rarest_list_size(const std::vector<Key>& keys) const; // Upper bound for intersect()
+    void compact();
+
+    // intersect() skips lists this many times longer than its current result
+    static const size_t INTERSECT_SKIP_RATIO = 32;
+    // find_closest_title stops widening once a round could compare more songs than this
+    static const size_t FUZZY_CANDIDATE_BUDGET = 4096;
+};
+
+#endif // SEARCH_INDEX_H
@@ -1,14 +1,26 @@
 #ifndef SONG_H
 #define SONG_H
 
-#include <string>
+#include "StringPool.h"
+#include <limits>
+#include <type_traits>
 
+// Text fields point into the shared StringPool, so a Song is a small record
+// that copies with memcpy and repeated artists, albums and folders are
+// stored once.
 struct Song {
-    std::string title;
-    std::string artist;
-    std::string album;
+    PooledString title;
+    PooledString artist;
+    PooledString album;
     int duration_seconds;
-    std::string file_path;
+    PooledPath file_path;
+    // Filled in by loudness analysis (LoudnessAnalyzer); NaN until then
+    float loudness_lufs = std::numeric_limits<float>::quiet_NaN();
+    float true_peak_dbtp = std::numeric_limits<float>::quiet_NaN();
+
+    bool has_loudness() const { return loudness_lufs == loudness_lufs; }
 };
 
+static_assert(std::is_trivially_copyable<Song>::value, "Song is copied around by value");
+
 #endif // SONG_H
@@ -0,0 +1,98 @@
+#ifndef SONG_STORE_H
+#define SONG_STORE_H
+
+#include "Song.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using SongId = uint32_t; // Position in insertion order, never reused
+const SongId INVALID_SONG_ID = 0xFFFFFFFFu;
+
+// Dense, ID-addressed song storage. Songs are appended into fixed-size chunks
+// so lookups by ID are a shift and a mask, and iteration walks whole
+// contiguous blocks. Removing a song only clears its live flag so IDs stay
+// stable.
+//
+// Copies share chunks, songs and live flags alike, so copying a store costs
+// two pointers per chunk (see LibrarySnapshot). A chunk is copied on the
+// first edit() or removal after it was shared, so a copy never sees later
+// changes; a const Song* stays valid for as long as the store it came from.
+// Appends go into the shared last chunk as they are: a copy never reads past
+// its own id_limit(), so pointers to earlier songs stay valid across inserts.
+class SongStore {
+public:
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS; // Songs per chunk
+
+    SongStore() : count(0), live_count(0) {}
+
+    SongId push_back(const Song& song) {
+        if ((count & (CHUNK_SIZE - 1)) == 0) {
+            chunks.emplace_back(new Song[CHUNK_SIZE]);
+            live.emplace_back(new uint8_t[CHUNK_SIZE]());
+        }
+        SongId id = static_cast<SongId>(count++);
+        // Slots past a copy's count are never read by it, so no own() here
+        chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)] = song;
+        live[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)] = 1;
+        live_count++;
+        return id;
+    }
+
+    const Song& operator[](SongId id) const { return chunks[id >> CHUNK_BITS].get()[id & (CHUNK_SIZE - 1)]; }
+    // For changing a song: copies its chunk first if a copy of the store
+    // still shares it. References from before may then be stale.
+    Song& edit(SongId id) { return own(chunks[id >> CHUNK_BITS])[id & (CHUNK_SIZE - 1)]; }
+
+    bool is_live(SongId id) const { return id < count && live[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)]; }
+    void mark_removed(SongId id) {
+        if (is_live(id)) {
+            own(live[id >> CHUNK_BITS])[id & (CHUNK_SIZE - 1)] = 0;
+            live_count--;
+        }
+    }
+
+    size_t id_limit() const { return count; } // One past the highest ID handed out
+    size_t size() const { return live_count; } // Songs not removed
+
+    // Contiguous block access for sequential scans
+    size_t chunk_count() const { return chunks.size(); }
+    const Song* chunk_data(size_t chunk) const { return chunks[chunk].get(); }
+    size_t chunk_length(size_t chunk) const {
+        return (chunk + 1 < chunks.size()) ? CHUNK_SIZE : count - (chunk << CHUNK_BITS);
+    }
+
+    void clear() {
+        chunks.clear();
+        live.clear();
+        count = 0;
+        live_count = 0;
+    }
+
+private:
+    std::vector<std::shared_ptr<Song[]>> chunks;
+    std::vector<std::shared_ptr<uint8_t[]>> live; // Chunked like the songs
+    size_t count;
+    size_t live_count;
+
+    // The chunk for writing: copied first if a copy of the store shares it
+    template <typename T>
+    static T* own(std::shared_ptr<T[]>& chunk) {
+        if (chunk.use_count() > 1) {
+            std::shared_ptr<T[]> copy(new T[CHUNK_SIZE]);
+            std::copy(chunk.get(), chunk.get() + CHUNK_SIZE, copy.get());
+            chunk = std::move(copy);
+        } else {
+            // Pairs with the release of the last other owner, whose reads
+            // of this chunk must be done before we write to it
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return chunk.get();
+    }
+};
+
+#endif // SONG_STORE_H
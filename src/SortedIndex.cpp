@@ -0,0 +1,275 @@
+#include "SortedIndex.h"
+#include <algorithm>
+#include <atomic>
+
+// Blocks built by insert_batch are filled this far, leaving room for inserts
+static const size_t BATCH_FILL = SortedIndex::BLOCK_SIZE * 3 / 4;
+
+static unsigned char fold(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? u + ('a' - 'A') : u;
+}
+
+static int compare_folded(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = fold(a[i]), y = fold(b[i]);
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+// Compares a_dir + a_name with b_dir + b_name without joining them
+static int compare_joined(std::string_view a_dir, std::string_view a_name, std::string_view b_dir,
+                          std::string_view b_name) {
+    size_t a_size = a_dir.size() + a_name.size(), b_size = b_dir.size() + b_name.size();
+    size_t n = std::min(a_size, b_size);
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = i < a_dir.size() ? a_dir[i] : a_name[i - a_dir.size()];
+        unsigned char y = i < b_dir.size() ? b_dir[i] : b_name[i - b_dir.size()];
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    return a_size == b_size ? 0 : (a_size < b_size ? -1 : 1);
+}
+
+SortedIndex::SortedIndex(const SongStore& store, SortField field) : store(store), field(field) {
+    clear();
+}
+
+SortedIndex::SortedIndex(const SortedIndex& other, const SongStore& store)
+    : store(store), field(other.field), blocks(other.blocks), offsets(other.offsets) {}
+
+void SortedIndex::clear() {
+    blocks.assign(1, std::make_shared<Block>());
+    offsets.assign(2, 0);
+}
+
+SortedIndex::Block& SortedIndex::edit_block(size_t block) {
+    std::shared_ptr<const Block>& shared = blocks[block];
+    if (shared.use_count() > 1) {
+        shared = std::make_shared<Block>(*shared);
+    } else {
+        // Pairs with the release of the last other owner, as SongStore::edit
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    // Only this index holds it now, and blocks are made non-const
+    return const_cast<Block&>(*shared);
+}
+
+bool SortedIndex::less(SongId a, SongId b) const {
+    const Song& x = store[a];
+    const Song& y = store[b];
+    int c = 0;
+    switch (field) {
+    case SortField::Title:
+        c = compare_folded(x.title, y.title);
+        if (c == 0) c = compare_folded(x.artist, y.artist);
+        break;
+    case SortField::Artist:
+        c = compare_folded(x.artist, y.artist);
+        if (c == 0) c = compare_folded(x.album, y.album);
+        if (c == 0) c = compare_folded(x.title, y.title);
+        break;
+    case SortField::Album:
+        c = compare_folded(x.album, y.album);
+        if (c == 0) c = compare_folded(x.artist, y.artist);
+        if (c == 0) c = compare_folded(x.title, y.title);
+        break;
+    case SortField::Path:
+        c = compare_joined(x.file_path.get_directory(), x.file_path.get_name(), y.file_path.get_directory(),
+                           y.file_path.get_name());
+        break;
+    }
+    return c != 0 ? c < 0 : a < b;
+}
+
+int SortedIndex::compare_prefix(SongId id, std::string_view prefix) const {
+    const Song& song = store[id];
+    std::string_view text;
+    switch (field) {
+    case SortField::Title:
+        text = song.title;
+        break;
+    case SortField::Artist:
+        text = song.artist;
+        break;
+    case SortField::Album:
+        text = song.album;
+        break;
+    case SortField::Path: {
+        std::string_view directory = song.file_path.get_directory(), name = song.file_path.get_name();
+        if (directory.size() >= prefix.size()) {
+            return compare_joined(directory.substr(0, prefix.size()), "", prefix, "");
+        }
+        return compare_joined(directory, name.substr(0, prefix.size() - directory.size()), prefix, "");
+    }
+    }
+    return compare_folded(text.substr(0, prefix.size()), prefix);
+}
+
+size_t SortedIndex::block_for(SongId id) const {
+    // The first block whose last ID sorts after id, else the last block
+    size_t low = 0, high = blocks.size() - 1;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (less(blocks[mid]->back(), id)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void SortedIndex::update_offsets(size_t from_block) {
+    offsets.resize(blocks.size() + 1);
+    for (size_t b = from_block; b < blocks.size(); ++b) {
+        offsets[b + 1] = offsets[b] + blocks[b]->size();
+    }
+}
+
+void SortedIndex::split_block(size_t block) {
+    Block& full = edit_block(block);
+    auto upper = std::make_shared<Block>(full.begin() + full.size() / 2, full.end());
+    full.resize(full.size() / 2);
+    blocks.insert(blocks.begin() + block + 1, std::move(upper));
+    update_offsets(block);
+}
+
+void SortedIndex::insert(SongId id) {
+    size_t b = blocks[0]->empty() ? 0 : block_for(id);
+    Block& block = edit_block(b);
+    block.insert(std::lower_bound(block.begin(), block.end(), id, [this](SongId a, SongId x) { return less(a, x); }),
+                 id);
+    if (block.size() > BLOCK_SIZE) {
+        split_block(b);
+    } else {
+        for (size_t i = b + 1; i < offsets.size(); ++i) {
+            offsets[i]++;
+        }
+    }
+}
+
+void SortedIndex::insert_batch(std::vector<SongId> ids) {
+    // One by one costs log(n) + a block move each; a merge costs n in all
+    if (ids.size() * 16 < size()) {
+        for (SongId id : ids) {
+            insert(id);
+        }
+        return;
+    }
+    auto order = [this](SongId a, SongId b) { return less(a, b); };
+    std::sort(ids.begin(), ids.end(), order);
+    std::vector<SongId> existing;
+    existing.reserve(size());
+    for (const std::shared_ptr<const Block>& block : blocks) {
+        existing.insert(existing.end(), block->begin(), block->end());
+    }
+    std::vector<SongId> merged(existing.size() + ids.size());
+    std::merge(existing.begin(), existing.end(), ids.begin(), ids.end(), merged.begin(), order);
+    fill_blocks(merged.data(), merged.size());
+}
+
+void SortedIndex::fill_blocks(const SongId* ids, size_t count) {
+    blocks.clear();
+    for (size_t i = 0; i < count; i += BATCH_FILL) {
+        blocks.push_back(std::make_shared<Block>(ids + i, ids + std::min(count, i + BATCH_FILL)));
+    }
+    if (blocks.empty()) {
+        blocks.push_back(std::make_shared<Block>());
+    }
+    offsets.assign(1, 0);
+    update_offsets(0);
+}
+
+bool SortedIndex::adopt(const SongId* ids, size_t count) {
+    clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (!store.is_live(ids[i]) || (i > 0 && !less(ids[i - 1], ids[i]))) {
+            return false;
+        }
+    }
+    fill_blocks(ids, count);
+    return true;
+}
+
+bool SortedIndex::erase(SongId id) {
+    if (blocks[0]->empty()) {
+        return false;
+    }
+    size_t b = block_for(id);
+    const Block& found = *blocks[b];
+    auto it = std::lower_bound(found.begin(), found.end(), id, [this](SongId a, SongId x) { return less(a, x); });
+    if (it == found.end() || *it != id) {
+        return false;
+    }
+    size_t i = it - found.begin();
+    Block& block = edit_block(b);
+    block.erase(block.begin() + i);
+    if (block.empty() && blocks.size() > 1) {
+        blocks.erase(blocks.begin() + b);
+        update_offsets(b);
+    } else {
+        for (size_t i = b + 1; i < offsets.size(); ++i) {
+            offsets[i]--;
+        }
+    }
+    return true;
+}
+
+SongId SortedIndex::at(size_t position) const {
+    if (position >= size()) {
+        return INVALID_SONG_ID;
+    }
+    size_t b = std::upper_bound(offsets.begin(), offsets.end(), position) - offsets.begin() - 1;
+    return (*blocks[b])[position - offsets[b]];
+}
+
+std::vector<SongId> SortedIndex::range(size_t begin, size_t end) const {
+    std::vector<SongId> ids;
+    end = std::min(end, size());
+    if (begin >= end) {
+        return ids;
+    }
+    ids.reserve(end - begin);
+    size_t b = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+    for (size_t i = begin - offsets[b]; ids.size() < end - begin; i = 0, ++b) {
+        const Block& block = *blocks[b];
+        size_t take = std::min(block.size() - i, end - begin - ids.size());
+        ids.insert(ids.end(), block.begin() + i, block.begin() + i + take);
+    }
+    return ids;
+}
+
+size_t SortedIndex::position_where(std::string_view prefix, bool past_matches) const {
+    // Songs before the position compare below the prefix (or equal to it,
+    // when past_matches)
+    auto before = [&](SongId id) {
+        int c = compare_prefix(id, prefix);
+        return c < 0 || (past_matches && c == 0);
+    };
+    if (blocks[0]->empty()) {
+        return 0;
+    }
+    size_t low = 0, high = blocks.size() - 1;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (before(blocks[mid]->back())) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    const Block& block = *blocks[low];
+    size_t i = std::partition_point(block.begin(), block.end(), before) - block.begin();
+    return offsets[low] + i;
+}
+
+void SortedIndex::prefix_range(std::string_view prefix, size_t& begin, size_t& end) const {
+    begin = position_where(prefix, false);
+    end = position_where(prefix, true);
+}
@@ -0,0 +1,73 @@
+#ifndef SORTED_INDEX_H
+#define SORTED_INDEX_H
+
+#include "SongStore.h"
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+enum class SortField {
+    Title, // Then artist
+    Artist, // Then album, then title
+    Album, // Then artist, then title
+    Path
+};
+
+// Song IDs of a SongStore kept sorted by one field, for browsing the
+// library in order a page at a time. Text fields sort ignoring ASCII case,
+// paths byte by byte; songs that compare equal keep ID order. The IDs are
+// held in blocks of up to BLOCK_SIZE with each block's starting position,
+// so an insert or erase moves at most one block's worth of IDs and finding
+// position N is a binary search over the blocks, not a walk from the start.
+// Copies share blocks until one side changes them, so copying an index
+// costs a pointer and an offset per block.
+// A song must be erased before its fields change and re-inserted after.
+class SortedIndex {
+public:
+    static const size_t BLOCK_SIZE = 512;
+
+    SortedIndex(const SongStore& store, SortField field);
+    // A copy of other over store, which must hold the same sort keys (a
+    // copy of other's store, say). Shares other's blocks.
+    SortedIndex(const SortedIndex& other, const SongStore& store);
+    void insert(SongId id);
+    // Many songs at once: merged in one pass when that beats inserting them
+    // one by one. ids may be in any order.
+    void insert_batch(std::vector<SongId> ids);
+    // Takes over songs already in this index's order (as range() lists
+    // them, say from a saved library) instead of sorting them; checking
+    // the order costs a comparison per song. Returns false (leaving the
+    // index empty) if they aren't live songs in strictly ascending order.
+    bool adopt(const SongId* ids, size_t count);
+    bool erase(SongId id); // Returns false if the song was not indexed
+    void clear();
+    size_t size() const { return offsets.empty() ? 0 : offsets.back(); }
+
+    SongId at(size_t position) const; // INVALID_SONG_ID past the end
+    // IDs at positions [begin, end), in order
+    std::vector<SongId> range(size_t begin, size_t end) const;
+    // Positions [begin, end) of the songs whose field starts with prefix
+    void prefix_range(std::string_view prefix, size_t& begin, size_t& end) const;
+
+private:
+    const SongStore& store;
+    SortField field;
+    using Block = std::vector<SongId>;
+
+    std::vector<std::shared_ptr<const Block>> blocks; // Never empty ones, except a lone first block
+    std::vector<size_t> offsets; // Position of each block's first ID, then size()
+
+    Block& edit_block(size_t block); // For writing: copied first if a copy of the index shares it
+
+    bool less(SongId a, SongId b) const; // The full sort order, ID last
+    // Sign of field(id)'s first prefix.size() characters compared to prefix
+    int compare_prefix(SongId id, std::string_view prefix) const;
+    size_t block_for(SongId id) const; // The block id belongs in
+    size_t position_where(std::string_view prefix, bool past_matches) const;
+    void update_offsets(size_t from_block);
+    void split_block(size_t block);
+    void fill_blocks(const SongId* ids, size_t count); // Replaces the contents, leaving room in each block
+};
+
+#endif // SORTED_INDEX_H
@@ -0,0 +1,92 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Fixed-capacity queue between exactly one producer thread and one consumer
+// thread, with no locks and no allocation after construction, so the
+// audio callback can use either end. Each side owns one index and only
+// reads the other's, keeping its own cached copy so it touches the other
+// side's cache line only when it looks full (or empty). Capacity is rounded
+// up to a power of two.
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "items are copied in bulk");
+
+public:
+    explicit SpscRing(size_t min_capacity) {
+        capacity = 1;
+        while (capacity < min_capacity) {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        items.reset(new T[capacity]);
+    }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t get_capacity() const { return capacity; }
+
+    // Producer: copies up to count items in; returns how many fit
+    size_t push(const T* data, size_t count) {
+        size_t tail = write_index.load(std::memory_order_relaxed);
+        if (capacity - (tail - producer_read_cache) < count) {
+            producer_read_cache = read_index.load(std::memory_order_acquire);
+        }
+        count = std::min(count, capacity - (tail - producer_read_cache));
+        copy_in(tail, data, count);
+        write_index.store(tail + count, std::memory_order_release);
+        return count;
+    }
+    bool push(const T& item) { return push(&item, 1) == 1; }
+    size_t write_available() const {
+        return capacity - (write_index.load(std::memory_order_relaxed) - read_index.load(std::memory_order_acquire));
+    }
+
+    // Consumer: copies up to count items out; returns how many there were
+    size_t pop(T* out, size_t count) {
+        size_t head = read_index.load(std::memory_order_relaxed);
+        if (consumer_write_cache - head < count) {
+            consumer_write_cache = write_index.load(std::memory_order_acquire);
+        }
+        count = std::min(count, consumer_write_cache - head);
+        copy_out(head, out, count);
+        read_index.store(head + count, std::memory_order_release);
+        return count;
+    }
+    bool pop(T& item) { return pop(&item, 1) == 1; }
+    size_t read_available() const {
+        return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t LINE = 64; // Keeps the two sides' indexes off each other's cache line
+
+    std::unique_ptr<T[]> items;
+    size_t capacity;
+    size_t mask;
+    // Indexes count up forever; an item's slot is its index & mask
+    alignas(LINE) std::atomic<size_t> write_index{0};
+    size_t producer_read_cache = 0; // Producer's last look at read_index
+    alignas(LINE) std::atomic<size_t> read_index{0};
+    size_t consumer_write_cache = 0; // Consumer's last look at write_index
+
+    void copy_in(size_t index, const T* data, size_t count) {
+        size_t start = index & mask;
+        size_t first = std::min(count, capacity - start);
+        std::copy(data, data + first, items.get() + start);
+        std::copy(data + first, data + count, items.get());
+    }
+    void copy_out(size_t index, T* out, size_t count) const {
+        size_t start = index & mask;
+        size_t first = std::min(count, capacity - start);
+        std::copy(items.get() + start, items.get() + start + first, out);
+        std::copy(items.get(), items.get() + (count - first), out + first);
+    }
+};
+
+#endif // SPSC_RING_H
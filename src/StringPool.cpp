@@ -0,0 +1,142 @@
+#include "StringPool.h"
+#include "TitleIndex.h"
+
+// Length prefix, then the empty string's terminator
+alignas(uint32_t) static const char EMPTY_ENTRY[sizeof(uint32_t) + 1] = {0, 0, 0, 0, 0};
+
+StringPool& StringPool::instance() {
+    static StringPool pool;
+    return pool;
+}
+
+const char* StringPool::empty_string() {
+    return EMPTY_ENTRY + sizeof(uint32_t);
+}
+
+StringPool::StringPool() : chunk_bytes(0), cursor(nullptr), remaining(0), slots(MIN_CAPACITY, Slot{0, nullptr}), count(0) {
+}
+
+uint64_t StringPool::hash_of(std::string_view text) {
+    uint64_t hash = TitleIndex::hash_title(text.data(), text.size());
+    return hash == 0 ? 1 : hash; // 0 marks an empty slot
+}
+
+const char* StringPool::find_locked(std::string_view text, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t pos = hash & mask; slots[pos].hash != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].hash == hash && length_of(slots[pos].text) == text.size() &&
+            std::memcmp(slots[pos].text, text.data(), text.size()) == 0) {
+            return slots[pos].text;
+        }
+    }
+    return nullptr;
+}
+
+const char* StringPool::intern(std::string_view text) {
+    if (text.empty()) {
+        return empty_string();
+    }
+    uint64_t hash = hash_of(text);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const char* existing = find_locked(text, hash)) {
+        return existing;
+    }
+    if ((count + 1) * 100 > slots.size() * MAX_LOAD_PERCENT) {
+        grow();
+    }
+    const char* stored = store(text);
+    size_t mask = slots.size() - 1;
+    size_t pos = hash & mask;
+    while (slots[pos].hash != 0) {
+        pos = (pos + 1) & mask;
+    }
+    slots[pos].hash = hash;
+    slots[pos].text = stored;
+    count++;
+    return stored;
+}
+
+const char* StringPool::find(std::string_view text) const {
+    if (text.empty()) {
+        return empty_string();
+    }
+    uint64_t hash = hash_of(text);
+    std::lock_guard<std::mutex> lock(mutex);
+    return find_locked(text, hash);
+}
+
+const char* StringPool::store(std::string_view text) {
+    // Length prefix, bytes, terminator, padded so the next prefix is aligned
+    size_t needed = sizeof(uint32_t) + text.size() + 1;
+    needed = (needed + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    if (needed > remaining) {
+        size_t size = needed > CHUNK_SIZE ? needed : CHUNK_SIZE;
+        chunks.emplace_back(new char[size]);
+        chunk_bytes += size;
+        cursor = chunks.back().get();
+        remaining = size;
+    }
+    uint32_t length = static_cast<uint32_t>(text.size());
+    std::memcpy(cursor, &length, sizeof(length));
+    char* stored = cursor + sizeof(uint32_t);
+    std::memcpy(stored, text.data(), text.size());
+    stored[text.size()] = '\0';
+    cursor += needed;
+    remaining -= needed;
+    return stored;
+}
+
+void StringPool::grow() {
+    std::vector<Slot> old_slots;
+    old_slots.swap(slots);
+    slots.assign(old_slots.size() * 2, Slot{0, nullptr});
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old_slots) {
+        if (slot.hash == 0) {
+            continue;
+        }
+        size_t pos = slot.hash & mask;
+        while (slots[pos].hash != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = slot;
+    }
+}
+
+size_t StringPool::string_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+size_t StringPool::memory_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return chunk_bytes + slots.capacity() * sizeof(Slot) + chunks.capacity() * sizeof(chunks[0]);
+}
+
+bool PooledPath::find(std::string_view path, PooledPath& out) {
+    size_t split = split_point(path);
+    const char* directory = StringPool::instance().find(path.substr(0, split));
+    const char* name = directory ? StringPool::instance().find(path.substr(split)) : nullptr;
+    if (!name) {
+        return false;
+    }
+    out.directory = PooledString::from_pooled(directory);
+    out.name = PooledString::from_pooled(name);
+    return true;
+}
+
+std::string PooledPath::str() const {
+    std::string path;
+    path.reserve(size());
+    path.append(directory.data(), directory.size());
+    path.append(name.data(), name.size());
+    return path;
+}
+
+bool PooledPath::starts_with(std::string_view prefix) const {
+    std::string_view dir = directory.view();
+    if (prefix.size() <= dir.size()) {
+        return dir.substr(0, prefix.size()) == prefix;
+    }
+    return prefix.substr(0, dir.size()) == dir && name.view().substr(0, prefix.size() - dir.size()) == prefix.substr(dir.size());
+}
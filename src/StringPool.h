@@ -0,0 +1,158 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process-wide store of interned strings. Every distinct string is copied
+// once into an append-only arena (NUL-terminated, 4-byte length in front) and
+// never freed, so a pointer to it stays valid for the life of the program and
+// two interned strings are equal exactly when their pointers are. Songs keep
+// such pointers instead of std::strings, which stores "Unknown Artist" or a
+// shared directory once however many songs use it.
+class StringPool {
+public:
+    static StringPool& instance();
+
+    // The pooled copy of text, added if it isn't there yet. Thread-safe.
+    const char* intern(std::string_view text);
+    // The pooled copy if there is one, nullptr otherwise. Never adds.
+    const char* find(std::string_view text) const;
+
+    size_t string_count() const;
+    size_t memory_bytes() const; // Arena chunks plus the lookup table
+
+    static size_t length_of(const char* pooled) {
+        uint32_t length;
+        std::memcpy(&length, pooled - sizeof(uint32_t), sizeof(length));
+        return length;
+    }
+    static const char* empty_string(); // The pooled "", without taking the lock
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+private:
+    struct Slot {
+        uint64_t hash; // 0 = empty
+        const char* text;
+    };
+
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static const size_t MIN_CAPACITY = 1024;
+    static const size_t MAX_LOAD_PERCENT = 70;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunk_bytes; // Total capacity of chunks
+    char* cursor; // Free space in the last chunk
+    size_t remaining;
+    std::vector<Slot> slots; // Open addressing, linear probing
+    size_t count;
+
+    StringPool();
+    static uint64_t hash_of(std::string_view text);
+    const char* find_locked(std::string_view text, uint64_t hash) const;
+    const char* store(std::string_view text);
+    void grow();
+};
+
+// A pointer to a pooled string. Trivially copyable, one word, compares equal
+// to another PooledString by pointer. Converts from any string (interning it)
+// and to std::string_view.
+class PooledString {
+public:
+    PooledString() : text(StringPool::empty_string()) {}
+    PooledString(std::string_view s) : text(StringPool::instance().intern(s)) {}
+    PooledString(const std::string& s) : PooledString(std::string_view(s)) {}
+    PooledString(const char* s) : PooledString(std::string_view(s)) {}
+
+    // Wraps an already pooled pointer, e.g. one from StringPool::find
+    static PooledString from_pooled(const char* pooled) {
+        PooledString s;
+        s.text = pooled;
+        return s;
+    }
+
+    const char* data() const { return text; }
+    const char* c_str() const { return text; }
+    size_t size() const { return StringPool::length_of(text); }
+    bool empty() const { return size() == 0; }
+    std::string_view view() const { return std::string_view(text, size()); }
+    std::string str() const { return std::string(text, size()); }
+    operator std::string_view() const { return view(); }
+
+    bool operator==(PooledString other) const { return text == other.text; }
+    bool operator!=(PooledString other) const { return text != other.text; }
+    bool operator==(std::string_view other) const { return view() == other; }
+    bool operator!=(std::string_view other) const { return view() != other; }
+    bool operator==(const std::string& other) const { return view() == other; }
+    bool operator!=(const std::string& other) const { return view() != other; }
+    bool operator==(const char* other) const { return view() == other; }
+    bool operator!=(const char* other) const { return view() != other; }
+
+private:
+    const char* text;
+};
+
+inline std::ostream& operator<<(std::ostream& os, PooledString s) {
+    return os << s.view();
+}
+
+// A file path stored as a pooled directory (up to and including the last
+// separator) and a pooled file name, so songs in one folder share the
+// directory string.
+class PooledPath {
+public:
+    PooledPath() = default;
+    PooledPath(std::string_view path) {
+        size_t split = split_point(path);
+        directory = PooledString(path.substr(0, split));
+        name = PooledString(path.substr(split));
+    }
+    PooledPath(const std::string& path) : PooledPath(std::string_view(path)) {}
+    PooledPath(const char* path) : PooledPath(std::string_view(path)) {}
+
+    // The pooled form of path if both halves are already pooled. Never adds,
+    // so looking up a path that was never stored doesn't grow the pool.
+    static bool find(std::string_view path, PooledPath& out);
+
+    PooledString get_directory() const { return directory; }
+    PooledString get_name() const { return name; }
+    size_t size() const { return directory.size() + name.size(); }
+    bool empty() const { return directory.empty() && name.empty(); }
+    std::string str() const;
+    bool starts_with(std::string_view prefix) const;
+
+    bool operator==(const PooledPath& other) const { return directory == other.directory && name == other.name; }
+    bool operator!=(const PooledPath& other) const { return !(*this == other); }
+
+    struct Hash {
+        size_t operator()(const PooledPath& path) const {
+            uint64_t h = reinterpret_cast<uintptr_t>(path.directory.data()) * 0x9e3779b97f4a7c15ULL;
+            return static_cast<size_t>(h ^ (reinterpret_cast<uintptr_t>(path.name.data()) + (h >> 29)));
+        }
+    };
+
+private:
+    PooledString directory;
+    PooledString name;
+
+    static size_t split_point(std::string_view path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string_view::npos ? 0 : slash + 1;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const PooledPath& path) {
+    return os << path.get_directory() << path.get_name();
+}
+
+#endif // STRING_POOL_H
@@ -0,0 +1,182 @@
+#include "TitleIndex.h"
+#include <cstring>
+
+TitleIndex::TitleIndex(const SongStore& store) : store(store), slots(MIN_CAPACITY), count(0), mask(MIN_CAPACITY - 1) {
+    for (Slot& slot : slots) {
+        slot.hash = 0;
+    }
+}
+
+// MurmurHash64A. Reads the title eight bytes at a time, so every character
+// (and its position) affects the result - unlike a plain character sum,
+// where "Dark Age" and "Age Dark" land in the same bucket.
+uint64_t TitleIndex::hash_title(const char* data, size_t length) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (length * m);
+
+    const char* end = data + (length & ~static_cast<size_t>(7));
+    for (const char* p = data; p != end; p += 8) {
+        uint64_t k;
+        std::memcpy(&k, p, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    const unsigned char* tail = reinterpret_cast<const unsigned char*>(end);
+    switch (length & 7) {
+    case 7: h ^= static_cast<uint64_t>(tail[6]) << 48; // fall through
+    case 6: h ^= static_cast<uint64_t>(tail[5]) << 40; // fall through
+    case 5: h ^= static_cast<uint64_t>(tail[4]) << 32; // fall through
+    case 4: h ^= static_cast<uint64_t>(tail[3]) << 24; // fall through
+    case 3: h ^= static_cast<uint64_t>(tail[2]) << 16; // fall through
+    case 2: h ^= static_cast<uint64_t>(tail[1]) << 8;  // fall through
+    case 1: h ^= static_cast<uint64_t>(tail[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h == 0 ? 1 : h; // 0 is reserved for empty slots
+}
+
+void TitleIndex::place(uint64_t hash, SongId id) {
+    size_t pos = hash & mask;
+    while (slots[pos].hash != 0) {
+        pos = (pos + 1) & mask;
+    }
+    slots[pos].hash = hash;
+    slots[pos].id = id;
+}
+
+void TitleIndex::rehash(size_t new_capacity) {
+    std::vector<Slot> old_slots(new_capacity);
+    old_slots.swap(slots);
+    for (Slot& slot : slots) {
+        slot.hash = 0;
+    }
+    mask = new_capacity - 1;
+
+    // Walk from the start of a cluster so equal titles keep their insertion
+    // order (find returns the oldest one, like the old bucket lists did)
+    size_t start = 0;
+    while (start < old_slots.size() && old_slots[start].hash != 0) {
+        start++;
+    }
+    for (size_t i = 0; i < old_slots.size(); ++i) {
+        const Slot& slot = old_slots[(start + i) % old_slots.size()];
+        if (slot.hash != 0) {
+            place(slot.hash, slot.id);
+        }
+    }
+}
+
+void TitleIndex::reserve(size_t song_count) {
+    size_t needed = MIN_CAPACITY;
+    while (needed * MAX_LOAD_PERCENT < song_count * 100) {
+        needed *= 2;
+    }
+    if (needed > slots.size()) {
+        rehash(needed);
+    }
+}
+
+bool TitleIndex::adopt(const Slot* table, size_t capacity, size_t song_count) {
+    if (capacity < MIN_CAPACITY || (capacity & (capacity - 1)) != 0 ||
+        song_count * 100 > capacity * MAX_LOAD_PERCENT) {
+        return false;
+    }
+    size_t occupied = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        if (table[i].hash != 0) {
+            if (!store.is_live(table[i].id)) {
+                return false;
+            }
+            occupied++;
+        }
+    }
+    if (occupied != song_count) {
+        return false;
+    }
+    slots.assign(table, table + capacity);
+    count = song_count;
+    mask = capacity - 1;
+    return true;
+}
+
+void TitleIndex::insert(SongId id) {
+    if ((count + 1) * 100 > slots.size() * MAX_LOAD_PERCENT) {
+        rehash(slots.size() * 2);
+    }
+    PooledString title = store[id].title;
+    place(hash_title(title.data(), title.size()), id);
+    count++;
+}
+
+SongId TitleIndex::find(std::string_view title) const {
+    uint64_t hash = hash_title(title.data(), title.size());
+    for (size_t pos = hash & mask; slots[pos].hash != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].hash == hash && store[slots[pos].id].title == title) {
+            return slots[pos].id;
+        }
+    }
+    return INVALID_SONG_ID;
+}
+
+bool TitleIndex::erase(SongId id) {
+    PooledString title = store[id].title;
+    uint64_t hash = hash_title(title.data(), title.size());
+    for (size_t pos = hash & mask; slots[pos].hash != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].id == id) {
+            erase_at(pos);
+            return true;
+        }
+    }
+    return false;
+}
+
+SongId TitleIndex::erase_title(const std::string& title) {
+    uint64_t hash = hash_title(title.data(), title.size());
+    for (size_t pos = hash & mask; slots[pos].hash != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].hash == hash && store[slots[pos].id].title == title) {
+            SongId removed = slots[pos].id;
+            erase_at(pos);
+            return removed;
+        }
+    }
+    return INVALID_SONG_ID;
+}
+
+void TitleIndex::erase_at(size_t hole) {
+    // Backward-shift deletion: pull later members of the cluster into the
+    // hole unless their home slot lies cyclically in (hole, next]
+    size_t next = hole;
+    while (true) {
+        next = (next + 1) & mask;
+        if (slots[next].hash == 0) {
+            break;
+        }
+        size_t home = slots[next].hash & mask;
+        bool stays = (hole <= next) ? (hole < home && home <= next)
+                                    : (hole < home || home <= next);
+        if (!stays) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+    slots[hole].hash = 0;
+    count--;
+}
+
+void TitleIndex::clear() {
+    std::vector<Slot>(MIN_CAPACITY).swap(slots);
+    for (Slot& slot : slots) {
+        slot.hash = 0;
+    }
+    count = 0;
+    mask = MIN_CAPACITY - 1;
+}
@@ -0,0 +1,53 @@
+#ifndef TITLE_INDEX_H
+#define TITLE_INDEX_H
+
+#include "SongStore.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Open-addressing hash index from song title to the song's ID in a SongStore.
+// Slots live in one contiguous array and cache the full 64-bit hash, so a lookup
+// touches a couple of cache lines and only compares strings on a hash match.
+// The table doubles when it passes MAX_LOAD_PERCENT and deletes by shifting
+// the following cluster back (no tombstones, probe lengths never degrade).
+class TitleIndex {
+public:
+    // Also the on-disk layout of LibraryIndex's title table
+    struct Slot {
+        uint64_t hash; // 0 marks an empty slot, hash_title never returns 0
+        SongId id;
+    };
+
+    explicit TitleIndex(const SongStore& store);
+    void insert(SongId id); // Duplicate titles are kept, lookups return the oldest
+    SongId find(std::string_view title) const; // INVALID_SONG_ID if absent
+    bool erase(SongId id); // Returns false if the song was not indexed
+    SongId erase_title(const std::string& title); // Erases the oldest match
+    void reserve(size_t song_count);
+    // Takes over a prebuilt table (capacity a power of two, same hash and
+    // probing) instead of re-hashing every title. Returns false if rejected.
+    bool adopt(const Slot* table, size_t capacity, size_t song_count);
+    void clear();
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+
+    static uint64_t hash_title(const char* data, size_t length);
+
+    static const size_t MIN_CAPACITY = 16; // Must be a power of two
+    static const size_t MAX_LOAD_PERCENT = 70;
+
+private:
+    const SongStore& store;
+    std::vector<Slot> slots;
+    size_t count;
+    size_t mask;
+
+    void rehash(size_t new_capacity);
+    void place(uint64_t hash, SongId id);
+    void erase_at(size_t hole);
+};
+
+#endif // TITLE_INDEX_H
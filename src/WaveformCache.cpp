@@ -0,0 +1,188 @@
+#include "WaveformCache.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char CACHE_MAGIC[8] = {'N', 'Z', '2', 'W', 'A', 'V', 'E', 0};
+
+static_assert(sizeof(WaveformCache::Record) == 48, "record layout is part of the file format");
+
+bool WaveformCache::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    close_file();
+    entries.clear();
+    if (!file.open(path) || !file.map()) {
+        close_file();
+        return false;
+    }
+    const unsigned char* data = file.data();
+    uint64_t size = file.size();
+    const Header* candidate = reinterpret_cast<const Header*>(data);
+    uint64_t records_end = size < sizeof(Header) ? 0 :
+                           candidate->records_offset + uint64_t(candidate->record_count) * sizeof(Record);
+    bool valid = size >= sizeof(Header) && std::memcmp(candidate->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                 candidate->version == VERSION && candidate->records_offset % alignof(Record) == 0 &&
+                 records_end <= size && candidate->strings_offset + candidate->strings_size <= size &&
+                 candidate->peaks_offset + candidate->peaks_size <= size;
+    if (!valid) {
+        close_file();
+        return false;
+    }
+    header = candidate;
+    strings = reinterpret_cast<const char*>(data + header->strings_offset);
+    peak_data = reinterpret_cast<const int8_t*>(data + header->peaks_offset);
+
+    const Record* records = reinterpret_cast<const Record*>(data + header->records_offset);
+    entries.reserve(header->record_count);
+    for (size_t i = 0; i < header->record_count; ++i) {
+        const Record& r = records[i];
+        if (uint64_t(r.path_offset) + r.path_length > header->strings_size ||
+            r.peaks_offset + r.peaks_size > header->peaks_size) {
+            continue;
+        }
+        PooledPath file_path;
+        if (!PooledPath::find(std::string_view(strings + r.path_offset, r.path_length), file_path)) {
+            continue;
+        }
+        Entry& entry = entries[file_path];
+        entry.stamp.mtime_ns = r.mtime_ns;
+        entry.stamp.size = r.file_size;
+        entry.record = &r;
+    }
+    return true;
+}
+
+void WaveformCache::close_file() {
+    file.close();
+    header = nullptr;
+    strings = nullptr;
+    peak_data = nullptr;
+}
+
+bool WaveformCache::load(Entry& entry) {
+    if (entry.peaks) {
+        return true;
+    }
+    if (!entry.record) {
+        return false;
+    }
+    const Record& r = *entry.record;
+    std::vector<int8_t> data(peak_data + r.peaks_offset, peak_data + r.peaks_offset + r.peaks_size);
+    auto peaks = std::make_shared<WaveformPeaks>();
+    entry.record = nullptr;
+    if (!WaveformPeaks::from_data(r.frame_count, r.sample_rate, std::move(data), *peaks)) {
+        return false;
+    }
+    entry.peaks = std::move(peaks);
+    return true;
+}
+
+std::shared_ptr<const WaveformPeaks> WaveformCache::get(const PooledPath& file_path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(file_path);
+    if (it == entries.end() || !load(it->second)) {
+        return nullptr;
+    }
+    return it->second.peaks;
+}
+
+bool WaveformCache::is_current(const PooledPath& file_path, const FileStamp& stamp) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(file_path);
+    return it != entries.end() && it->second.stamp == stamp && (it->second.peaks || it->second.record);
+}
+
+void WaveformCache::put(const PooledPath& file_path, const FileStamp& stamp, WaveformPeaks peaks) {
+    auto shared = std::make_shared<const WaveformPeaks>(std::move(peaks));
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[file_path];
+    entry.stamp = stamp;
+    entry.record = nullptr;
+    entry.peaks = std::move(shared);
+}
+
+size_t WaveformCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+bool WaveformCache::save(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Record> records;
+    std::string paths;
+    std::vector<int8_t> peaks;
+    records.reserve(entries.size());
+    for (const auto& [file_path, entry] : entries) {
+        const int8_t* data;
+        size_t data_size;
+        Record r;
+        std::memset(&r, 0, sizeof(r));
+        if (entry.peaks) {
+            data = entry.peaks->data().data();
+            data_size = entry.peaks->data().size();
+            r.frame_count = entry.peaks->get_frame_count();
+            r.sample_rate = entry.peaks->get_sample_rate();
+        } else if (entry.record) {
+            data = peak_data + entry.record->peaks_offset;
+            data_size = entry.record->peaks_size;
+            r.frame_count = entry.record->frame_count;
+            r.sample_rate = entry.record->sample_rate;
+        } else {
+            continue; // Failed to load
+        }
+        std::string text = file_path.str();
+        r.path_offset = static_cast<uint32_t>(paths.size());
+        r.path_length = static_cast<uint32_t>(text.size());
+        r.mtime_ns = entry.stamp.mtime_ns;
+        r.file_size = entry.stamp.size;
+        r.peaks_offset = peaks.size();
+        r.peaks_size = static_cast<uint32_t>(data_size);
+        paths += text;
+        peaks.insert(peaks.end(), data, data + data_size);
+        records.push_back(r);
+        if (paths.size() > 0xFFFFFFFFull) {
+            return false; // Offsets are 32-bit
+        }
+    }
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    h.version = VERSION;
+    h.record_count = static_cast<uint32_t>(records.size());
+    h.records_offset = sizeof(Header);
+    h.strings_offset = h.records_offset + records.size() * sizeof(Record);
+    h.strings_size = paths.size();
+    h.peaks_offset = h.strings_offset + paths.size();
+    h.peaks_size = peaks.size();
+
+    std::string temp_path = path + ".tmp";
+    FILE* out = std::fopen(temp_path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1 &&
+              (records.empty() || std::fwrite(records.data(), sizeof(Record), records.size(), out) == records.size()) &&
+              (paths.empty() || std::fwrite(paths.data(), 1, paths.size(), out) == paths.size()) &&
+              (peaks.empty() || std::fwrite(peaks.data(), 1, peaks.size(), out) == peaks.size());
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    // Entries still pointing into the old file get their own copies first:
+    // it is about to be replaced (and on Windows must be unmapped for that)
+    for (auto& item : entries) {
+        load(item.second);
+    }
+    close_file();
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename() won't replace an existing file on Windows
+#endif
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
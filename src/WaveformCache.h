@@ -0,0 +1,76 @@
+#ifndef WAVEFORM_CACHE_H
+#define WAVEFORM_CACHE_H
+
+#include "DirectoryScanner.h"
+#include "MappedFile.h"
+#include "StringPool.h"
+#include "WaveformPeaks.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Waveform overviews of library files, keyed by file path and checked
+// against the file's mtime and size. The cache file is mapped on open() and
+// an entry is only copied out of it the first time it is asked for, so a
+// lookup is a hash probe either way. Thread-safe.
+//
+//   Header | Record[record_count] | paths | peak data
+class WaveformCache {
+public:
+    static const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8]; // "NZ2WAVE\0"
+        uint32_t version;
+        uint32_t record_count;
+        uint64_t records_offset;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+        uint64_t peaks_offset;
+        uint64_t peaks_size;
+    };
+
+    struct Record {
+        uint32_t path_offset; // Into the paths
+        uint32_t path_length;
+        int64_t mtime_ns;
+        uint64_t file_size;
+        uint64_t frame_count;
+        uint64_t peaks_offset; // Into the peak data
+        uint32_t peaks_size;
+        uint32_t sample_rate;
+    };
+
+    // Maps an existing cache file. Entries for paths the program hasn't
+    // seen (i.e. not in the library) are left out and dropped on save.
+    bool open(const std::string& path);
+    // Writes every entry to a temporary file renamed over path
+    bool save(const std::string& path);
+
+    // nullptr if file_path has no overview
+    std::shared_ptr<const WaveformPeaks> get(const PooledPath& file_path);
+    bool is_current(const PooledPath& file_path, const FileStamp& stamp) const;
+    void put(const PooledPath& file_path, const FileStamp& stamp, WaveformPeaks peaks);
+    size_t size() const;
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        const Record* record = nullptr; // In the mapped file, until loaded into peaks
+        std::shared_ptr<const WaveformPeaks> peaks;
+    };
+
+    mutable std::mutex mutex;
+    MappedFile file;
+    const Header* header = nullptr;
+    const char* strings = nullptr;
+    const int8_t* peak_data = nullptr;
+    std::unordered_map<PooledPath, Entry, PooledPath::Hash> entries;
+
+    bool load(Entry& entry); // Copies a mapped entry into memory; mutex must be held
+    void close_file();
+};
+
+#endif // WAVEFORM_CACHE_H
@@ -0,0 +1,67 @@
+#include "WaveformGenerator.h"
+#include "AssetResolver.h"
+#include "DirectoryScanner.h"
+#include "Logger.h"
+#include "PcmReader.h"
+#include "WaveformCache.h"
+#include "WaveformPeaks.h"
+
+// Frames decoded per read: a whole number of peaks, and small enough that
+// cancelling is quick
+static const size_t CHUNK_FRAMES = 16 * WaveformPeaks::FRAMES_PER_PEAK;
+
+WaveformGenerator::WaveformGenerator(WaveformCache& cache, unsigned thread_count)
+    : cache(cache),
+      pool([this](const PooledPath& file_path, double& audio_seconds,
+                  const std::atomic<bool>& stopping) { return build(file_path, audio_seconds, stopping); },
+           [](const Totals& totals) {
+               if (totals.done > 0) {
+                   log_info() << "Waveforms ready: " << totals.done << " generated, " << totals.skipped
+                              << " cached, " << totals.audio_seconds / 60.0 << " min of audio at "
+                              << totals.realtime_per_core() << "x realtime per core";
+               }
+           },
+           thread_count) {}
+
+bool WaveformGenerator::build_file(const std::string& resolved_path, WaveformPeaks& peaks,
+                                   const std::atomic<bool>* cancel) {
+    PcmReader reader;
+    if (!reader.open(resolved_path, PcmReader::Use::Background)) {
+        return false;
+    }
+    unsigned channels = reader.get_channel_count();
+    WaveformPeaks::Builder builder(reader.get_sample_rate(), channels);
+    std::vector<int16_t> samples(CHUNK_FRAMES * channels);
+    for (;;) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        size_t frames = reader.read(samples.data(), CHUNK_FRAMES);
+        if (frames == 0) {
+            break;
+        }
+        builder.add_frames(samples.data(), frames);
+    }
+    peaks = builder.finish();
+    return true;
+}
+
+FileWorkerPool::Outcome WaveformGenerator::build(const PooledPath& file_path, double& audio_seconds,
+                                                  const std::atomic<bool>& stopping) {
+    std::string resolved = AssetResolver::instance().resolve(file_path);
+    FileStamp stamp;
+    bool stamped = read_file_stamp(resolved, stamp);
+    if (stamped && cache.is_current(file_path, stamp)) {
+        return FileWorkerPool::Outcome::Skipped;
+    }
+    WaveformPeaks peaks;
+    if (!stamped || !build_file(resolved, peaks, &stopping)) {
+        if (!stopping) {
+            log_warning() << "Waveform: could not decode " << resolved;
+        }
+        return FileWorkerPool::Outcome::Failed;
+    }
+    audio_seconds = peaks.seconds();
+    cache.put(file_path, stamp, std::move(peaks));
+    return FileWorkerPool::Outcome::Done;
+}
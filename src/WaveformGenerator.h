@@ -0,0 +1,43 @@
+#ifndef WAVEFORM_GENERATOR_H
+#define WAVEFORM_GENERATOR_H
+
+#include "FileWorkerPool.h"
+#include "StringPool.h"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class WaveformCache;
+class WaveformPeaks;
+
+// Fills a WaveformCache on a FileWorkerPool. Each queued file is
+// stamped first and only decoded if the cache has nothing for that stamp, so
+// after the first run a library costs one stat per file.
+class WaveformGenerator {
+public:
+    using Totals = FileWorkerPool::Totals; // done: generated, skipped: already in the cache
+
+    // The cache must outlive the generator. thread_count 0: one per core, leaving one for playback.
+    explicit WaveformGenerator(WaveformCache& cache, unsigned thread_count = 0);
+    WaveformGenerator(const WaveformGenerator&) = delete;
+    WaveformGenerator& operator=(const WaveformGenerator&) = delete;
+
+    void generate(const std::vector<PooledPath>& file_paths) { pool.add(file_paths); }
+    size_t pending() const { return pool.pending(); } // Queued or being generated
+    Totals get_totals() const { return pool.get_totals(); }
+
+    // Decodes resolved_path into peaks on the calling thread. False if the
+    // file can't be opened or cancel is set before the end.
+    static bool build_file(const std::string& resolved_path, WaveformPeaks& peaks,
+                           const std::atomic<bool>* cancel = nullptr);
+
+private:
+    WaveformCache& cache;
+    FileWorkerPool pool; // Last, so its workers stop before the rest goes
+
+    FileWorkerPool::Outcome build(const PooledPath& file_path, double& audio_seconds,
+                                  const std::atomic<bool>& stopping);
+};
+
+#endif // WAVEFORM_GENERATOR_H
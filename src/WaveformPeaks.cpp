@@ -0,0 +1,177 @@
+#include "WaveformPeaks.h"
+#include <algorithm>
+#include <cstdlib>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define WAVEFORM_SSE2 1
+#endif
+
+static int8_t high_byte(int16_t sample) {
+    return static_cast<int8_t>(sample >> 8);
+}
+
+void WaveformPeaks::fold_min_max(const int16_t* samples, size_t count, int16_t& low, int16_t& high) {
+    size_t i = 0;
+#ifdef WAVEFORM_SSE2
+    if (count >= 16) {
+        // Two accumulators each, so consecutive min/max don't wait on each other
+        __m128i low0 = _mm_set1_epi16(low), low1 = low0;
+        __m128i high0 = _mm_set1_epi16(high), high1 = high0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8));
+            low0 = _mm_min_epi16(low0, a);
+            high0 = _mm_max_epi16(high0, a);
+            low1 = _mm_min_epi16(low1, b);
+            high1 = _mm_max_epi16(high1, b);
+        }
+        __m128i lows = _mm_min_epi16(low0, low1);
+        __m128i highs = _mm_max_epi16(high0, high1);
+        lows = _mm_min_epi16(lows, _mm_shuffle_epi32(lows, _MM_SHUFFLE(1, 0, 3, 2)));
+        highs = _mm_max_epi16(highs, _mm_shuffle_epi32(highs, _MM_SHUFFLE(1, 0, 3, 2)));
+        lows = _mm_min_epi16(lows, _mm_shuffle_epi32(lows, _MM_SHUFFLE(2, 3, 0, 1)));
+        highs = _mm_max_epi16(highs, _mm_shuffle_epi32(highs, _MM_SHUFFLE(2, 3, 0, 1)));
+        lows = _mm_min_epi16(lows, _mm_shufflelo_epi16(lows, _MM_SHUFFLE(2, 3, 0, 1)));
+        highs = _mm_max_epi16(highs, _mm_shufflelo_epi16(highs, _MM_SHUFFLE(2, 3, 0, 1)));
+        low = static_cast<int16_t>(_mm_extract_epi16(lows, 0));
+        high = static_cast<int16_t>(_mm_extract_epi16(highs, 0));
+    }
+#endif
+    for (; i < count; ++i) {
+        low = std::min(low, samples[i]);
+        high = std::max(high, samples[i]);
+    }
+}
+
+WaveformPeaks::Builder::Builder(unsigned sample_rate, unsigned channel_count)
+    : sample_rate(sample_rate), channel_count(channel_count), frame_count(0), frames_in_peak(0),
+      low(INT16_MAX), high(INT16_MIN) {}
+
+void WaveformPeaks::Builder::add_frames(const int16_t* samples, size_t frames) {
+    if (channel_count == 0) {
+        return;
+    }
+    frame_count += frames;
+    while (frames > 0) {
+        size_t n = std::min<size_t>(frames, FRAMES_PER_PEAK - frames_in_peak);
+        fold_min_max(samples, n * channel_count, low, high);
+        samples += n * channel_count;
+        frames -= n;
+        frames_in_peak += n;
+        if (frames_in_peak == FRAMES_PER_PEAK) {
+            base.push_back(high_byte(low));
+            base.push_back(high_byte(high));
+            low = INT16_MAX;
+            high = INT16_MIN;
+            frames_in_peak = 0;
+        }
+    }
+}
+
+WaveformPeaks WaveformPeaks::Builder::finish() {
+    if (frames_in_peak > 0) {
+        base.push_back(high_byte(low));
+        base.push_back(high_byte(high));
+        frames_in_peak = 0;
+    }
+    WaveformPeaks result;
+    result.frame_count = frame_count;
+    result.sample_rate = sample_rate;
+    std::vector<size_t> widths = level_widths(frame_count);
+    result.peaks = std::move(base);
+    // Each level from the one before: pairs of pairs
+    size_t previous = 0;
+    for (size_t l = 1; l < widths.size(); ++l) {
+        size_t start = result.peaks.size();
+        for (size_t i = 0; i < widths[l]; ++i) {
+            size_t a = previous + 4 * i;
+            int8_t lo = result.peaks[a], hi = result.peaks[a + 1];
+            if (2 * i + 1 < widths[l - 1]) {
+                lo = std::min(lo, result.peaks[a + 2]);
+                hi = std::max(hi, result.peaks[a + 3]);
+            }
+            result.peaks.push_back(lo);
+            result.peaks.push_back(hi);
+        }
+        previous = start;
+    }
+    result.index_levels();
+    return result;
+}
+
+std::vector<size_t> WaveformPeaks::level_widths(uint64_t frame_count) {
+    std::vector<size_t> widths;
+    size_t width = static_cast<size_t>((frame_count + FRAMES_PER_PEAK - 1) / FRAMES_PER_PEAK);
+    if (width == 0) {
+        return widths;
+    }
+    widths.push_back(width);
+    while (width > MIN_LEVEL_WIDTH) {
+        width = (width + 1) / 2;
+        widths.push_back(width);
+    }
+    return widths;
+}
+
+void WaveformPeaks::index_levels() {
+    offsets.clear();
+    size_t offset = 0;
+    for (size_t width : level_widths(frame_count)) {
+        offsets.push_back(offset);
+        offset += 2 * width;
+    }
+}
+
+bool WaveformPeaks::from_data(uint64_t frame_count, unsigned sample_rate, std::vector<int8_t> data,
+                              WaveformPeaks& out) {
+    size_t expected = 0;
+    for (size_t width : level_widths(frame_count)) {
+        expected += 2 * width;
+    }
+    if (data.size() != expected) {
+        return false;
+    }
+    out.frame_count = frame_count;
+    out.sample_rate = sample_rate;
+    out.peaks = std::move(data);
+    out.index_levels();
+    return true;
+}
+
+size_t WaveformPeaks::width(size_t level) const {
+    size_t end = level + 1 < offsets.size() ? offsets[level + 1] : peaks.size();
+    return (end - offsets[level]) / 2;
+}
+
+size_t WaveformPeaks::level_for(size_t columns) const {
+    size_t best = 0;
+    for (size_t l = 1; l < level_count() && width(l) >= columns; ++l) {
+        best = l;
+    }
+    return best;
+}
+
+std::string WaveformPeaks::render(size_t columns, double marker) const {
+    static const char shades[] = " .:-=+*#%@";
+    const size_t shade_count = sizeof(shades) - 1;
+    std::string line(columns, ' ');
+    if (level_count() == 0 || columns == 0) {
+        return line;
+    }
+    size_t l = level_for(columns);
+    const int8_t* pairs = level(l);
+    size_t pair_count = width(l);
+    for (size_t c = 0; c < columns; ++c) {
+        size_t begin = c * pair_count / columns;
+        size_t end = std::max(begin + 1, (c + 1) * pair_count / columns);
+        int amplitude = 0;
+        for (size_t i = begin; i < end && i < pair_count; ++i) {
+            amplitude = std::max({amplitude, std::abs(int(pairs[2 * i])), std::abs(int(pairs[2 * i + 1]))});
+        }
+        line[c] = shades[std::min(shade_count - 1, size_t(amplitude) * shade_count / 129)];
+    }
+    if (marker >= 0.0 && marker <= 1.0) {
+        line[std::min(columns - 1, static_cast<size_t>(marker * columns))] = '|';
+    }
+    return line;
+}
@@ -0,0 +1,65 @@
+#ifndef WAVEFORM_PEAKS_H
+#define WAVEFORM_PEAKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Min/max overview of a track for drawing a seek-bar waveform. Level 0 has
+// one (min, max) pair per FRAMES_PER_PEAK frames, over all channels; each
+// further level halves the one before, down to about MIN_LEVEL_WIDTH pairs,
+// so a bar of any width is drawn from the nearest level without going back
+// to the audio. Values are the high byte of the 16-bit samples.
+class WaveformPeaks {
+public:
+    static const uint32_t FRAMES_PER_PEAK = 512;
+    static const size_t MIN_LEVEL_WIDTH = 32;
+
+    // Accumulates decoded PCM into level 0; finish() adds the coarser levels
+    class Builder {
+    public:
+        Builder(unsigned sample_rate, unsigned channel_count);
+        void add_frames(const int16_t* samples, size_t frame_count); // Interleaved
+        WaveformPeaks finish();
+
+    private:
+        unsigned sample_rate;
+        unsigned channel_count;
+        uint64_t frame_count;
+        size_t frames_in_peak;
+        int16_t low, high; // Of the peak being filled
+        std::vector<int8_t> base; // Finished level-0 pairs
+    };
+
+    WaveformPeaks() = default;
+    // Takes back data() as saved; false if it doesn't fit frame_count
+    static bool from_data(uint64_t frame_count, unsigned sample_rate, std::vector<int8_t> data, WaveformPeaks& out);
+
+    size_t level_count() const { return offsets.size(); }
+    size_t width(size_t level) const; // Pairs in the level
+    const int8_t* level(size_t level) const { return peaks.data() + offsets[level]; } // min, max, min, max...
+    size_t level_for(size_t columns) const; // Coarsest level still at least columns wide
+    uint64_t get_frame_count() const { return frame_count; }
+    unsigned get_sample_rate() const { return sample_rate; }
+    double seconds() const { return sample_rate ? double(frame_count) / sample_rate : 0.0; }
+    const std::vector<int8_t>& data() const { return peaks; }
+
+    // One line of text, columns wide; marker (a fraction of the track, if in
+    // [0, 1]) shows as '|'
+    std::string render(size_t columns, double marker = -1.0) const;
+
+    // Folds the smallest and largest of samples[0, count) into low and high
+    static void fold_min_max(const int16_t* samples, size_t count, int16_t& low, int16_t& high);
+
+private:
+    uint64_t frame_count = 0;
+    unsigned sample_rate = 0;
+    std::vector<int8_t> peaks; // Every level back to back, finest first
+    std::vector<size_t> offsets; // Start of each level in peaks
+
+    static std::vector<size_t> level_widths(uint64_t frame_count);
+    void index_levels();
+};
+
+#endif // WAVEFORM_PEAKS_H
@@ -1,13 +1,24 @@
 #include <iostream>
 #include <string>
+#include <vector>
 #include <limits> // Required for numeric_limits
 #include <exception>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
 
+#include "AssetResolver.h"
+#include "LibraryWatcher.h"
+#include "Logger.h"
+#include "LoudnessAnalyzer.h"
 #include "Song.h"
 #include "Playlist.h"
 #include "MusicLibrary.h"
+#include "WaveformCache.h"
+#include "WaveformGenerator.h"
 
 void display_menu() {
+    Logger::instance().flush(); // Messages from the last action first
     std::cout << "\n--- Music Player Menu ---" << std::endl;
     std::cout << "1. List all songs in library" << std::endl;
     std::cout << "2. Show current playlist" << std::endl;
@@ -18,46 +29,106 @@ void display_menu() {
     std::cout << "7. Add song to playlist (by number)" << std::endl;
     std::cout << "8. Save playlist to file" << std::endl;
     std::cout << "9. Load playlist from file" << std::endl;
+    std::cout << "10. Toggle gapless auto-advance" << std::endl;
+    std::cout << "11. Search library" << std::endl;
+    std::cout << "12. Show playback latency stats" << std::endl;
+    std::cout << "13. Toggle loudness normalisation" << std::endl;
+    std::cout << "14. Show waveform of current song" << std::endl;
+    std::cout << "15. Find duplicate recordings" << std::endl;
+    std::cout << "16. Play a song next (by number)" << std::endl;
+    std::cout << "17. Remove song from playlist" << std::endl;
+    std::cout << "18. Move song within playlist" << std::endl;
+    std::cout << "19. Toggle shuffle" << std::endl;
+    std::cout << "20. Browse library by title, artist, album or path" << std::endl;
+    std::cout << "21. Set crossfade" << std::endl;
+    std::cout << "22. Set equalizer" << std::endl;
     std::cout << "0. Exit" << std::endl;
     std::cout << "Enter your choice: ";
 }
 
 // REMOVED load_songs_from_assets function
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        // --quiet: only warnings and errors from the library and playlist
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--quiet") == 0 || std::strcmp(argv[i], "-q") == 0) {
+                Logger::instance().set_quiet(true);
+            }
+        }
         std::cout << "--- Music Player ---" << std::endl;
 
         MusicLibrary library;
 
-        // For now, manually add songs (avoiding filesystem DLL issues)
-        // You can add your songs here manually, or we can fix the automatic loading later
+        // Start from the saved index, then rescan assets: only new or changed
+        // files get their tags read again
+        const std::string index_file = "library.idx";
         std::cout << "Loading songs..." << std::endl;
+        library.load_index(index_file);
+        library.load_songs_from_directory("assets");
         
-        // Add songs manually - replace these with your actual song files
-        library.add_song({"INTERWORLD - METAMORPHOSIS", "INTERWORLD", "Unknown Album", 0, "assets/INTERWORLD - METAMORPHOSIS.mp3"});
-        library.add_song({"Joy Crookes - Feet Don't Fail Me Now", "Joy Crookes", "Unknown Album", 0, "assets/Joy Crookes - Feet Don't Fail Me Now (Official Video).mp3"});
-        library.add_song({"KALEO - Way Down We Go", "KALEO", "Unknown Album", 0, "assets/KALEO - Way Down We Go (Official Music Video).mp3"});
-        library.add_song({"Måneskin - Beggin'", "Måneskin", "Unknown Album", 0, "assets/Måneskin - Beggin' (LyricsTesto).mp3"});
-        library.add_song({"MGMT - Little Dark Age", "MGMT", "Unknown Album", 0, "assets/MGMT - Little Dark Age (Official Video).mp3"});
-        library.add_song({"The Lost Soul Down", "Unknown Artist", "Unknown Album", 0, "assets/The Lost Soul Down X Lost Soul.mp3"});
-        library.add_song({"The Script - Hall of Fame", "The Script", "Unknown Album", 0, "assets/The Script - Hall of Fame (Official Video) ft. will.i.am.mp3"});
-        library.add_song({"The Weeknd - Often", "The Weeknd", "Unknown Album", 0, "assets/The Weeknd - Often (NSFW) (Official Video).mp3"});
-        library.add_song({"Timbaland - The Way I Are", "Timbaland", "Unknown Album", 0, "assets/Timbaland - The Way I Are (Official Music Video) ft. Keri Hilson, D.O.E., Sebastian.mp3"});
-        library.add_song({"test", "Unknown Artist", "Unknown Album", 0, "assets/test.mp3"});
-        library.add_song({"test ogg", "Unknown Artist", "Unknown Album", 0, "assets/test.ogg"});
+        if (library.get_song_count() == 0) {
+            // Nothing found on disk - fall back to the manual list
+            library.add_song({"INTERWORLD - METAMORPHOSIS", "INTERWORLD", "Unknown Album", 0, "assets/INTERWORLD - METAMORPHOSIS.mp3"});
+            library.add_song({"Joy Crookes - Feet Don't Fail Me Now", "Joy Crookes", "Unknown Album", 0, "assets/Joy Crookes - Feet Don't Fail Me Now (Official Video).mp3"});
+            library.add_song({"KALEO - Way Down We Go", "KALEO", "Unknown Album", 0, "assets/KALEO - Way Down We Go (Official Music Video).mp3"});
+            library.add_song({"Måneskin - Beggin'", "Måneskin", "Unknown Album", 0, "assets/Måneskin - Beggin' (LyricsTesto).mp3"});
+            library.add_song({"MGMT - Little Dark Age", "MGMT", "Unknown Album", 0, "assets/MGMT - Little Dark Age (Official Video).mp3"});
+            library.add_song({"The Lost Soul Down", "Unknown Artist", "Unknown Album", 0, "assets/The Lost Soul Down X Lost Soul.mp3"});
+            library.add_song({"The Script - Hall of Fame", "The Script", "Unknown Album", 0, "assets/The Script - Hall of Fame (Official Video) ft. will.i.am.mp3"});
+            library.add_song({"The Weeknd - Often", "The Weeknd", "Unknown Album", 0, "assets/The Weeknd - Often (NSFW) (Official Video).mp3"});
+            library.add_song({"Timbaland - The Way I Are", "Timbaland", "Unknown Album", 0, "assets/Timbaland - The Way I Are (Official Music Video) ft. Keri Hilson, D.O.E., Sebastian.mp3"});
+            library.add_song({"test", "Unknown Artist", "Unknown Album", 0, "assets/test.mp3"});
+            library.add_song({"test ogg", "Unknown Artist", "Unknown Album", 0, "assets/test.ogg"});
+        }
+        library.save_index(index_file);
+        library.publish();
         
+        Logger::instance().flush();
         std::cout << "Songs loaded successfully!" << std::endl;
         std::cout << std::endl;
 
         Playlist my_playlist("My Awesome Playlist");
 
+        // Measure the loudness of songs that don't have it yet in the
+        // background; results are picked up between menu actions
+        LoudnessAnalyzer loudness_analyzer;
+        loudness_analyzer.analyse(library.unanalysed_files());
+        bool loudness_changed = false;
+
+        // Seek-bar overviews: loaded from the cache, generated in the
+        // background for files that are new or changed since
+        const std::string waveform_file = "waveforms.cache";
+        WaveformCache waveforms;
+        waveforms.open(waveform_file);
+        WaveformGenerator waveform_generator(waveforms);
+        waveform_generator.generate(library.all_files());
+
+        // Follow files added, removed or renamed under assets while we run,
+        // instead of rescanning it; batches are applied between menu actions
+        LibraryWatcher watcher;
+        watcher.start(AssetResolver::instance().find_directory("assets"), MusicLibrary::is_audio_file);
+        bool library_changed = false;
+
         // Show what was loaded
         library.list_all_songs();
         std::cout << "\nAll songs have been added to the library. Use menu option 7 to add songs to your playlist." << std::endl;
         
         int choice;
         do {
+            std::vector<LoudnessResult> measured = loudness_analyzer.collect();
+            if (!measured.empty()) {
+                library.apply_loudness(measured);
+                my_playlist.apply_loudness(measured);
+                loudness_changed = true;
+            }
+            for (const LibraryChanges& changes : watcher.collect()) {
+                std::vector<PooledPath> updated = library.apply_changes("assets", changes);
+                loudness_analyzer.analyse(updated);
+                waveform_generator.generate(updated);
+                library_changed = true;
+            }
+            library.publish();
             display_menu();
             std::cin >> choice;
 
@@ -93,12 +164,12 @@ int main() {
                 // Clear the input buffer
                 std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
                 
-                Song* found_song = library.get_song_by_index(song_number);
+                const Song* found_song = library.get_song_by_index(song_number);
                 if (found_song) {
                     my_playlist.add_song(*found_song);
-                    std::cout << "Song #" << song_number << " added to playlist!" << std::endl;
+                    log_info() << "Song #" << song_number << " added to playlist!";
                 } else {
-                    std::cout << "Invalid song number. Please enter a number between 1 and " << library.get_song_count() << "." << std::endl;
+                    std::cout << "Invalid song number. Please enter a number from the list." << std::endl;
                 }
                 break;
             }
@@ -116,20 +187,237 @@ int main() {
                 my_playlist.load_from_file(load_filename, library);
                 break;
             }
+            case 10:
+                my_playlist.set_gapless(!my_playlist.is_gapless());
+                log_info() << "Gapless auto-advance " << (my_playlist.is_gapless() ? "on" : "off") << ".";
+                break;
+            case 11: {
+                std::cout << "Search title, artist or album: ";
+                std::string query;
+                std::getline(std::cin, query);
+                std::vector<SongId> results = library.search(query);
+                if (results.empty()) {
+                    std::cout << "No songs match '" << query << "'." << std::endl;
+                    break;
+                }
+                for (SongId id : results) {
+                    const Song* song = library.get_song(id);
+                    std::cout << (id + 1) << ". " << song->title << " by " << song->artist
+                              << " (" << song->album << ")" << std::endl;
+                }
+                std::cout << "Use menu option 7 with a number above to add it to your playlist." << std::endl;
+                break;
+            }
+            case 12:
+                my_playlist.show_playback_stats();
+                break;
+            case 13:
+                my_playlist.set_normalized(!my_playlist.is_normalized());
+                log_info() << "Loudness normalisation " << (my_playlist.is_normalized() ? "on" : "off") << ".";
+                break;
+            case 14: {
+                Song current;
+                float seconds = 0;
+                if (!my_playlist.get_current_position(current, seconds)) {
+                    std::cout << "No current song." << std::endl;
+                    break;
+                }
+                std::shared_ptr<const WaveformPeaks> peaks = waveforms.get(current.file_path);
+                if (!peaks) {
+                    std::cout << "No waveform for '" << current.title << "' yet." << std::endl;
+                    break;
+                }
+                double length = peaks->seconds();
+                std::cout << current.title << " (" << static_cast<int>(seconds) << "s / " << static_cast<int>(length)
+                          << "s)" << std::endl;
+                std::cout << "[" << peaks->render(64, length > 0 ? seconds / length : -1.0) << "]" << std::endl;
+                break;
+            }
+            case 15: {
+                std::vector<std::vector<SongId>> groups = library.find_duplicate_recordings();
+                if (groups.empty()) {
+                    std::cout << "No duplicate recordings found." << std::endl;
+                    break;
+                }
+                for (size_t g = 0; g < groups.size(); ++g) {
+                    std::cout << "Recording " << (g + 1) << ":" << std::endl;
+                    for (SongId id : groups[g]) {
+                        const Song* song = library.get_song(id);
+                        std::cout << "  " << (id + 1) << ". " << song->title << " (" << song->file_path.str() << ")"
+                                  << std::endl;
+                    }
+                }
+                break;
+            }
+            case 16: {
+                library.list_all_songs();
+                std::cout << "Enter the song number to play next: ";
+                int song_number;
+                std::cin >> song_number;
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                const Song* found_song = library.get_song_by_index(song_number);
+                if (found_song) {
+                    my_playlist.add_song_next(*found_song);
+                } else {
+                    std::cout << "Invalid song number. Please enter a number from the list." << std::endl;
+                }
+                break;
+            }
+            case 17: {
+                my_playlist.show_playlist();
+                std::cout << "Enter the position to remove: ";
+                int position;
+                std::cin >> position;
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                my_playlist.remove_song(static_cast<size_t>(std::max(0, position)));
+                break;
+            }
+            case 18: {
+                my_playlist.show_playlist();
+                std::cout << "Enter the position to move from and to: ";
+                int from, to;
+                std::cin >> from >> to;
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                my_playlist.move_song(static_cast<size_t>(std::max(0, from)), static_cast<size_t>(std::max(0, to)));
+                break;
+            }
+            case 19:
+                my_playlist.set_shuffle(!my_playlist.is_shuffled());
+                log_info() << "Shuffle " << (my_playlist.is_shuffled() ? "on" : "off") << ".";
+                break;
+            case 20: {
+                std::cout << "Sort by (title/artist/album/path): ";
+                std::string order;
+                std::getline(std::cin, order);
+                SortField field = SortField::Title;
+                if (order == "artist") {
+                    field = SortField::Artist;
+                } else if (order == "album") {
+                    field = SortField::Album;
+                } else if (order == "path") {
+                    field = SortField::Path;
+                }
+                std::cout << "Starting with (Enter for all): ";
+                std::string prefix;
+                std::getline(std::cin, prefix);
+
+                // Pages come from one snapshot, so they don't shift while paging
+                std::shared_ptr<const LibrarySnapshot> view = library.snapshot();
+                const size_t page_size = 20;
+                size_t offset = 0;
+                for (;;) {
+                    size_t total = 0;
+                    std::vector<SongId> page = view->list_sorted(field, prefix, offset, page_size, total);
+                    if (total == 0) {
+                        std::cout << "No songs found." << std::endl;
+                        break;
+                    }
+                    Logger::instance().flush();
+                    for (SongId id : page) {
+                        const Song* song = view->get_song(id);
+                        std::cout << (id + 1) << ". " << song->title << " by " << song->artist << " (" << song->album
+                                  << ")";
+                        if (field == SortField::Path) {
+                            std::cout << " " << song->file_path;
+                        }
+                        std::cout << std::endl;
+                    }
+                    std::cout << "Songs " << (offset + 1) << "-" << (offset + page.size()) << " of " << total
+                              << ". [n]ext, [p]revious, anything else to stop: ";
+                    std::string step;
+                    std::getline(std::cin, step);
+                    if (step == "n" && offset + page_size < total) {
+                        offset += page_size;
+                    } else if (step == "p" && offset > 0) {
+                        offset -= page_size;
+                    } else if (step != "n" && step != "p") {
+                        break;
+                    }
+                }
+                break;
+            }
+            case 21: {
+                std::cout << "Crossfade seconds (0 for none): ";
+                double seconds;
+                bool valid = static_cast<bool>(std::cin >> seconds);
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                if (!valid || seconds < 0 || seconds > 12) {
+                    std::cout << "Enter a number of seconds between 0 and 12." << std::endl;
+                    break;
+                }
+                FadeCurve curve = FadeCurve::EqualPower;
+                if (seconds > 0) {
+                    std::cout << "Curve (equal/linear/s, Enter for equal power): ";
+                    std::string name;
+                    std::getline(std::cin, name);
+                    if (name == "linear") {
+                        curve = FadeCurve::Linear;
+                    } else if (name == "s") {
+                        curve = FadeCurve::SCurve;
+                    }
+                }
+                my_playlist.set_crossfade(seconds, curve);
+                if (seconds > 0) {
+                    log_info() << "Crossfading " << seconds << " s between songs.";
+                } else {
+                    log_info() << "Crossfade off.";
+                }
+                break;
+            }
+            case 22: {
+                std::cout << "Gains in dB for";
+                for (double frequency : Equalizer::GRAPHIC_FREQUENCIES) {
+                    std::cout << " " << frequency << " Hz";
+                }
+                std::cout << " (Enter for flat): ";
+                std::string line;
+                std::getline(std::cin, line);
+                std::istringstream gains_in(line);
+                std::vector<double> gains;
+                double gain;
+                while (gains.size() < Equalizer::GRAPHIC_BAND_COUNT && gains_in >> gain) {
+                    gains.push_back(std::max(-12.0, std::min(12.0, gain))); // The limiter catches the rest
+                }
+                my_playlist.set_equalizer(gains);
+                if (gains.empty()) {
+                    log_info() << "Equalizer flat.";
+                } else {
+                    log_info() << "Equalizer set.";
+                }
+                break;
+            }
             case 0:
-                std::cout << "Exiting Music Player. Goodbye!" << std::endl;
-                my_playlist.stop(); 
+                my_playlist.stop();
+                if (my_playlist.has_playback_stats()) {
+                    my_playlist.show_playback_stats();
+                }
+                log_info() << "Exiting Music Player. Goodbye!";
                 break;
             default:
                 std::cout << "Invalid choice. Please try again." << std::endl;
             }
         } while (choice != 0);
 
+        watcher.stop();
+        // Keep the measurements made this session, so they aren't repeated
+        std::vector<LoudnessResult> measured = loudness_analyzer.collect();
+        library.apply_loudness(measured);
+        if (loudness_changed || library_changed || !measured.empty()) {
+            library.save_index(index_file);
+        }
+        if (waveform_generator.get_totals().done > 0) {
+            waveforms.save(waveform_file);
+        }
+
+        Logger::instance().flush();
         return 0;
     } catch (const std::exception& e) {
+        Logger::instance().flush();
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
     } catch (...) {
+        Logger::instance().flush();
         std::cerr << "Fatal error: Unknown exception occurred" << std::endl;
         return 1;
     }